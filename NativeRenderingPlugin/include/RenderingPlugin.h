@@ -2,6 +2,12 @@
 #define RENDERING_PLUGIN_H
 
 #include <platform.hpp>
+#include <frame_data.hpp>
+#include <Unity/IUnityGraphics.h>
+
+// Same as UnityRenderingEvent, but also receives a pointer given by the
+// script (CommandBuffer.IssuePluginEventAndData, newer Unity versions only).
+typedef void (UNITY_INTERFACE_API * UnityRenderingEventAndData)(int eventId, void* data);
 
 // Graphics device identifiers in Unity
 enum GfxDeviceRenderer
@@ -31,17 +37,59 @@ enum GfxDeviceEventType {
 };
 
 
+// Event IDs for GL.IssuePluginEvent
+enum PluginEventID {
+	kPluginEventRenderFrame = 1,	// Render planes and update procedural texture
+	kPluginEventRenderPlanes,		// Render planes only
+	kPluginEventUpdateTexture,		// Update procedural texture only
+	kPluginEventExecuteCommands,	// Only replay the recorded commands
+	kPluginEventRenderStereoFrame,	// Render planes for both eyes and update procedural texture
+	kPluginEventRenderDistortion,	// Undistort the stereo image with the distortion mesh
+};
+
+
 extern "C"
 {
     void EXPORT_API InitPlugin();
     void EXPORT_API SetTimeFromUnity (float t);
+    void EXPORT_API SetFrameIdFromUnity( unsigned int frameId );
     void EXPORT_API SetMatricesFromUnity( float* modelMatrix,
                                             float* viewMatrix,
                                             float* projectionMatrix );
+    void EXPORT_API SetStereoMatricesFromUnity( float* leftViewMatrix,
+                                                float* leftProjectionMatrix,
+                                                float* rightViewMatrix,
+                                                float* rightProjectionMatrix,
+                                                int currentEye );
     void EXPORT_API SetTextureFromUnity(void* texturePtr, int w, int h);
+    void EXPORT_API PublishFrameStateFromUnity();
+    FrameData* EXPORT_API GetFrameDataFromUnity();
+    void EXPORT_API CommitFrameDataFromUnity();
+    void EXPORT_API RecordMatricesFromUnity( float* viewMatrix, float* projectionMatrix );
+    void EXPORT_API RecordDrawPlaneFromUnity( float* modelMatrix );
+    void EXPORT_API RecordUpdateTextureFromUnity( void* texturePtr, int w, int h );
+    void EXPORT_API SubmitCommandsFromUnity();
+    UnityRenderingEvent EXPORT_API GetRenderEventFunc();
+    UnityRenderingEventAndData EXPORT_API GetRenderEventAndDataFunc();
     void EXPORT_API UnitySetGraphicsDevice ( void* device, int deviceType, int eventType );
     void EXPORT_API UnityRenderEvent (int eventID);
     void EXPORT_API SetPlaneTextureFromUnity( GLuint texturePtr, unsigned int lodLevel );
+    void EXPORT_API SetShaderCacheDirectoryFromUnity( const char* directory );
+    void EXPORT_API LoadPlaneTextureFromUnity( const char* basePath, unsigned int lodLevel );
+    void EXPORT_API SetProceduralTextureCompressionFromUnity( int enabled, float updateInterval );
+    unsigned int EXPORT_API GetCompressedProceduralTextureFromUnity();
+    void EXPORT_API SetProceduralTextureBackendFromUnity( int backend );
+    void EXPORT_API SetTextureWithFormatFromUnity( void* texturePtr, int w, int h, int format );
+    void EXPORT_API SetProceduralTextureScheduleFromUnity( float updateRate, float frameBudget );
+    void EXPORT_API GetGLStateCountersFromUnity( unsigned int* issuedCalls, unsigned int* avoidedCalls );
+    void EXPORT_API SetDistortionFromUnity( float k1, float k2,
+                                            float* lensFrustum,
+                                            float* noLensFrustum,
+                                            float* viewport,
+                                            void* sourceTexture );
+    void EXPORT_API SetOcclusionCullingFromUnity( int mode );
+    void EXPORT_API SetGPUDrivenRenderingFromUnity( int enabled );
+    void EXPORT_API LoadTerrainFromUnity( const char* path, unsigned int viewRadius );
 }
 
 #endif // RENDERING_PLUGIN_H
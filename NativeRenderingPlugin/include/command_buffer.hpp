@@ -0,0 +1,211 @@
+#ifndef COMMAND_BUFFER_HPP
+#define COMMAND_BUFFER_HPP
+
+#include <platform.hpp>
+#include <distortion_mesh.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// --------------------------------------------------------------------------
+// Commands recorded by Unity's main thread and replayed by the render thread.
+// Every command is a POD struct preceded by a CommandHeader in the arena.
+
+enum CommandType {
+    kCommandSetPlaneTexture = 0,
+    kCommandUpdateMatrices,
+    kCommandDrawPlane,
+    kCommandUpdateDynamicTexture,
+    kCommandLoadPlaneTexture,
+    kCommandSetProceduralTextureCompression,
+    kCommandSetProceduralTextureBackend,
+    kCommandSetProceduralTextureSchedule,
+    kCommandSetDistortion,
+    kCommandSetOcclusionCulling,
+    kCommandSetGPUDrivenRendering,
+    kCommandLoadTerrain
+};
+
+struct CommandHeader {
+    uint32_t type;
+    uint32_t size;  // Size of the whole command (header + payload), in bytes.
+};
+
+struct SetPlaneTextureCommand {
+    static const CommandType TYPE = kCommandSetPlaneTexture;
+    GLuint textureID;
+    unsigned int lodLevel;
+};
+
+// View and projection matrices used by the following kCommandDrawPlane.
+struct UpdateMatricesCommand {
+    static const CommandType TYPE = kCommandUpdateMatrices;
+    float viewMatrix[16];
+    float projectionMatrix[16];
+};
+
+struct DrawPlaneCommand {
+    static const CommandType TYPE = kCommandDrawPlane;
+    float modelMatrix[16];
+};
+
+struct UpdateDynamicTextureCommand {
+    static const CommandType TYPE = kCommandUpdateDynamicTexture;
+    void* texturePointer;
+    int width;
+    int height;
+    int format;     // ProceduralTextureFormat.
+};
+
+// Loads a compressed texture from disk (see LoadCompressedTexture()).
+struct LoadPlaneTextureCommand {
+    static const CommandType TYPE = kCommandLoadPlaneTexture;
+    char basePath[256];
+    unsigned int lodLevel;
+};
+
+struct SetProceduralTextureCompressionCommand {
+    static const CommandType TYPE = kCommandSetProceduralTextureCompression;
+    int enabled;
+    float updateInterval;   // Minimum time between two encodings, in seconds.
+};
+
+struct SetProceduralTextureBackendCommand {
+    static const CommandType TYPE = kCommandSetProceduralTextureBackend;
+    int backend;    // ProceduralTextureBackend.
+};
+
+// See TextureUpdateScheduler.
+struct SetProceduralTextureScheduleCommand {
+    static const CommandType TYPE = kCommandSetProceduralTextureSchedule;
+    float updateRate;       // Images per second (0: as often as possible).
+    float frameBudget;      // CPU time per frame, in milliseconds.
+};
+
+// Rebuilds the distortion mesh (see DistortionMesh).
+struct SetDistortionCommand {
+    static const CommandType TYPE = kCommandSetDistortion;
+    DistortionParameters parameters;
+    void* sourceTexture;    // Side by side stereo image to undistort.
+};
+
+struct SetOcclusionCullingCommand {
+    static const CommandType TYPE = kCommandSetOcclusionCulling;
+    int mode;   // OcclusionCullingMode.
+};
+
+struct SetGPUDrivenRenderingCommand {
+    static const CommandType TYPE = kCommandSetGPUDrivenRendering;
+    int enabled;
+};
+
+struct LoadTerrainCommand {
+    static const CommandType TYPE = kCommandLoadTerrain;
+    char path[256];             // Empty: unload.
+    unsigned int viewRadius;    // In tiles.
+};
+
+
+// --------------------------------------------------------------------------
+// Linear arena of commands. Recording only appends (growing the arena the
+// first frames, until it is big enough) and clear() just rewinds it, so its
+// memory is reused from frame to frame.
+
+class CommandBuffer {
+    public:
+        explicit CommandBuffer( size_t initialCapacity = 16 * 1024 );
+
+        template < class T >
+        void record( const T& command )
+        {
+            const uint32_t size = alignedSize( sizeof( CommandHeader ) + sizeof( T ) );
+            if( size_ + size > arena_.size() ){
+                arena_.resize( 2 * ( size_ + size ) );
+            }
+
+            CommandHeader* header = reinterpret_cast< CommandHeader* >( &arena_[size_] );
+            header->type = T::TYPE;
+            header->size = size;
+            memcpy( header + 1, &command, sizeof( T ) );
+            size_ += size;
+        }
+
+        void clear() { size_ = 0; }
+        bool empty() const { return size_ == 0; }
+
+        // Iteration: for( cmd = first(); cmd; cmd = next( cmd ) ).
+        const CommandHeader* first() const;
+        const CommandHeader* next( const CommandHeader* command ) const;
+
+        template < class T >
+        static const T& payload( const CommandHeader* command )
+        {
+            return *reinterpret_cast< const T* >( command + 1 );
+        }
+
+    private:
+        static uint32_t alignedSize( size_t size )
+        {
+            return static_cast< uint32_t >( ( size + ALIGNMENT - 1 ) & ~( ALIGNMENT - 1 ) );
+        }
+
+        static const size_t ALIGNMENT = 8;
+
+        std::vector< uint8_t > arena_;
+        size_t size_;
+};
+
+
+// --------------------------------------------------------------------------
+// Hands command buffers from the main thread to the render thread and back.
+// Buffers circulate through two lock-free single producer / single consumer
+// rings (submitted and free), so neither thread ever waits for the other.
+// If the render thread falls behind and there is no free buffer, submit()
+// keeps recording into the current one, so no command is ever lost.
+
+class CommandQueue {
+    public:
+        CommandQueue();
+
+        // Main thread.
+        CommandBuffer& recording() { return buffers_[recordingIndex_]; }
+        void submit();
+
+        // Render thread. Replays every submitted buffer, in order, through
+        // executor( const CommandBuffer& ) and recycles it.
+        template < class Executor >
+        void execute( Executor& executor )
+        {
+            unsigned int bufferIndex;
+            while( submitted_.pop( bufferIndex ) ){
+                executor( buffers_[bufferIndex] );
+                buffers_[bufferIndex].clear();
+                free_.push( bufferIndex );
+            }
+        }
+
+    private:
+        static const unsigned int N_BUFFERS = 3;
+
+        class IndexRing {
+            public:
+                IndexRing() : head_( 0 ), tail_( 0 ) {}
+                bool push( unsigned int index );
+                bool pop( unsigned int& index );
+
+            private:
+                static const unsigned int CAPACITY = N_BUFFERS + 1;
+                unsigned int slots_[CAPACITY];
+                std::atomic< unsigned int > head_;
+                std::atomic< unsigned int > tail_;
+        };
+
+        CommandBuffer buffers_[N_BUFFERS];
+        unsigned int recordingIndex_;
+        IndexRing submitted_;
+        IndexRing free_;
+};
+
+#endif // COMMAND_BUFFER_HPP
@@ -0,0 +1,53 @@
+#ifndef COMPRESSED_TEXTURE_HPP
+#define COMPRESSED_TEXTURE_HPP
+
+#include <platform.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Compressed internal formats which may be missing from the GL headers.
+#ifndef GL_ETC1_RGB8_OES
+#define GL_ETC1_RGB8_OES 0x8D64
+#endif
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#endif
+
+// A compressed texture with its mip levels, as stored in a KTX file.
+struct CompressedImage {
+    GLenum internalFormat;
+    GLsizei width;
+    GLsizei height;
+    std::vector< std::vector< uint8_t > > levels;
+};
+
+// Whether the current context can sample the given compressed format.
+bool IsCompressedFormatSupported( GLenum internalFormat );
+
+// Whether the given compressed format has no alpha channel.
+bool IsOpaqueCompressedFormat( GLenum internalFormat );
+
+// Reads a KTX (1.1) file holding a compressed 2D texture. Returns false and
+// logs the reason on failure.
+bool LoadKTX( const std::string& path, CompressedImage& image );
+
+// Creates a GL texture with the given image. Returns 0 on failure.
+GLuint UploadCompressedImage( const CompressedImage& image );
+
+// Loads the best compressed version of a texture the GPU supports, trying
+// basePath + ".astc.ktx", ".etc2.ktx", ".dxt.ktx" and ".etc1.ktx", in this
+// order. Returns 0 when none of them can be used. The format of the loaded
+// one is returned in internalFormat, if given.
+GLuint LoadCompressedTexture( const std::string& basePath, GLenum* internalFormat = nullptr );
+
+// Size of the ETC1 data of a width x height image (4x4 blocks of 8 bytes).
+size_t ETC1DataSize( int width, int height );
+
+// Fast real time ETC1 encoder (individual mode, no flip, best modifier
+// table per sub-block), good enough for procedural textures. Width and
+// height must be multiples of 4. dst must hold ETC1DataSize() bytes.
+void EncodeETC1( const unsigned char* rgba, int width, int height, int stride, unsigned char* dst );
+
+#endif // COMPRESSED_TEXTURE_HPP
@@ -0,0 +1,52 @@
+#ifndef DISTORTION_MESH_HPP
+#define DISTORTION_MESH_HPP
+
+#include <platform.hpp>
+
+// Lens of a Cardboard viewer, as CardboardProfile describes it for the left
+// eye (the right one is its mirror image). Frustums are tangents of the
+// half angles (left, top, right, bottom) and the viewport is the visible
+// screen rect (x, y, width, height) as a fraction of the whole screen.
+struct DistortionParameters {
+    float k1;
+    float k2;
+    float lensFrustum[4];       // Seen through the lens.
+    float noLensFrustum[4];     // Same screen area, without the lens.
+    float viewport[4];
+};
+
+// Radius r such that r * ( 1 + k1 * r^2 + k2 * r^4 ) == radius, ie. the
+// inverse of the lens distortion (CardboardProfile.Distortion.distortInv).
+float InverseLensDistortion( float k1, float k2, float radius );
+
+
+// Undistortion pass of a side by side stereo image, as a grid per eye whose
+// vertices are barrel distorted on the CPU when the parameters change. The
+// per-pixel work is then a plain texture lookup, instead of evaluating the
+// distortion polynomial for every screen pixel.
+class DistortionMesh {
+    public:
+        // Vertices per side of the grid of an eye.
+        static const unsigned int GRID_SIZE = 40;
+
+        DistortionMesh();
+
+        // Render thread, with a current context.
+        void build( const DistortionParameters& parameters );
+        void release();
+        bool built() const { return indexCount_ != 0; }
+
+        // Draws sourceTexture (both eyes side by side) undistorted over the
+        // current viewport. Edges of the visible area fade to black.
+        void render( GLuint sourceTexture );
+
+    private:
+        GLuint vertexBuffer_;
+        GLuint indexBuffer_;
+        GLsizei indexCount_;
+        GLuint program_;
+        GLint uvLocation_;
+        GLint vignetteLocation_;
+};
+
+#endif // DISTORTION_MESH_HPP
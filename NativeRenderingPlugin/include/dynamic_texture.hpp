@@ -0,0 +1,78 @@
+#ifndef DYNAMIC_TEXTURE_HPP
+#define DYNAMIC_TEXTURE_HPP
+
+#include <platform.hpp>
+#include <procedural_texture.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// A rectangle of texels.
+struct TextureRect {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// CPU copy of a texture updated by the plugin, split in TILE_SIZE x TILE_SIZE
+// tiles. Generators either write to pixels() and mark what they changed, or
+// hand a whole new image to write(), which only marks the tiles whose
+// contents differ. upload() then sends the dirty tiles alone, merged into as
+// few glTexSubImage2D() rectangles as possible.
+class DynamicTexture {
+    public:
+        static const int TILE_SIZE = 32;
+
+        DynamicTexture();
+
+        // (Re)allocates the CPU copy if the size or format changed, marking
+        // the whole texture dirty.
+        void resize( int width, int height, ProceduralTextureFormat format );
+
+        int width() const { return width_; }
+        int height() const { return height_; }
+        ProceduralTextureFormat format() const { return format_; }
+
+        // Rows are tightly packed.
+        int stride() const { return stride_; }
+        unsigned char* pixels() { return pixels_.data(); }
+
+        void markDirty( int x, int y, int width, int height );
+        void markAllDirty();
+        unsigned int dirtyTileCount() const;
+
+        // Copies a full image (in the texture format) into the CPU copy and
+        // marks the tiles which changed.
+        void write( const unsigned char* src, int srcStride );
+
+        // Dirty tiles merged into rectangles: runs of dirty tiles in a tile
+        // row, extended down while the rows below have the same run.
+        void dirtyRects( std::vector< TextureRect >& rects ) const;
+
+        // Uploads the dirty rectangles to the level 0 of texture and clears
+        // them. Everything is uploaded when texture isn't the one of the
+        // previous call, as its contents are unknown. Returns the number of
+        // bytes uploaded.
+        size_t upload( GLuint texture );
+
+    private:
+        int width_;
+        int height_;
+        ProceduralTextureFormat format_;
+        int bytesPerPixel_;
+        int stride_;
+        int tilesX_;
+        int tilesY_;
+        GLuint lastTexture_;
+
+        std::vector< unsigned char > pixels_;
+        std::vector< uint8_t > dirtyTiles_;
+        std::vector< TextureRect > rects_;
+
+        // Sub-rectangles are copied here when GL_UNPACK_ROW_LENGTH isn't
+        // supported.
+        std::vector< unsigned char > repackBuffer_;
+};
+
+#endif // DYNAMIC_TEXTURE_HPP
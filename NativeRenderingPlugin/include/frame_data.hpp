@@ -0,0 +1,36 @@
+#ifndef FRAME_DATA_HPP
+#define FRAME_DATA_HPP
+
+#include <cstdint>
+
+// Version of the FrameData layout. Scripts must check it (first field of the
+// struct) before writing anything and fall back to the per-call API when it
+// doesn't match the layout they were written for.
+const uint32_t FRAME_DATA_VERSION = 2;
+
+// Maximum number of objects whose data can be sent in a single frame.
+const unsigned int MAX_FRAME_OBJECTS = 64;
+
+// Per-object data. Matrices are column-major, as given by Unity's
+// Matrix4x4 indexer.
+struct ObjectData {
+    float modelMatrix[16];
+};
+
+// Persistent block of memory shared with the scripts. Its address never
+// changes during the plugin lifetime, so scripts query it once through
+// GetFrameDataFromUnity(), write each frame's values in place and call
+// CommitFrameDataFromUnity() once per frame.
+struct FrameData {
+    uint32_t version;
+    uint32_t objectCount;
+    float time;
+    uint32_t frameId;   // Unity's Time.frameCount, the same for every eye / camera.
+
+    float viewMatrix[16];
+    float projectionMatrix[16];
+
+    ObjectData objects[MAX_FRAME_OBJECTS];
+};
+
+#endif // FRAME_DATA_HPP
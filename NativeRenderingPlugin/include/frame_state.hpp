@@ -0,0 +1,63 @@
+#ifndef FRAME_STATE_HPP
+#define FRAME_STATE_HPP
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <frame_data.hpp>
+
+// All the inputs Unity's main thread gives us for rendering a frame. A full
+// copy is published to the render thread through a TripleBuffer, so every
+// UnityRenderEvent sees the inputs of exactly one frame.
+struct FrameState {
+    float time;
+
+    // Frame being rendered. Stereo / multi-camera rendering publishes a
+    // FrameState per view with the same frameId. 0 when scripts didn't set
+    // it, which disables per-frame work sharing.
+    unsigned int frameId;
+
+    unsigned int objectCount;
+    glm::mat4 modelMatrices[MAX_FRAME_OBJECTS];
+
+    glm::mat4 viewMatrix;
+    glm::mat4 projectionMatrix;
+    glm::vec4 cameraPos;
+
+    // Side by side stereo (kPluginEventRenderStereoFrame): eye whose camera
+    // issues the event (0: left, 1: right, -1: mono) and the matrices of
+    // both eyes.
+    int stereoEye;
+    glm::mat4 eyeViewMatrices[2];
+    glm::mat4 eyeProjectionMatrices[2];
+
+    void* texturePointer;
+    int texWidth;
+    int texHeight;
+    int texFormat;  // ProceduralTextureFormat.
+
+    FrameState() :
+        time( 0.0f ),
+        frameId( 0 ),
+        objectCount( 0 ),
+        viewMatrix( 1.0f ),
+        projectionMatrix( 1.0f ),
+        cameraPos( 0.0f, 0.0f, 0.0f, 1.0f ),
+        stereoEye( -1 ),
+        texturePointer( nullptr ),
+        texWidth( 0 ),
+        texHeight( 0 ),
+        texFormat( 0 )
+    {}
+};
+
+
+// Position of the camera of a view matrix. View matrices are rigid
+// transforms (plus Unity's z flip), so the inverse of their 3x3 part is its
+// transpose and there is no need for a full matrix inverse.
+inline glm::vec4 CameraPosition( const glm::mat4& viewMatrix )
+{
+    const glm::mat3 rotation( viewMatrix );
+    return glm::vec4( -( glm::transpose( rotation ) * glm::vec3( viewMatrix[3] ) ), 1.0f );
+}
+
+#endif // FRAME_STATE_HPP
@@ -0,0 +1,220 @@
+#ifndef GL_EXTENSIONS_HPP
+#define GL_EXTENSIONS_HPP
+
+#include <platform.hpp>
+
+// Calling convention of GL entry points.
+#if defined(GL_APIENTRY)
+    #define GL_EXT_APIENTRY GL_APIENTRY
+#elif defined(APIENTRY)
+    #define GL_EXT_APIENTRY APIENTRY
+#else
+    #define GL_EXT_APIENTRY
+#endif
+
+// Tokens which may be missing from the GLES2 headers.
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+#ifndef GL_UNIFORM_BUFFER
+#define GL_UNIFORM_BUFFER 0x8A11
+#endif
+#ifndef GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+#define GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT 0x8A34
+#endif
+#ifndef GL_INVALID_INDEX
+#define GL_INVALID_INDEX 0xFFFFFFFFu
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW 0x88E0
+#endif
+#ifndef GL_RED
+#define GL_RED 0x1903
+#endif
+#ifndef GL_UNPACK_ROW_LENGTH
+#define GL_UNPACK_ROW_LENGTH 0x0CF2
+#endif
+#ifndef GL_TEXTURE_2D_ARRAY
+#define GL_TEXTURE_2D_ARRAY 0x8C1A
+#endif
+#ifndef GL_TEXTURE_MAX_LEVEL
+#define GL_TEXTURE_MAX_LEVEL 0x813D
+#endif
+#ifndef GL_TEXTURE_BINDING_2D_ARRAY
+#define GL_TEXTURE_BINDING_2D_ARRAY 0x8C1D
+#endif
+#ifndef GL_DEPTH_COMPONENT24
+#define GL_DEPTH_COMPONENT24 0x81A6
+#endif
+#ifndef GL_SAMPLES_PASSED
+#define GL_SAMPLES_PASSED 0x8914
+#endif
+#ifndef GL_ANY_SAMPLES_PASSED
+#define GL_ANY_SAMPLES_PASSED 0x8C2F
+#endif
+#ifndef GL_ANY_SAMPLES_PASSED_CONSERVATIVE
+#define GL_ANY_SAMPLES_PASSED_CONSERVATIVE 0x8D6A
+#endif
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT 0x8866
+#endif
+#ifndef GL_QUERY_RESULT_AVAILABLE
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#endif
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#endif
+#ifndef GL_COMMAND_BARRIER_BIT
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#endif
+#ifndef GL_BUFFER_UPDATE_BARRIER_BIT
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+#endif
+#ifndef GL_DYNAMIC_COPY
+#define GL_DYNAMIC_COPY 0x88EA
+#endif
+#ifndef GL_MAP_READ_BIT
+#define GL_MAP_READ_BIT 0x0001
+#endif
+
+typedef void (GL_EXT_APIENTRY *PFN_GetProgramBinary)( GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary );
+typedef void (GL_EXT_APIENTRY *PFN_ProgramBinary)( GLuint program, GLenum binaryFormat, const void* binary, GLsizei length );
+typedef void (GL_EXT_APIENTRY *PFN_ProgramParameteri)( GLuint program, GLenum pname, GLint value );
+typedef void (GL_EXT_APIENTRY *PFN_MaxShaderCompilerThreads)( GLuint count );
+typedef GLuint (GL_EXT_APIENTRY *PFN_GetUniformBlockIndex)( GLuint program, const GLchar* uniformBlockName );
+typedef void (GL_EXT_APIENTRY *PFN_UniformBlockBinding)( GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding );
+typedef void (GL_EXT_APIENTRY *PFN_BindBufferRange)( GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size );
+typedef void (GL_EXT_APIENTRY *PFN_BindBufferBase)( GLenum target, GLuint index, GLuint buffer );
+typedef void (GL_EXT_APIENTRY *PFN_TexImage3D)( GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void* pixels );
+typedef void (GL_EXT_APIENTRY *PFN_FramebufferTextureLayer)( GLenum target, GLenum attachment, GLuint texture, GLint level, GLint layer );
+typedef void (GL_EXT_APIENTRY *PFN_DrawElementsInstanced)( GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instanceCount );
+typedef void (GL_EXT_APIENTRY *PFN_FramebufferTextureMultiview)( GLenum target, GLenum attachment, GLuint texture, GLint level, GLint baseViewIndex, GLsizei numViews );
+typedef void (GL_EXT_APIENTRY *PFN_GenQueries)( GLsizei n, GLuint* ids );
+typedef void (GL_EXT_APIENTRY *PFN_DeleteQueries)( GLsizei n, const GLuint* ids );
+typedef void (GL_EXT_APIENTRY *PFN_BeginQuery)( GLenum target, GLuint id );
+typedef void (GL_EXT_APIENTRY *PFN_EndQuery)( GLenum target );
+typedef void (GL_EXT_APIENTRY *PFN_GetQueryObjectuiv)( GLuint id, GLenum pname, GLuint* params );
+typedef void (GL_EXT_APIENTRY *PFN_DispatchCompute)( GLuint numGroupsX, GLuint numGroupsY, GLuint numGroupsZ );
+typedef void (GL_EXT_APIENTRY *PFN_MemoryBarrier)( GLbitfield barriers );
+typedef void (GL_EXT_APIENTRY *PFN_DrawElementsIndirect)( GLenum mode, GLenum type, const void* indirect );
+typedef void (GL_EXT_APIENTRY *PFN_VertexAttribDivisor)( GLuint index, GLuint divisor );
+typedef void (GL_EXT_APIENTRY *PFN_GenVertexArrays)( GLsizei n, GLuint* arrays );
+typedef void (GL_EXT_APIENTRY *PFN_DeleteVertexArrays)( GLsizei n, const GLuint* arrays );
+typedef void (GL_EXT_APIENTRY *PFN_BindVertexArray)( GLuint array );
+typedef void* (GL_EXT_APIENTRY *PFN_MapBufferRange)( GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access );
+typedef GLboolean (GL_EXT_APIENTRY *PFN_UnmapBuffer)( GLenum target );
+
+// Capabilities of the current GL context and the optional entry points we
+// use. Entry points are resolved at runtime (core, OES or ARB flavour,
+// whichever is available) and are null when unsupported, so the plugin can
+// be built against plain GLES2 headers.
+struct GLExtensions {
+    bool isES;
+    int majorVersion;
+    int minorVersion;
+
+    // OES_get_program_binary / ARB_get_program_binary / GLES3 / GL 4.1.
+    bool programBinary;
+    PFN_GetProgramBinary getProgramBinary;
+    PFN_ProgramBinary programBinaryFunc;
+    PFN_ProgramParameteri programParameteri;
+
+    // KHR_parallel_shader_compile / ARB_parallel_shader_compile. When
+    // supported, compile and link status can be polled with
+    // GL_COMPLETION_STATUS_KHR without blocking.
+    bool parallelShaderCompile;
+    PFN_MaxShaderCompilerThreads maxShaderCompilerThreads;
+
+    // GLSL 3 shaders (#version 300 es / 140) and uniform buffer objects
+    // (GLES 3.0 / GL 3.1).
+    bool uniformBuffers;
+    const char* glslVersionDirective;
+    PFN_GetUniformBlockIndex getUniformBlockIndex;
+    PFN_UniformBlockBinding uniformBlockBinding;
+    PFN_BindBufferRange bindBufferRange;
+    PFN_BindBufferBase bindBufferBase;
+
+    // GL_TEXTURE_2D_ARRAY (GLES 3.0 / GL 3.0). Only enabled along with
+    // uniformBuffers, as sampling them needs GLSL 3 shaders.
+    bool textureArrays;
+    PFN_TexImage3D texImage3D;
+    PFN_FramebufferTextureLayer framebufferTextureLayer;
+
+    // Stereo rendering of both eyes with a single draw (see stereo.hpp).
+    // Instanced stereo needs GLSL 3 and instanced draws (GLES 3.0 / GL 3.1),
+    // multiview also needs OVR_multiview and texture arrays.
+    bool instancedStereo;
+    PFN_DrawElementsInstanced drawElementsInstanced;
+    bool multiview;
+    PFN_FramebufferTextureMultiview framebufferTextureMultiview;
+
+    // Occlusion queries (GLES 3.0 / EXT_occlusion_query_boolean / GL 1.5).
+    // occlusionQueryTarget is the cheapest target telling whether anything
+    // was drawn: GL_ANY_SAMPLES_PASSED_CONSERVATIVE (GLES, GL 4.3 /
+    // ARB_ES3_compatibility), GL_ANY_SAMPLES_PASSED (GL 3.3) or
+    // GL_SAMPLES_PASSED.
+    bool occlusionQueries;
+    GLenum occlusionQueryTarget;
+    PFN_GenQueries genQueries;
+    PFN_DeleteQueries deleteQueries;
+    PFN_BeginQuery beginQuery;
+    PFN_EndQuery endQuery;
+    PFN_GetQueryObjectuiv getQueryObjectuiv;
+
+    // Compute shaders, shader storage buffers and indirect draws (GLES 3.1 /
+    // GL 4.3), plus what GPU driven rendering needs along with them: vertex
+    // array objects (indirect draws need one bound), instanced attributes and
+    // buffer mapping (GLES 3.0 / GL 3.0). glslComputeVersionDirective is the
+    // directive of compute shader sources (#version 310 es / 430).
+    bool computeShaders;
+    const char* glslComputeVersionDirective;
+    PFN_DispatchCompute dispatchCompute;
+    PFN_MemoryBarrier memoryBarrier;
+    PFN_DrawElementsIndirect drawElementsIndirect;
+    PFN_VertexAttribDivisor vertexAttribDivisor;
+    PFN_GenVertexArrays genVertexArrays;
+    PFN_DeleteVertexArrays deleteVertexArrays;
+    PFN_BindVertexArray bindVertexArray;
+    PFN_MapBufferRange mapBufferRange;
+    PFN_UnmapBuffer unmapBuffer;
+
+    // GL_UNPACK_ROW_LENGTH (GL / GLES 3.0 / EXT_unpack_subimage), so
+    // sub-rectangles of an image can be uploaded without repacking them.
+    bool unpackRowLength;
+
+    // Compressed texture formats the GPU can sample.
+    bool compressedETC1;    // OES_compressed_ETC1_RGB8_texture.
+    bool compressedETC2;    // GLES 3.0 / GL 4.3 / ARB_ES3_compatibility.
+    bool compressedASTC;    // KHR_texture_compression_astc_ldr.
+    bool compressedS3TC;    // EXT_texture_compression_s3tc (DXT1 / DXT3 / DXT5).
+};
+
+extern GLExtensions glext;
+
+// Fills glext for the current context. Must be called on the render thread,
+// every time the graphics device is (re)initialized.
+void InitGLExtensions();
+
+bool HasGLExtension( const char* name );
+
+bool IsGLVersionAtLeast( int major, int minor );
+
+#endif // GL_EXTENSIONS_HPP
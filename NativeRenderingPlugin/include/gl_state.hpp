@@ -0,0 +1,114 @@
+#ifndef GL_STATE_HPP
+#define GL_STATE_HPP
+
+#include <platform.hpp>
+
+// Saves the GL state an offscreen pass of ours changes (framebuffer,
+// viewport, program, the 2D and 2D array textures of unit 0, array buffer
+// and the blend / depth / cull / scissor tests, which it disables) and restores it when destroyed,
+// so the pass is invisible to Unity. The pass is free to change any state
+// behind glState's back: it is invalidated on restore.
+class ScopedRenderTargetState {
+    public:
+        ScopedRenderTargetState();
+        ~ScopedRenderTargetState();
+
+    private:
+        ScopedRenderTargetState( const ScopedRenderTargetState& ) = delete;
+        ScopedRenderTargetState& operator=( const ScopedRenderTargetState& ) = delete;
+
+        static const unsigned int N_CAPABILITIES = 4;
+
+        GLint framebuffer_;
+        GLint program_;
+        GLint activeTexture_;
+        GLint texture_;
+        GLint arrayTexture_;    // Only with texture arrays.
+        GLint arrayBuffer_;
+        GLint viewport_[4];
+        GLboolean capabilities_[N_CAPABILITIES];
+};
+
+
+// Shadow of the GL state our draws set (blend / depth / cull / scissor
+// tests, blend and depth functions, depth mask, program, texture bindings,
+// array and element array buffers and vertex attributes), so only actual
+// changes reach GL.
+//
+// Unity changes the state between our render events, so the shadow is
+// forgotten at the start of every event, and by anything that changes
+// shadowed state without going through it (including deleting a bound
+// object): values are unknown after invalidate() until they are set again.
+class GLStateCache {
+    public:
+        GLStateCache();
+
+        void invalidate();
+
+        void setEnabled( GLenum capability, bool enabled );
+        void blendFunc( GLenum sourceFactor, GLenum destinationFactor );
+        void depthFunc( GLenum function );
+        void depthMask( GLboolean mask );
+        void useProgram( GLuint program );
+        void activeTexture( GLenum unit );
+        void bindTexture( GLenum target, GLuint texture );
+        void bindBuffer( GLenum target, GLuint buffer );
+        void setVertexAttribArrayEnabled( GLuint index, bool enabled );
+        void vertexAttribPointer( GLuint index, GLint size, GLenum type, GLboolean normalized,
+                                  GLsizei stride, const GLvoid* pointer );
+
+        // GL calls made / avoided through the cache since it was created.
+        unsigned int issuedCalls() const { return issuedCalls_; }
+        unsigned int avoidedCalls() const { return avoidedCalls_; }
+
+    private:
+        GLStateCache( const GLStateCache& ) = delete;
+        GLStateCache& operator=( const GLStateCache& ) = delete;
+
+        template < class T >
+        struct Shadowed {
+            T value;
+            bool known;
+        };
+
+        struct AttribPointer {
+            GLuint buffer;
+            GLint size;
+            GLenum type;
+            GLboolean normalized;
+            GLsizei stride;
+            const GLvoid* pointer;
+
+            bool operator == ( const AttribPointer& other ) const;
+        };
+
+        // Updates a shadowed value. Returns whether GL must be called.
+        template < class T >
+        bool change( Shadowed< T >& shadow, const T& value );
+
+        static const unsigned int N_CAPABILITIES = 4;
+        static const unsigned int N_TEXTURE_UNITS = 4;
+        static const unsigned int N_TEXTURE_TARGETS = 2;     // 2D, 2D array.
+        static const unsigned int N_BUFFER_TARGETS = 2;      // Array, element array.
+        static const unsigned int N_VERTEX_ATTRIBS = 8;
+
+        Shadowed< bool > capabilities_[N_CAPABILITIES];
+        Shadowed< GLenum > blendSourceFactor_;
+        Shadowed< GLenum > blendDestinationFactor_;
+        Shadowed< GLenum > depthFunc_;
+        Shadowed< GLboolean > depthMask_;
+        Shadowed< GLuint > program_;
+        Shadowed< GLenum > activeTexture_;
+        Shadowed< GLuint > textures_[N_TEXTURE_UNITS][N_TEXTURE_TARGETS];
+        Shadowed< GLuint > buffers_[N_BUFFER_TARGETS];
+        Shadowed< bool > vertexAttribArrays_[N_VERTEX_ATTRIBS];
+        Shadowed< AttribPointer > vertexAttribPointers_[N_VERTEX_ATTRIBS];
+
+        unsigned int issuedCalls_;
+        unsigned int avoidedCalls_;
+};
+
+// Render thread only.
+extern GLStateCache glState;
+
+#endif // GL_STATE_HPP
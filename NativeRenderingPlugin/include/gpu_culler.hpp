@@ -0,0 +1,97 @@
+#ifndef GPU_CULLER_HPP
+#define GPU_CULLER_HPP
+
+#include <platform.hpp>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include <lod_plane.hpp>
+
+// Planes of the frustum of a view projection matrix (left, right, bottom,
+// top, near, far), normalized and facing inwards: a point p is inside when
+// dot( plane.xyz, p ) + plane.w >= 0 for all of them.
+void FrustumPlanes( const glm::mat4& viewProjectionMatrix, glm::vec4 planes[6] );
+
+// GPU driven culling and LOD selection of the instances of a LODPlane, so
+// the CPU cost of drawing them doesn't depend on their number.
+//
+// The model matrices of the instances are uploaded to a shader storage
+// buffer with a single write, and a compute shader (an invocation per
+// instance) frustum culls them, selects their LOD level as
+// LODPlane::selectLOD() does and appends the matrices of the visible ones
+// to their level's part of an instance buffer, counting them in the
+// level's DrawElementsIndirect command. Each level is then drawn with one
+// indirect draw of the SHADER_FEATURE_INSTANCING variants (instance
+// matrices as attributes, object uniforms with an identity model matrix),
+// without reading anything back.
+//
+// Needs glext.computeShaders. Instances are drawn in no particular order.
+class GPUCuller {
+    public:
+        GPUCuller();
+
+        // Render thread, with a current context. init() builds the compute
+        // program and the plane buffers; it returns false (and the culler
+        // stays uninitialized) when they can't be built.
+        bool init( const LODPlane& plane );
+        void release();
+        bool initialized() const { return program_ != 0; }
+
+        // Culls instanceCount instances (model matrices) and selects their
+        // LOD levels, as seen with viewProjectionMatrix from cameraPos.
+        void cull( const glm::mat4* modelMatrices,
+                   unsigned int instanceCount,
+                   const glm::mat4& viewProjectionMatrix,
+                   const glm::vec4& cameraPos );
+
+        // Draws the instances of a level kept by the last cull(), with the
+        // current program, which must be an instancing variant.
+        void draw( unsigned int lodLevel );
+
+        // Instances per level kept by the last cull(). Waits for the GPU
+        // (debugging and tests only).
+        void readInstanceCounts( unsigned int counts[3] );
+
+    private:
+        GPUCuller( const GPUCuller& ) = delete;
+        GPUCuller& operator=( const GPUCuller& ) = delete;
+
+        // std430 layout of a DrawElementsIndirect command.
+        struct DrawCommand {
+            GLuint count;
+            GLuint instanceCount;
+            GLuint firstIndex;
+            GLint baseVertex;
+            GLuint reserved;    // baseInstance on desktop GL, must be 0 on GLES.
+        };
+
+        static const unsigned int N_LOD_LEVELS = 3;
+        static const unsigned int WORK_GROUP_SIZE = 64;
+
+        void reserve( unsigned int capacity );
+        void setupVertexArray( unsigned int lodLevel );
+
+        GLuint program_;
+        GLint instanceCountLocation_;
+        GLint capacityLocation_;
+        GLint frustumPlanesLocation_;
+        GLint boundingSphereLocation_;
+        GLint centroidLocation_;
+        GLint cameraPositionLocation_;
+        GLint lodDistancesLocation_;
+
+        GLuint vertexBuffer_;
+        GLuint indexBuffer_;
+        GLuint instanceBuffer_;     // Input model matrices.
+        GLuint visibleBuffer_;      // Kept model matrices, capacity_ per level.
+        GLuint commandBuffer_;
+        GLuint vertexArrays_[N_LOD_LEVELS];
+        unsigned int capacity_;
+
+        glm::vec4 boundingSphere_;  // Object space center, radius.
+        glm::vec4 centroid_;
+        glm::vec2 lodDistances_;
+        DrawCommand commands_[N_LOD_LEVELS];     // With no instances.
+};
+
+#endif // GPU_CULLER_HPP
@@ -29,9 +29,48 @@ class LODPlane {
 		LODPlane( GLuint textureID = 0 );
     
 		void setTextureID( GLuint textureID, unsigned int lodLevel );
-        void render( float distanceToObserver );
+        GLuint textureID( unsigned int lodLevel ) const;
+
+        // Slot of the level texture in a TexturePacker (-1 if not packed).
+        // Packed levels are rendered with the packed texture already bound.
+        void setTextureSlot( int slot, unsigned int lodLevel );
+        int textureSlot( unsigned int lodLevel ) const;
+
+        // Whether the level texture has no translucent texel. Opaque levels
+        // are drawn without blending (and premultiplying). Levels are
+        // translucent until told otherwise.
+        void setTextureOpaque( bool opaque, unsigned int lodLevel );
+        bool textureOpaque( unsigned int lodLevel ) const;
+
+        // LOD level to be used at the given distance from the observer:
+        // the first level whose lodDistance() it is beyond.
+        unsigned int selectLOD( float distanceToObserver ) const;
+        float lodDistance( unsigned int lodLevel ) const;
+
+        // Minimal shader features needed for rendering the given LOD level.
+        unsigned int shaderFeatures( unsigned int lodLevel ) const;
+
+        // Instances are only used by the instanced stereo variants (one per
+        // eye), so instanceCount > 1 needs glext.drawElementsInstanced.
+        void render( unsigned int lodLevel, unsigned int instanceCount = 1 );
+
+        // Binds the level texture to unit 0 (nothing for packed levels).
+        void bindTexture( unsigned int lodLevel ) const;
+
+        // Vertices and indices of every level, for uploading them to buffer
+        // objects. Each level is a range of indices.
+        const std::vector< MyVertex >& vertices() const { return vertices_; }
+        const std::vector< GLubyte >& indices() const { return indices_; }
+        void levelIndices( unsigned int lodLevel, unsigned int& firstIndex, unsigned int& indexCount ) const;
 
         glm::vec4 centroid() const;
+
+        // Axis aligned bounding box, in object space.
+        void bounds( glm::vec3& boxMin, glm::vec3& boxMax ) const;
+
+        // Mesh of the coarsest level (positions, 3 indices per triangle), as
+        // an occluder for the software occlusion culler.
+        void occluderMesh( std::vector< glm::vec3 >& vertices, std::vector< uint16_t >& indices ) const;
     
     private:
         void subdividePlane( std::vector< MyVertex >& vertices,
@@ -41,6 +80,8 @@ class LODPlane {
         std::vector< MyVertex > vertices_;
         std::vector< GLubyte > indices_;
 		std::vector < unsigned int > textureIDs_;
+        std::vector< int > textureSlots_;
+        std::vector< bool > textureOpaque_;
 };
 
 #endif 
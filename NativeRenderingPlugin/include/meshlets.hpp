@@ -0,0 +1,59 @@
+#ifndef MESHLETS_HPP
+#define MESHLETS_HPP
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Meshlets: small clusters of the triangles of a mesh, culled one by one on
+// the CPU so big meshes only submit the parts which may be seen. Building
+// them needs no GL (nor does culling them).
+
+const unsigned int MAX_MESHLET_VERTICES = 64;
+const unsigned int MAX_MESHLET_TRIANGLES = 124;
+
+// Range of triangles of a meshlet, in the triangle list BuildMeshlets()
+// gives.
+struct Meshlet {
+    unsigned int firstTriangle;
+    unsigned int triangleCount;
+    unsigned int vertexCount;   // Distinct vertices used.
+};
+
+// Bounding sphere and normal cone of a meshlet. The meshlet faces away from
+// any camera position p for which
+// dot( center - p, coneAxis ) >= coneCutoff * length( center - p ) + radius
+// (coneCutoff is 1 when its normals are too spread for that to happen).
+struct MeshletBounds {
+    glm::vec3 center;
+    float radius;
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+// Splits a triangle list (3 indices per triangle, into vertexCount
+// vertices) into meshlets of up to MAX_MESHLET_VERTICES vertices and
+// MAX_MESHLET_TRIANGLES triangles. Each meshlet is grown from a seed
+// triangle by adding the neighbour triangles which add the fewest new
+// vertices, so meshlets are compact and their bounds tight. Gives the
+// triangles reordered so each meshlet is a contiguous range of them.
+void BuildMeshlets( const uint16_t* indices,
+                    unsigned int indexCount,
+                    unsigned int vertexCount,
+                    std::vector< uint16_t >& meshletIndices,
+                    std::vector< Meshlet >& meshlets );
+
+// Bounds of the given triangles (3 indices each) of a mesh. Front faces are
+// counter clockwise.
+MeshletBounds ComputeMeshletBounds( const glm::vec3* positions,
+                                    const uint16_t* indices,
+                                    unsigned int triangleCount );
+
+// Whether a meshlet may be seen from cameraPos: its sphere isn't out of
+// the frustum (planes as FrustumPlanes() gives them) and it doesn't face
+// away from the camera.
+bool MeshletVisible( const MeshletBounds& bounds, const glm::vec4 frustumPlanes[6], const glm::vec3& cameraPos );
+
+#endif // MESHLETS_HPP
@@ -0,0 +1,85 @@
+#ifndef OCCLUSION_CULLER_HPP
+#define OCCLUSION_CULLER_HPP
+
+#include <platform.hpp>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// How the planes hidden behind other geometry are culled.
+enum OcclusionCullingMode {
+    kOcclusionCullingOff = 0,
+    kOcclusionCullingQueries,   // OcclusionCuller: against Unity's depth, on the GPU.
+    kOcclusionCullingSoftware   // SoftwareOcclusionCuller: against our opaque planes, on the CPU.
+};
+
+// Occlusion culling of the objects of a view with hardware occlusion
+// queries, exploiting temporal coherence as CHC++ does:
+//
+// - Queries draw the bounding box of an object (color and depth writes off)
+//   against the depth buffer, and their results are only read when the GPU
+//   already has them, so the pipeline never stalls. Objects are culled with
+//   the latest result available (usually the previous frame's).
+// - Invisible objects are queried every frame, so they show up as soon as
+//   possible. Visible ones are assumed to stay visible for a while: the
+//   longer they have been visible, the longer until they are queried again.
+//
+// Objects are identified by their index, so it is the caller's job to keep
+// them in the same order from frame to frame. A change in the number of
+// objects restarts their histories. Needs glext.occlusionQueries.
+class OcclusionCuller {
+    public:
+        OcclusionCuller();
+
+        // Render thread, with a current context.
+        void release();
+
+        // Starts a frame with objectCount objects, collecting the results
+        // which are already available.
+        void beginFrame( unsigned int objectCount );
+
+        // Whether the object must be drawn this frame (true until its first
+        // query result is known).
+        bool visible( unsigned int object ) const;
+
+        // Issues the queries due this frame. Objects are the box (boxMin,
+        // boxMax), in object space, transformed by each model matrix. Must be
+        // called with the depth buffer the objects are occluded by already
+        // filled, and changes the graphics state (through glState, plus the
+        // color mask, which is restored).
+        void issueQueries( const glm::mat4* modelMatrices,
+                           const glm::mat4& viewProjectionMatrix,
+                           const glm::vec3& boxMin,
+                           const glm::vec3& boxMax );
+
+    private:
+        OcclusionCuller( const OcclusionCuller& ) = delete;
+        OcclusionCuller& operator=( const OcclusionCuller& ) = delete;
+
+        struct ObjectState {
+            GLuint query;
+            bool pending;               // Query issued, result not read yet.
+            bool visible;
+            unsigned int history;       // Consecutive results equal to visible.
+            unsigned int nextQueryFrame;
+        };
+
+        void initProxy();
+        void setResult( unsigned int object, bool visible );
+
+        // Re-query intervals of visible objects, in frames.
+        static const unsigned int MIN_VISIBLE_INTERVAL = 2;
+        static const unsigned int MAX_VISIBLE_INTERVAL = 16;
+
+        std::vector< ObjectState > objects_;
+        unsigned int frame_;
+        GLuint program_;
+        GLint mvpLocation_;
+        GLint boxMinLocation_;
+        GLint boxSizeLocation_;
+        GLuint vertexBuffer_;
+        GLuint indexBuffer_;
+};
+
+#endif // OCCLUSION_CULLER_HPP
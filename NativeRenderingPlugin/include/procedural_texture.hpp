@@ -0,0 +1,98 @@
+#ifndef PROCEDURAL_TEXTURE_HPP
+#define PROCEDURAL_TEXTURE_HPP
+
+#include <platform.hpp>
+
+#include <vector>
+
+// How the procedural (plasma) texture is generated.
+enum ProceduralTextureBackend {
+    kProceduralTextureCPU = 0,  // FillTextureFromCode() + glTexSubImage2D.
+    kProceduralTextureGPU       // Fragment shader rendering into the texture.
+};
+
+// Texel formats the procedural texture can be uploaded in. The plasma is
+// grey, so single channel textures carry the same image with a quarter of
+// the bandwidth (materials sampling them must swizzle).
+enum ProceduralTextureFormat {
+    kProceduralTextureRGBA32 = 0,   // GL_RGBA / GL_UNSIGNED_BYTE.
+    kProceduralTextureAlpha8,       // GL_ALPHA (GLES) or GL_RED (desktop) / GL_UNSIGNED_BYTE.
+    kProceduralTextureRGB565,       // GL_RGB / GL_UNSIGNED_SHORT_5_6_5.
+
+    N_PROCEDURAL_TEXTURE_FORMATS
+};
+
+int ProceduralTextureBytesPerPixel( ProceduralTextureFormat format );
+
+// glTexSubImage2D() format and type for uploading to a texture of the
+// given format in the current context.
+void ProceduralTextureUploadFormat( ProceduralTextureFormat format, GLenum& glFormat, GLenum& glType );
+
+// Fills a width x height RGBA image with the plasma at the given time.
+// Reference implementation: four sines per pixel.
+void FillTextureFromCode( int width, int height, int stride, float time, unsigned char* dst );
+
+
+// Same plasma as FillTextureFromCode(), with the sines out of the per pixel
+// loop. Three of its terms only depend on x, y or x + y, so they are 1D
+// tables computed each frame (O(width + height) sines). The radial one,
+// sin( r - t ) = sin( r ) cos( t ) - cos( r ) sin( t ), only needs the
+// per resolution sin( r ) and cos( r ) tables, computed once. Results may
+// differ from the reference by one level due to rounding.
+class PlasmaEvaluator {
+    public:
+        PlasmaEvaluator();
+
+        void fill( int width, int height, int stride, float time, unsigned char* dst,
+                   ProceduralTextureFormat format = kProceduralTextureRGBA32 );
+
+        // Same as fill(), for rows [firstRow, firstRow + rowCount) of the
+        // image only. dst is still the start of the whole image.
+        void fillSlice( int width, int height, int firstRow, int rowCount, int stride, float time,
+                        unsigned char* dst, ProceduralTextureFormat format = kProceduralTextureRGBA32 );
+
+    private:
+        void resize( int width, int height );
+
+        template < class StoreTexel >
+        void fillRows( int width, int firstRow, int rowCount, int stride, unsigned char* dst, float cosT, float sinT );
+
+        int width_;
+        int height_;
+        std::vector< float > radialSin_;    // 127 * sin( r / 4 ), per pixel.
+        std::vector< float > radialCos_;    // 127 * cos( r / 4 ), per pixel.
+        std::vector< float > xTerm_;
+        std::vector< float > yTerm_;
+        std::vector< float > diagonalTerm_;
+};
+
+
+// Renders the same plasma as FillTextureFromCode() straight into a GL
+// texture, through a framebuffer object. No CPU work and no upload.
+class GPUPlasmaGenerator {
+    public:
+        GPUPlasmaGenerator();
+
+        // Render thread, with a current context.
+        void init();
+        void release();
+        bool initialized() const { return framebuffer_ != 0; }
+
+        // Renders into the level 0 of texture. Returns false if the texture
+        // can't be rendered to (ie. its format isn't color renderable), so
+        // the caller can fall back to the CPU path.
+        bool render( GLuint texture, int width, int height, float time );
+
+    private:
+        GLuint framebuffer_;
+        GLuint program_;
+        GLint timeLocation_;
+};
+
+
+// Renders the plasma with both backends into a width x height texture and
+// returns the biggest difference between two channel values (0 - 255), or
+// -1 if the GPU backend failed. Render thread, with a current context.
+int CompareProceduralTextureBackends( GPUPlasmaGenerator& generator, int width, int height, float time );
+
+#endif // PROCEDURAL_TEXTURE_HPP
@@ -0,0 +1,49 @@
+#ifndef RENDER_QUEUE_HPP
+#define RENDER_QUEUE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 64 bit draw sort key. From the most significant bits:
+//
+//   pass (4) | transparent (1) | depth (24) | shader variant (9) |
+//   texture (16) | LOD level (2) | unused (8)
+//
+// so draws are grouped by pass, opaque draws go before transparent ones, and
+// then they are ordered by depth: front to back for opaque draws (early Z
+// rejects what they hide) and back to front for transparent ones (correct
+// blending). Draws at the same depth are grouped by state. depth is
+// normalized to [0, 1] (ie. window depth), 0 being the nearest.
+uint64_t MakeSortKey( unsigned int pass,
+                      bool transparent,
+                      float depth,
+                      unsigned int shaderVariant,
+                      unsigned int texture,
+                      unsigned int lodLevel );
+
+
+struct RenderQueueEntry {
+    uint64_t key;
+    uint32_t index;     // Draw of the caller (ie. object index).
+};
+
+
+// Draws of a frame, sorted by key with a LSD radix sort: linear in the
+// number of draws, stable, and skipping the bytes all keys share (most of
+// them when there are few draws).
+class RenderQueue {
+    public:
+        void clear() { entries_.clear(); }
+        void push( uint64_t key, uint32_t index );
+        void sort();
+
+        size_t size() const { return entries_.size(); }
+        const std::vector< RenderQueueEntry >& entries() const { return entries_; }
+
+    private:
+        std::vector< RenderQueueEntry > entries_;
+        std::vector< RenderQueueEntry > scratch_;
+};
+
+#endif // RENDER_QUEUE_HPP
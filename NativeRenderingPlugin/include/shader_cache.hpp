@@ -0,0 +1,42 @@
+#ifndef SHADER_CACHE_HPP
+#define SHADER_CACHE_HPP
+
+#include <platform.hpp>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// On-disk cache of linked program binaries (OES/ARB_get_program_binary).
+// Entries are keyed by a hash of the shader sources and the driver identity
+// (vendor, renderer and version), so a driver update or a shader change just
+// produces a different key. Invalid or stale entries are discarded and the
+// caller rebuilds the program from source.
+class ShaderCache {
+    public:
+        // Directory where binaries are stored. Nothing is cached until one is
+        // set. May be called from any thread.
+        void setDirectory( const std::string& directory );
+
+        // Key for a program built from the given sources with the current
+        // driver. Must be called on the render thread.
+        uint64_t programKey( const std::vector< const char* >& sources ) const;
+
+        // Returns a linked program created from the cached binary, or 0 if
+        // there is no valid entry for the key.
+        GLuint loadProgram( uint64_t key );
+
+        // Stores the binary of a linked program.
+        void storeProgram( uint64_t key, GLuint program );
+
+    private:
+        bool filePath( uint64_t key, std::string& path );
+
+        std::mutex directoryMutex_;
+        std::string directory_;
+};
+
+uint64_t HashFNV1a( const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ULL );
+
+#endif // SHADER_CACHE_HPP
@@ -5,13 +5,72 @@
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <uniform_buffers.hpp>
+#include <string>
+#include <vector>
+
+// Features a shader variant can be specialized for. Each one enables a
+// #define of the same name in the plugin shader source, so a variant only
+// pays for the features it uses.
+enum ShaderFeature {
+    SHADER_FEATURE_TEXTURE         = 1 << 0,   // Sample textureSampler.
+    SHADER_FEATURE_VERTEX_COLOR    = 1 << 1,   // Modulate by the vertex color.
+    SHADER_FEATURE_PREMULTIPLY     = 1 << 2,   // Premultiply color by alpha.
+    SHADER_FEATURE_GEOMORPH        = 1 << 3,   // Morph towards morphPos by morphFactor.
+    SHADER_FEATURE_INSTANCING      = 1 << 4,   // Per-instance model matrix attribute.
+    SHADER_FEATURE_FOG             = 1 << 5,   // Linear fog on view distance.
+    SHADER_FEATURE_PACKED_TEXTURE  = 1 << 6,   // Sample a TexturePacker region / layer.
+    SHADER_FEATURE_STEREO          = 1 << 7,   // Instanced stereo: instance i is eye i, drawn in its half of the viewport.
+    SHADER_FEATURE_MULTIVIEW       = 1 << 8,   // OVR_multiview: view i is eye i.
+
+    N_SHADER_FEATURES = 9
+};
+
+// Variant used by the plugin planes when nothing else is asked for.
+const unsigned int DEFAULT_SHADER_FEATURES = SHADER_FEATURE_TEXTURE | SHADER_FEATURE_PREMULTIPLY;
 
 static GLuint CreateShader(GLenum type, const char* text );
+void SetShaderCacheDirectory( const std::string& directory );
 void InitShaders();
-void SendMatricesToShader( const glm::mat4& modelMatrix,
-                           const glm::mat4& viewMatrix,
-                           const glm::mat4& projectionMatrix );
+void ReleaseShaders();
+
+// Starts building the given variants ahead of time (in parallel when the
+// driver supports KHR_parallel_shader_compile).
+void PrecompileShaderVariants( const std::vector< unsigned int >& variants );
+
+// Binds the variant for the given features. While it is being built
+// asynchronously, the default variant is bound instead. Returns false when
+// no variant could be bound.
+bool UseShaderVariant( unsigned int features );
+
+// Per-frame uniforms. One buffer write per call (nothing without uniform
+// buffers).
+void SendFrameUniforms( const glm::mat4& viewMatrix,
+                        const glm::mat4& projectionMatrix,
+                        float time );
+
+// Uploads the uniforms of a batch of objects (one buffer write) and makes
+// the object at objectIndex in the last uploaded batch the current one.
+void UploadObjectUniforms( const std::vector< ObjectUniforms >& objects );
+void SendObjectUniforms( unsigned int objectIndex );
+
+// Per-eye matrices of the stereo variants (uniform buffers only). rightEyeX
+// is the window x where the right half of the viewport starts.
+void SendStereoUniforms( const glm::mat4 eyeViewProjMatrices[2], float rightEyeX );
+
+void SendFogToShader( const glm::vec4& fogColor, float fogStart, float fogEnd );
+void SendMorphFactorToShader( float morphFactor );
 bool UsePluginShader();
 
-#endif // SHADERS_HPP
+// Builds a program for the plugin's own offscreen passes (not a variant, not
+// cached). Sources are GLSL ES 1.00 and get the GLSL version directive of
+// the context; the "pos" attribute is bound to location 0. Returns 0 on
+// failure.
+GLuint BuildUtilityProgram( const char* vertexCode, const char* fragmentCode );
+
+// Builds a compute program (not cached either). Sources get the compute
+// GLSL version directive of the context. Needs glext.computeShaders.
+// Returns 0 on failure.
+GLuint BuildComputeProgram( const char* computeCode );
 
+#endif // SHADERS_HPP
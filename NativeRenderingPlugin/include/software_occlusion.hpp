@@ -0,0 +1,112 @@
+#ifndef SOFTWARE_OCCLUSION_HPP
+#define SOFTWARE_OCCLUSION_HPP
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// CPU occlusion culling, independent of the GPU (and of GL: it can be used
+// and tested without a context).
+//
+// Every frame, big occluders are rasterized into a low resolution depth
+// buffer (window depth, 0 nearest) and objects are tested against the
+// farthest depth of each 8x8 pixel block they cover. Occluder triangles are
+// binned into screen tiles as they are added, and tiles are rasterized in
+// parallel (4 pixels at a time, with SSE2 or NEON when available) by a pool
+// of worker threads plus the calling one. Tiles don't share pixels, so
+// workers never synchronize but to start and finish.
+//
+// Culling is conservative: occluder triangles crossing the near plane are
+// dropped, and objects crossing it are always visible.
+class SoftwareOcclusionCuller {
+    public:
+        static const int WIDTH = 256;
+        static const int HEIGHT = 128;
+        static const int TILE_WIDTH = 64;
+        static const int TILE_HEIGHT = 32;
+        static const int BLOCK_SIZE = 8;
+
+        // Worker threads (started on the first rasterize()), besides the
+        // calling one. -1: one less than the hardware threads, up to 3.
+        explicit SoftwareOcclusionCuller( int nWorkers = -1 );
+        ~SoftwareOcclusionCuller();
+
+        // Stops the worker threads (restarted if needed).
+        void release();
+
+        // Starts a frame: forgets the occluders of the previous one.
+        void beginFrame( const glm::mat4& viewProjectionMatrix );
+
+        // Adds the given triangles (object space positions and 3 indices
+        // per triangle) as an occluder. Occluders covering less than
+        // MIN_OCCLUDER_AREA pixels of the buffer (their screen bounds) are
+        // ignored: they are costly for what they hide.
+        void addOccluder( const glm::mat4& modelMatrix,
+                          const glm::vec3* vertices,
+                          const uint16_t* indices,
+                          unsigned int triangleCount );
+
+        // Rasterizes the occluders added since beginFrame().
+        void rasterize();
+
+        // Whether any part of the box (object space) may be seen: in front
+        // of the occluders and inside the view.
+        bool visible( const glm::mat4& modelMatrix, const glm::vec3& boxMin, const glm::vec3& boxMax ) const;
+
+        // WIDTH x HEIGHT depths, bottom row first (debugging and tests).
+        const std::vector< float >& depthBuffer() const { return depth_; }
+
+    private:
+        SoftwareOcclusionCuller( const SoftwareOcclusionCuller& ) = delete;
+        SoftwareOcclusionCuller& operator=( const SoftwareOcclusionCuller& ) = delete;
+
+        static const int TILES_X = WIDTH / TILE_WIDTH;
+        static const int TILES_Y = HEIGHT / TILE_HEIGHT;
+        static const int N_TILES = TILES_X * TILES_Y;
+        static const int BLOCKS_X = WIDTH / BLOCK_SIZE;
+        static const int BLOCKS_Y = HEIGHT / BLOCK_SIZE;
+        static const int MIN_OCCLUDER_AREA = 64;
+
+        // Screen space triangle (pixels, window depth), ready to rasterize:
+        // a pixel center ( x, y ) is inside when a * x + b * y + c >= 0 for
+        // the 3 edges, where its depth is zA * x + zB * y + zC.
+        struct ScreenTriangle {
+            float edgeA[3];
+            float edgeB[3];
+            float edgeC[3];
+            float zA;
+            float zB;
+            float zC;
+            int minX, minY, maxX, maxY;     // Pixels (inclusive).
+        };
+
+        void startWorkers();
+        void workerLoop( unsigned int generation );
+        void rasterizeTiles();
+        void rasterizeTile( int tile );
+
+        glm::mat4 viewProjectionMatrix_;
+        std::vector< ScreenTriangle > triangles_;
+        std::vector< uint32_t > bins_[N_TILES];    // Triangles per tile.
+        std::vector< float > depth_;
+        std::vector< float > blockMaxDepth_;
+
+        // Worker pool.
+        int nWorkers_;
+        std::vector< std::thread > workers_;
+        std::mutex mutex_;
+        std::condition_variable startCondition_;
+        std::condition_variable doneCondition_;
+        unsigned int generation_;
+        unsigned int busyWorkers_;
+        bool quit_;
+        std::atomic< int > nextTile_;
+};
+
+#endif // SOFTWARE_OCCLUSION_HPP
@@ -0,0 +1,56 @@
+#ifndef STEREO_HPP
+#define STEREO_HPP
+
+#include <platform.hpp>
+
+// How both eyes of a side by side stereo frame are drawn.
+enum StereoMode {
+    kStereoModeTwoPasses = 0,   // One draw per eye and object (GLES2).
+    kStereoModeInstanced,       // One instanced draw per object, an instance per eye.
+    kStereoModeMultiview        // One OVR_multiview draw per object, a view per eye.
+};
+
+// Best mode supported by the current context.
+StereoMode SupportedStereoMode();
+
+// Viewport of both eyes, given the viewport of one of them (eye 0: left,
+// 1: right) in a side by side target.
+void StereoViewport( const GLint eyeViewport[4], int eye, GLint stereoViewport[4] );
+
+
+// Two layer color and depth target for OVR_multiview rendering. Both eyes
+// are drawn into it at once, then composited into the left and right halves
+// of the stereo viewport. Multiview can't render into Unity's framebuffer,
+// so planes drawn this way are only depth tested against each other.
+class MultiviewTarget {
+    public:
+        MultiviewTarget();
+
+        // Render thread, with a current context.
+        void release();
+
+        // Binds the target (resizing it if needed) with a width x height
+        // viewport and clears its color and depth (leaving depth writes
+        // enabled). Returns false if it can't be rendered to.
+        // The caller restores the previous framebuffer.
+        bool bind( GLsizei width, GLsizei height );
+
+        // Draws layer 0 in the left half and layer 1 in the right half of
+        // stereoViewport in the current framebuffer, blending them
+        // (premultiplied alpha) over its contents.
+        void composite( const GLint stereoViewport[4] );
+
+    private:
+        bool resize( GLsizei width, GLsizei height );
+
+        GLuint framebuffer_;
+        GLuint colorTexture_;
+        GLuint depthTexture_;
+        GLuint compositeProgram_;
+        GLint layerLocation_;
+        GLsizei width_;
+        GLsizei height_;
+        bool complete_;
+};
+
+#endif // STEREO_HPP
@@ -0,0 +1,74 @@
+#ifndef TERRAIN_MESH_HPP
+#define TERRAIN_MESH_HPP
+
+#include <platform.hpp>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include <lod_plane.hpp>
+#include <meshlets.hpp>
+#include <terrain_pager.hpp>
+
+#include <vector>
+
+// GPU side of a TerrainPager: a vertex buffer per pager slot, allocated once
+// so paging doesn't allocate GL memory either, and an index buffer shared
+// by every tile. Tiles are drawn at full resolution, with their vertex
+// colors shading their height.
+//
+// The shared index buffer is split into meshlets, and the bounds of the
+// meshlets of a tile are computed when it is uploaded, so only the
+// meshlets of the visible tiles which are inside the view and face the
+// camera are drawn (with a draw per run of consecutive ones).
+class TerrainMesh {
+    public:
+        // Tiles uploaded per update(), so paging in many tiles at once is
+        // spread over several frames.
+        static const unsigned int MAX_UPLOADS_PER_UPDATE = 4;
+
+        TerrainMesh();
+
+        // Render thread, with a current context. init() returns false (and
+        // the mesh stays uninitialized) when the buffers can't be created.
+        bool init( const TerrainPager& pager );
+        void release();
+        bool initialized() const { return indexBuffer_ != 0; }
+
+        // Uploads the tiles made resident by the last pager.update(), and
+        // forgets the evicted ones.
+        void update( const TerrainPager& pager );
+
+        // Draws the uploaded tiles inside the view frustum, seen from
+        // cameraPos (positions are in terrain space), with the current
+        // program.
+        void render( const glm::mat4& viewProjectionMatrix, const glm::vec3& cameraPos );
+
+        // Meshlets drawn / culled by the last render() (debugging and tests).
+        unsigned int drawnMeshlets() const { return drawnMeshlets_; }
+        unsigned int culledMeshlets() const { return culledMeshlets_; }
+
+    private:
+        TerrainMesh( const TerrainMesh& ) = delete;
+        TerrainMesh& operator=( const TerrainMesh& ) = delete;
+
+        struct TileBuffer {
+            GLuint vertexBuffer;
+            int tile;               // -1 when nothing is uploaded.
+            glm::vec3 boxMin;       // Terrain space bounds.
+            glm::vec3 boxMax;
+            std::vector< MeshletBounds > meshletBounds;
+        };
+
+        void uploadTile( const TerrainPager& pager, unsigned int slot );
+
+        std::vector< TileBuffer > tiles_;
+        std::vector< MyVertex > vertices_;  // Staging, one tile.
+        std::vector< glm::vec3 > positions_;
+        std::vector< uint16_t > indices_;   // Meshlet order, as in indexBuffer_.
+        std::vector< Meshlet > meshlets_;
+        GLuint indexBuffer_;
+        unsigned int drawnMeshlets_;
+        unsigned int culledMeshlets_;
+};
+
+#endif // TERRAIN_MESH_HPP
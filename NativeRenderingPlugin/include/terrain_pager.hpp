@@ -0,0 +1,192 @@
+#ifndef TERRAIN_PAGER_HPP
+#define TERRAIN_PAGER_HPP
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Header of a tiled heightmap file, followed by tilesX * tilesZ tiles (row
+// major, tile ( x, z ) at index z * tilesX + x). A tile is a square of
+// ( tileSize + 1 )^2 little endian uint16 samples, row major too, whose
+// last row and column repeat the first ones of the next tiles, so tiles are
+// decoded on their own and still meet without cracks.
+struct HeightmapHeader {
+    char magic[4];          // HEIGHTMAP_MAGIC.
+    uint32_t version;       // HEIGHTMAP_VERSION.
+    uint32_t tileSize;      // Quads per tile side, up to MAX_TILE_SIZE.
+    uint32_t tilesX;        // Up to 0xFFFF, and tilesX * tilesZ up to INT_MAX.
+    uint32_t tilesZ;
+    float sampleSpacing;    // World units between samples, along x and z.
+    float heightScale;      // World height of the sample 65535.
+    uint32_t reserved;
+};
+
+const char HEIGHTMAP_MAGIC[4] = { 'H', 'M', 'A', 'P' };
+const uint32_t HEIGHTMAP_VERSION = 1;
+
+// Tiles up to this size have less than 65536 vertices.
+const uint32_t MAX_TILE_SIZE = 255;
+
+
+// Read only memory mapping of a whole file. The mapping only takes address
+// space: pages are read when touched, and dropped by the OS when memory is
+// needed (or when told they won't be used).
+class MappedFile {
+    public:
+        MappedFile();
+        ~MappedFile();
+
+        bool open( const char* path );
+        void close();
+
+        const unsigned char* data() const { return data_; }
+        size_t size() const { return size_; }
+
+        // Hints that a range will be read soon / won't be read for a while.
+        void willNeed( size_t offset, size_t size ) const;
+        void dontNeed( size_t offset, size_t size ) const;
+
+    private:
+        MappedFile( const MappedFile& ) = delete;
+        MappedFile& operator=( const MappedFile& ) = delete;
+
+        const unsigned char* data_;
+        size_t size_;
+#if defined( _WIN32 )
+        void* file_;
+        void* mapping_;
+#endif
+};
+
+
+// Out-of-core paging of the tiles of a heightmap file (see HeightmapHeader)
+// around a moving camera, independent of GL (it can be used and tested
+// without a context).
+//
+// The file is memory mapped, and a fixed number of tile slots is allocated
+// when it is opened, so memory use doesn't depend on the terrain size nor
+// grow as the camera moves: terrains are only bounded by the disk (and the
+// address space on 32 bit platforms). Every update() wants the tiles within
+// the view radius of the camera, and of where its velocity (estimated from
+// its previous positions) will take it in PREFETCH_TIME seconds, nearest
+// first. Wanted tiles which aren't resident take the free slots, or the
+// ones of the least recently wanted tiles, and are decoded (which is where
+// the file is actually read) by worker threads.
+//
+// Terrain space: tile ( x, z ) covers [x, x + 1] * tileWorldSize() along x
+// and [z, z + 1] * tileWorldSize() along z, heights are along y.
+class TerrainPager {
+    public:
+        // Seconds of camera movement ahead of which tiles are paged in.
+        static const float PREFETCH_TIME;
+
+        // Largest view radius open() accepts: resident memory grows with
+        // its square (2 * ( 2 * radius + 1 )^2 tiles).
+        static const unsigned int MAX_VIEW_RADIUS = 8;
+
+        // Worker threads. -1: one less than the hardware threads, from 1 up
+        // to 2 (decoding is mostly waiting for the disk).
+        explicit TerrainPager( int nWorkers = -1 );
+        ~TerrainPager();
+
+        // Maps the heightmap file at path and allocates the slots of the
+        // tiles within viewRadius tiles of the camera and of its predicted
+        // position (viewRadius is clamped to MAX_VIEW_RADIUS). Returns false
+        // (and the pager stays closed) when the file can't be mapped or
+        // isn't a valid heightmap.
+        bool open( const char* path, unsigned int viewRadius = 2 );
+        void close();
+        bool isOpen() const { return !slots_.empty(); }
+
+        const HeightmapHeader& header() const { return header_; }
+        float tileWorldSize() const { return header_.tileSize * header_.sampleSpacing; }
+        unsigned int samplesPerSide() const { return header_.tileSize + 1; }
+
+        // Render thread (or whichever calls it, always the same one). Wants
+        // the tiles around cameraPos (terrain space) at the given time.
+        void update( const glm::vec3& cameraPos, float time );
+
+        // Camera velocity (units per second) as of the last update().
+        const glm::vec3& velocity() const { return velocity_; }
+
+        // Tile slots. The tile of a slot (-1 if none) is the one resident
+        // in it as of the last update(): its heights (samplesPerSide()^2
+        // world heights, row major) don't change until a further update()
+        // gives the slot to another tile.
+        unsigned int slotCount() const { return static_cast< unsigned int >( slots_.size() ); }
+        int slotTile( unsigned int slot ) const { return residentTiles_[slot]; }
+        const float* slotHeights( unsigned int slot ) const { return slots_[slot].heights.data(); }
+
+        // Index of tile ( x, z ), or -1 if it is out of the terrain.
+        int tileIndex( int x, int z ) const;
+
+        // Waits until every tile wanted by the last update() is decoded
+        // (tests only). Takes effect on the next update().
+        void waitIdle();
+
+    private:
+        TerrainPager( const TerrainPager& ) = delete;
+        TerrainPager& operator=( const TerrainPager& ) = delete;
+
+        enum SlotState {
+            kSlotFree = 0,
+            kSlotQueued,        // Waiting for a worker.
+            kSlotDecoding,
+            kSlotResident
+        };
+
+        struct Slot {
+            int tile;
+            SlotState state;
+            unsigned int lastWanted;    // update() which last wanted the tile.
+            std::vector< float > heights;
+        };
+
+        static const int MAX_WORKERS = 2;
+
+        void wantTilesAround( const glm::vec3& position, std::vector< int >& tiles ) const;
+        int takeSlot( unsigned int update );
+        size_t tileOffset( int tile ) const;
+        size_t tileBytes() const;
+        void decodeTile( int tile, std::vector< float >& heights ) const;
+
+        void startWorkers();
+        void stopWorkers();
+        void workerLoop();
+
+        MappedFile file_;
+        HeightmapHeader header_;
+        unsigned int viewRadius_;
+
+        // Camera tracking (update() thread only).
+        unsigned int updateCount_;
+        bool cameraKnown_;
+        glm::vec3 lastCameraPos_;
+        float lastTime_;
+        glm::vec3 velocity_;
+        std::vector< int > wantedTiles_;
+        std::vector< int > residentTiles_;  // Per slot, as of the last update().
+
+        // Slot states, heights of non resident slots and the request queue
+        // are shared with the workers, under mutex_.
+        std::vector< Slot > slots_;
+        std::deque< unsigned int > requests_;
+        unsigned int decodingSlots_;
+
+        // Worker pool.
+        int nWorkers_;
+        std::vector< std::thread > workers_;
+        std::mutex mutex_;
+        std::condition_variable requestCondition_;
+        std::condition_variable idleCondition_;
+        bool quit_;
+};
+
+#endif // TERRAIN_PAGER_HPP
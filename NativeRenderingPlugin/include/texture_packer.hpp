@@ -0,0 +1,70 @@
+#ifndef TEXTURE_PACKER_HPP
+#define TEXTURE_PACKER_HPP
+
+#include <platform.hpp>
+#include <gl_extensions.hpp>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Where a texture was placed in a TexturePacker.
+struct PackedTexture {
+    glm::vec4 region;   // xy: uv scale, zw: uv offset (atlas).
+    float layer;        // Layer (texture array).
+    bool opaque;        // No translucent texel (alpha < 1).
+};
+
+// Packs several textures into a single GL texture, so objects using any of
+// them can be drawn without binding another texture in between: a
+// GL_TEXTURE_2D_ARRAY with a layer per texture when texture arrays are
+// available, a GL_TEXTURE_2D atlas with a cell per texture (and an uv remap)
+// otherwise.
+//
+// Textures are resized to cellSize x cellSize by drawing them into the
+// packed texture, so the GL size of the source isn't needed (it can't be
+// queried on GLES2). Atlas cells keep a border of replicated edge texels so
+// filtering and mipmaps don't bleed between neighbours.
+class TexturePacker {
+    public:
+        TexturePacker();
+
+        // Render thread, with a current context.
+        void init( unsigned int maxTextures, GLsizei cellSize );
+        void release();
+        bool initialized() const { return texture_ != 0; }
+        bool usesTextureArray() const { return target_ == GL_TEXTURE_2D_ARRAY; }
+
+        // Copies the given texture into a free slot. Returns the slot, or -1
+        // when the packer is full. Copies are read back once to classify
+        // their alpha (see PackedTexture::opaque).
+        int add( GLuint sourceTexture );
+
+        // Copies the given texture over an already used slot.
+        void replace( int slot, GLuint sourceTexture );
+
+        // Frees a slot, so add() can reuse it.
+        void remove( int slot );
+
+        const PackedTexture& packedTexture( int slot ) const;
+
+        // Binds the packed texture to texture unit 0.
+        void bind() const;
+
+    private:
+        void initCopyProgram();
+        void copy( GLuint sourceTexture, int slot );
+
+        GLenum target_;
+        GLuint texture_;
+        GLuint framebuffer_;
+        GLuint copyProgram_;
+        GLsizei cellSize_;
+        GLsizei atlasSize_;
+        unsigned int cellsPerRow_;
+        unsigned int maxTextures_;
+        std::vector< PackedTexture > packedTextures_;
+        std::vector< int > freeSlots_;
+};
+
+#endif // TEXTURE_PACKER_HPP
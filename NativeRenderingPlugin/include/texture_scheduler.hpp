@@ -0,0 +1,123 @@
+#ifndef TEXTURE_SCHEDULER_HPP
+#define TEXTURE_SCHEDULER_HPP
+
+#include <algorithm>
+#include <chrono>
+
+// Spreads the generation of a dynamic texture over several render events, in
+// slices of rows, so it never takes more than a CPU budget per frame.
+//
+// A new image is started at most targetRate times per second, and all its
+// slices are generated for the time it was started at, so the finished
+// image is coherent. Render events with the same time as the previous one
+// (ie. the second eye of a stereo frame) don't generate anything.
+class TextureUpdateScheduler {
+    public:
+        TextureUpdateScheduler() :
+            updateInterval_( 0.0f ),
+            frameBudget_( 2.0e-3f ),
+            rowCost_( 0.0f ),
+            height_( 0 ),
+            nextRow_( 0 ),
+            imageTime_( 0.0f ),
+            lastTime_( 0.0f ),
+            started_( false )
+        {}
+
+        // Images per second (0: as often as the budget allows).
+        void setTargetRate( float updatesPerSecond )
+        {
+            updateInterval_ = ( updatesPerSecond > 0.0f ) ? 1.0f / updatesPerSecond : 0.0f;
+        }
+
+        // Generation time allowed per frame, in seconds.
+        void setFrameBudget( float seconds )
+        {
+            frameBudget_ = seconds;
+        }
+
+        // Drops the image in progress, so the next update() starts a new one
+        // (ie. when the layout of the rows changes).
+        void restart()
+        {
+            started_ = false;
+        }
+
+        // Calls generate( firstRow, rowCount, imageTime ) for as many rows of
+        // a height rows image as fit in the frame budget (at least one slice,
+        // so the image always progresses). Returns true when the image has
+        // just been completed.
+        template < class Generate >
+        bool update( float time, int height, Generate generate )
+        {
+            if( started_ && time == lastTime_ && height == height_ ){
+                return false;
+            }
+            lastTime_ = time;
+
+            // Size changes restart the image.
+            if( !started_ || height != height_ ){
+                started_ = true;
+                height_ = height;
+                nextRow_ = height;
+                imageTime_ = time - updateInterval_;
+            }
+
+            if( nextRow_ >= height_ ){
+                // Idle until the next image is due (or time went backwards,
+                // ie. a new level).
+                if( time >= imageTime_ && time - imageTime_ < updateInterval_ ){
+                    return false;
+                }
+                imageTime_ = time;
+                nextRow_ = 0;
+            }
+
+            typedef std::chrono::steady_clock Clock;
+            const Clock::time_point frameStart = Clock::now();
+            float elapsed = 0.0f;
+
+            while( nextRow_ < height_ ){
+                int rowCount;
+                if( rowCost_ <= 0.0f ){
+                    // No estimate yet: measure a small slice.
+                    rowCount = PROBE_ROWS;
+                }else{
+                    rowCount = static_cast< int >( ( frameBudget_ - elapsed ) / rowCost_ );
+                    if( rowCount <= 0 ){
+                        if( elapsed > 0.0f ){
+                            break;
+                        }
+                        rowCount = 1;
+                    }
+                }
+                rowCount = std::min( rowCount, height_ - nextRow_ );
+
+                const Clock::time_point sliceStart = Clock::now();
+                generate( nextRow_, rowCount, imageTime_ );
+                const Clock::time_point sliceEnd = Clock::now();
+                nextRow_ += rowCount;
+
+                // Moving average of the cost of a row.
+                const float sliceCost = std::chrono::duration< float >( sliceEnd - sliceStart ).count() / rowCount;
+                rowCost_ = ( rowCost_ <= 0.0f ) ? sliceCost : 0.75f * rowCost_ + 0.25f * sliceCost;
+                elapsed = std::chrono::duration< float >( sliceEnd - frameStart ).count();
+            }
+
+            return nextRow_ >= height_;
+        }
+
+    private:
+        static const int PROBE_ROWS = 8;
+
+        float updateInterval_;
+        float frameBudget_;
+        float rowCost_;         // Seconds per row.
+        int height_;
+        int nextRow_;
+        float imageTime_;
+        float lastTime_;
+        bool started_;
+};
+
+#endif // TEXTURE_SCHEDULER_HPP
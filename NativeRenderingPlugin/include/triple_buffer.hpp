@@ -0,0 +1,54 @@
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <atomic>
+
+// Lock-free single producer / single consumer mailbox. The producer (Unity's
+// main thread) always owns the back slot and the consumer (the render thread)
+// always owns the front slot. Both swap their slot with the middle one through
+// a single atomic exchange, so neither of them ever waits for the other and
+// the consumer always sees a complete, consistent value.
+template < class T >
+class TripleBuffer {
+    public:
+        TripleBuffer() :
+            backIndex_( 0 ),
+            middle_( 1 ),
+            frontIndex_( 2 )
+        {}
+
+        // Producer side: slot which can be freely written before publish().
+        T& back() { return slots_[backIndex_]; }
+
+        // Producer side: make the back slot visible to the consumer and take
+        // ownership of the previous middle slot.
+        void publish()
+        {
+            backIndex_ = middle_.exchange( backIndex_ | DIRTY_BIT, std::memory_order_acq_rel ) & INDEX_MASK;
+        }
+
+        // Consumer side: take the latest published slot, if any. Returns false
+        // (and keeps the current front slot) when nothing new was published.
+        bool acquire()
+        {
+            if( !( middle_.load( std::memory_order_relaxed ) & DIRTY_BIT ) ){
+                return false;
+            }
+            frontIndex_ = middle_.exchange( frontIndex_, std::memory_order_acq_rel ) & INDEX_MASK;
+            return true;
+        }
+
+        // Consumer side: slot acquired by the last call to acquire().
+        const T& front() const { return slots_[frontIndex_]; }
+
+    private:
+        static const unsigned int INDEX_MASK = 0x3;
+        static const unsigned int DIRTY_BIT = 0x4;
+
+        T slots_[3];
+        unsigned int backIndex_;
+        std::atomic< unsigned int > middle_;
+        unsigned int frontIndex_;
+};
+
+#endif // TRIPLE_BUFFER_HPP
@@ -0,0 +1,79 @@
+#ifndef UNIFORM_BUFFERS_HPP
+#define UNIFORM_BUFFERS_HPP
+
+#include <platform.hpp>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Uniform block binding points shared by every shader variant.
+const GLuint FRAME_UNIFORMS_BINDING = 0;
+const GLuint OBJECT_UNIFORMS_BINDING = 1;
+const GLuint STEREO_UNIFORMS_BINDING = 2;
+
+// std140 layout of the FrameBlock uniform block.
+struct FrameUniforms {
+    glm::mat4 viewMatrix;
+    glm::mat4 projMatrix;
+    glm::mat4 viewProjMatrix;
+    glm::vec4 time;     // x: time in seconds, yzw: unused.
+};
+
+// std140 layout of the ObjectBlock uniform block (and values of the plain
+// uniforms of the same name when uniform buffers aren't available).
+struct ObjectUniforms {
+    glm::mat4 mvpMatrix;
+    glm::mat4 modelViewMatrix;
+    glm::vec4 textureRegion;    // xy: uv scale, zw: uv offset in a texture atlas.
+    glm::vec4 textureLayer;     // x: layer in a texture array, yzw: unused.
+    glm::mat4 modelMatrix;      // Stereo variants combine it with each eye's matrices.
+};
+
+// std140 layout of the StereoBlock uniform block (stereo variants only).
+struct StereoUniforms {
+    glm::mat4 eyeViewProjMatrix[2];     // Left, right.
+    glm::vec4 stereoParams;             // x: window x where the right eye starts (instanced stereo), yzw: unused.
+};
+
+// Uniforms of an object drawn with the given matrices.
+inline ObjectUniforms ComputeObjectUniforms( const glm::mat4& modelMatrix,
+                                             const glm::mat4& viewMatrix,
+                                             const glm::mat4& projectionMatrix )
+{
+    ObjectUniforms uniforms;
+    uniforms.modelViewMatrix = viewMatrix * modelMatrix;
+    uniforms.mvpMatrix = projectionMatrix * uniforms.modelViewMatrix;
+    uniforms.textureRegion = glm::vec4( 1.0f, 1.0f, 0.0f, 0.0f );
+    uniforms.textureLayer = glm::vec4( 0.0f );
+    uniforms.modelMatrix = modelMatrix;
+    return uniforms;
+}
+
+
+// Ring of uniform data in a single buffer object. Every upload() writes a
+// whole batch with one glBufferSubData after the previous batches, so the GPU
+// can still be reading them. When the ring is full, its storage is orphaned
+// and writing starts again from the beginning.
+class UniformRing {
+    public:
+        UniformRing();
+
+        // Render thread, with a current context. Every upload starts at a
+        // multiple of alignment (GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT).
+        void init( GLsizeiptr capacity, GLint alignment );
+        void release();
+
+        // Uploads size bytes and returns their offset in buffer().
+        GLintptr upload( const void* data, GLsizeiptr size );
+
+        GLuint buffer() const { return buffer_; }
+
+    private:
+        GLuint buffer_;
+        GLsizeiptr capacity_;
+        GLintptr cursor_;
+        GLint alignment_;
+};
+
+#endif // UNIFORM_BUFFERS_HPP
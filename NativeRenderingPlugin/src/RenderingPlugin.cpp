@@ -6,10 +6,31 @@
 #include <stdio.h>
 #include <vector>
 #include <array>
+#include <atomic>
+#include <cstring>
 #include <string>
 #include <fstream>
+#include <gpu_culler.hpp>
 #include <lod_plane.hpp>
+#include <occlusion_culler.hpp>
+#include <procedural_texture.hpp>
+#include <render_queue.hpp>
 #include <shaders.hpp>
+#include <software_occlusion.hpp>
+#include <terrain_mesh.hpp>
+#include <terrain_pager.hpp>
+#include <texture_packer.hpp>
+#include <texture_scheduler.hpp>
+#include <command_buffer.hpp>
+#include <compressed_texture.hpp>
+#include <distortion_mesh.hpp>
+#include <dynamic_texture.hpp>
+#include <frame_data.hpp>
+#include <frame_state.hpp>
+#include <gl_extensions.hpp>
+#include <gl_state.hpp>
+#include <stereo.hpp>
+#include <triple_buffer.hpp>
 
 // --------------------------------------------------------------------------
 // Helper utilities
@@ -40,49 +61,213 @@ extern "C" const char* getOpenGLErrorsLog()
 
 
 // --------------------------------------------------------------------------
-// SetTimeFromUnity, an example function we export which is called by one of the scripts.
+// Frame state shared with the render thread.
+// The Set*FromUnity functions below are called from Unity's main thread and
+// only write to stagingFrameState_. PublishFrameStateFromUnity() copies it
+// into the mailbox, from which UnityRenderEvent (render thread) takes the
+// latest complete frame without ever blocking the main thread.
+
+static FrameState stagingFrameState_;
+static TripleBuffer< FrameState > frameStates_;
+
+
+void EXPORT_API PublishFrameStateFromUnity()
+{
+    frameStates_.back() = stagingFrameState_;
+    frameStates_.publish();
+
+    // Hand the commands recorded during this frame too.
+    SubmitCommandsFromUnity();
+}
+
+
+// --------------------------------------------------------------------------
+// Command buffer.
+// Record*FromUnity functions append commands from Unity's main thread, which
+// are replayed in order by the render thread on the next render event.
+
+static CommandQueue commandQueue_;
+
+
+void EXPORT_API RecordMatricesFromUnity( float* viewMatrix, float* projectionMatrix )
+{
+    UpdateMatricesCommand command;
+    memcpy( command.viewMatrix, viewMatrix, sizeof( command.viewMatrix ) );
+    memcpy( command.projectionMatrix, projectionMatrix, sizeof( command.projectionMatrix ) );
+    commandQueue_.recording().record( command );
+}
+
+
+void EXPORT_API RecordDrawPlaneFromUnity( float* modelMatrix )
+{
+    DrawPlaneCommand command;
+    memcpy( command.modelMatrix, modelMatrix, sizeof( command.modelMatrix ) );
+    commandQueue_.recording().record( command );
+}
+
+
+void EXPORT_API RecordUpdateTextureFromUnity( void* texturePtr, int w, int h )
+{
+    UpdateDynamicTextureCommand command;
+    command.texturePointer = texturePtr;
+    command.width = w;
+    command.height = h;
+    command.format = kProceduralTextureRGBA32;
+    commandQueue_.recording().record( command );
+}
+
+
+void EXPORT_API SubmitCommandsFromUnity()
+{
+    commandQueue_.submit();
+}
+
+
+// --------------------------------------------------------------------------
+// Packed frame data.
+// Scripts write the whole frame (time, matrices and per-object data) in place
+// into frameData_ and commit it with a single call, so per-frame interop
+// doesn't need any managed allocation nor one call per value.
 
-static float g_Time;
+static FrameData frameData_ = { FRAME_DATA_VERSION, 0, 0.0f, 0, {}, {}, {} };
+
+
+FrameData* EXPORT_API GetFrameDataFromUnity()
+{
+    return &frameData_;
+}
+
+
+void EXPORT_API CommitFrameDataFromUnity()
+{
+    if( frameData_.version != FRAME_DATA_VERSION ){
+        LOG(ERROR) << "Frame data version mismatch (" << frameData_.version
+                   << " != " << FRAME_DATA_VERSION << ")" << std::endl;
+        frameData_.version = FRAME_DATA_VERSION;
+        return;
+    }
+
+    if( frameData_.objectCount > MAX_FRAME_OBJECTS ){
+        LOG(ERROR) << "Too many objects in frame data (" << frameData_.objectCount
+                   << "), only " << MAX_FRAME_OBJECTS << " will be rendered" << std::endl;
+        frameData_.objectCount = MAX_FRAME_OBJECTS;
+    }
+
+    stagingFrameState_.time = frameData_.time;
+    stagingFrameState_.frameId = frameData_.frameId;
+    stagingFrameState_.viewMatrix = glm::make_mat4( frameData_.viewMatrix );
+    stagingFrameState_.projectionMatrix = glm::make_mat4( frameData_.projectionMatrix );
+    stagingFrameState_.cameraPos = CameraPosition( stagingFrameState_.viewMatrix );
+
+    stagingFrameState_.objectCount = frameData_.objectCount;
+    for( unsigned int i = 0; i < frameData_.objectCount; i++ ){
+        stagingFrameState_.modelMatrices[i] = glm::make_mat4( frameData_.objects[i].modelMatrix );
+    }
+
+    PublishFrameStateFromUnity();
+}
+
+
+// --------------------------------------------------------------------------
+// SetTimeFromUnity, an example function we export which is called by one of the scripts.
 
 void EXPORT_API SetTimeFromUnity (float t)
 {
-    g_Time = t;
+    stagingFrameState_.time = t;
 }
 
-static glm::mat4 modelMatrix_;
-static glm::mat4 viewMatrix_;
-static glm::mat4 projectionMatrix_;
-static glm::vec4 cameraPos_;
+// Scripts give Time.frameCount, so the events of every eye / camera of a
+// frame share the per-frame work.
+void EXPORT_API SetFrameIdFromUnity( unsigned int frameId )
+{
+    stagingFrameState_.frameId = frameId;
+}
 
 void EXPORT_API SetMatricesFromUnity( float* modelMatrix,
                                         float* viewMatrix,
                                         float* projectionMatrix )
 {
-    modelMatrix_ = glm::make_mat4( modelMatrix );
-    viewMatrix_ = glm::make_mat4( viewMatrix );
-    projectionMatrix_ = glm::make_mat4( projectionMatrix );
-    cameraPos_ = glm::inverse( viewMatrix_ ) * glm::vec4( 0.0f, 0.0f, 0.0f, 1.0f );
+    stagingFrameState_.objectCount = 1;
+    stagingFrameState_.modelMatrices[0] = glm::make_mat4( modelMatrix );
+    stagingFrameState_.viewMatrix = glm::make_mat4( viewMatrix );
+    stagingFrameState_.projectionMatrix = glm::make_mat4( projectionMatrix );
+    stagingFrameState_.cameraPos = CameraPosition( stagingFrameState_.viewMatrix );
+}
+
+// Matrices of both eyes for kPluginEventRenderStereoFrame, which draws them
+// from the camera of currentEye (0: left, 1: right). Must be called before
+// the frame is committed / published.
+void EXPORT_API SetStereoMatricesFromUnity( float* leftViewMatrix,
+                                            float* leftProjectionMatrix,
+                                            float* rightViewMatrix,
+                                            float* rightProjectionMatrix,
+                                            int currentEye )
+{
+    stagingFrameState_.stereoEye = ( currentEye == 1 ) ? 1 : 0;
+    stagingFrameState_.eyeViewMatrices[0] = glm::make_mat4( leftViewMatrix );
+    stagingFrameState_.eyeProjectionMatrices[0] = glm::make_mat4( leftProjectionMatrix );
+    stagingFrameState_.eyeViewMatrices[1] = glm::make_mat4( rightViewMatrix );
+    stagingFrameState_.eyeProjectionMatrices[1] = glm::make_mat4( rightProjectionMatrix );
 }
 
 
 // --------------------------------------------------------------------------
 // SetTextureFromUnity, an example function we export which is called by one of the scripts.
 
-static void*	g_TexturePointer	= 0;
-static int		g_TexWidth			= 0;
-static int		g_TexHeight			= 0;
-
 void EXPORT_API SetTextureFromUnity(void* texturePtr, int w, int h)
 {
-    g_TexturePointer	= texturePtr;
-    g_TexWidth			= w;
-    g_TexHeight			= h;
+    SetTextureWithFormatFromUnity( texturePtr, w, h, kProceduralTextureRGBA32 );
+}
+
+
+// Same as SetTextureFromUnity, for textures Unity created with a smaller
+// format (ProceduralTextureFormat). Scripts pick the cheapest one supported
+// with SystemInfo.SupportsTextureFormat().
+void EXPORT_API SetTextureWithFormatFromUnity( void* texturePtr, int w, int h, int format )
+{
+    if( format < 0 || format >= N_PROCEDURAL_TEXTURE_FORMATS ){
+        LOG(ERROR) << "Unknown procedural texture format (" << format << ")" << std::endl;
+        format = kProceduralTextureRGBA32;
+    }
+    stagingFrameState_.texturePointer	= texturePtr;
+    stagingFrameState_.texWidth			= w;
+    stagingFrameState_.texHeight		= h;
+    stagingFrameState_.texFormat		= format;
 }
 
 
 void EXPORT_API SetPlaneTextureFromUnity( GLuint texturePtr, unsigned int lodLevel )
 {
-    lodPlane->setTextureID( texturePtr, lodLevel );
+    // The plane is used by the render thread, so it's updated from there.
+    SetPlaneTextureCommand command;
+    command.textureID = texturePtr;
+    command.lodLevel = lodLevel;
+    commandQueue_.recording().record( command );
+}
+
+
+void EXPORT_API LoadPlaneTextureFromUnity( const char* basePath, unsigned int lodLevel )
+{
+    LoadPlaneTextureCommand command;
+    strncpy( command.basePath, basePath ? basePath : "", sizeof( command.basePath ) - 1 );
+    command.basePath[sizeof( command.basePath ) - 1] = '\0';
+    command.lodLevel = lodLevel;
+    commandQueue_.recording().record( command );
+}
+
+
+void EXPORT_API SetProceduralTextureCompressionFromUnity( int enabled, float updateInterval )
+{
+    SetProceduralTextureCompressionCommand command;
+    command.enabled = enabled;
+    command.updateInterval = updateInterval;
+    commandQueue_.recording().record( command );
+}
+
+
+void EXPORT_API SetShaderCacheDirectoryFromUnity( const char* directory )
+{
+    SetShaderCacheDirectory( directory ? directory : "" );
 }
 
 
@@ -96,11 +281,13 @@ void LogOpenGLVersion()
 }
 
 // --------------------------------------------------------------------------
-// UnitySetGraphicsDevice
+// Graphics device initialization / shutdown.
+// Shared by the IUnityGraphics device event callback and the legacy
+// UnitySetGraphicsDevice entry point.
 
 static int g_DeviceType = -1;
 
-void EXPORT_API UnitySetGraphicsDevice (void* device, int deviceType, int eventType)
+static void InitGraphicsDevice( int deviceType )
 {
 	// Configure logger
 #if !__ANDROID__
@@ -111,7 +298,10 @@ void EXPORT_API UnitySetGraphicsDevice (void* device, int deviceType, int eventT
     el::Loggers::reconfigureLogger("default", defaultConf);
 #endif
 
-	if ((deviceType != kGfxRendererOpenGL) && (deviceType != kGfxRendererOpenGLES20Mobile)){
+	if( ( deviceType != kUnityGfxRendererOpenGL ) &&
+        ( deviceType != kUnityGfxRendererOpenGLES20 ) &&
+        ( deviceType != kUnityGfxRendererOpenGLES30 ) &&
+        ( deviceType != kUnityGfxRendererOpenGLCore ) ){
 		LOG(ERROR) << "NO OPENGL (" << deviceType << ")" << std::endl;
 	}
 
@@ -121,15 +311,16 @@ void EXPORT_API UnitySetGraphicsDevice (void* device, int deviceType, int eventT
 	}
 #endif
 
-	checkOpenGLStatus("UnitySetGraphicsDevice - 0");
+	checkOpenGLStatus("InitGraphicsDevice - 0");
     
     LogOpenGLVersion();
     
     DebugLog("OpenGLES 2.0 device\n");
     ::printf("OpenGLES 2.0 device\n");
-    checkOpenGLStatus( "UnitySetGraphicsDevice - 1" );
+    checkOpenGLStatus( "InitGraphicsDevice - 1" );
 
-    InitShaders();
+    // Shaders are built on first use (see UseShaderVariant()).
+    InitGLExtensions();
     
     g_DeviceType = deviceType;
 
@@ -137,17 +328,51 @@ void EXPORT_API UnitySetGraphicsDevice (void* device, int deviceType, int eventT
 }
 
 
+static void ReleasePlaneTextures();
+static void ReleaseProceduralTextures();
+static void ReleaseStereoResources();
+static void ReleaseOcclusionCulling();
+static void ReleaseGPUDrivenRendering();
+static void ReleaseTerrain();
+
+static void ShutdownGraphicsDevice()
+{
+    // Release our GL objects while the context is still current.
+    ReleaseShaders();
+    ReleasePlaneTextures();
+    ReleaseProceduralTextures();
+    ReleaseStereoResources();
+    ReleaseOcclusionCulling();
+    ReleaseGPUDrivenRendering();
+    ReleaseTerrain();
+
+    g_DeviceType = -1;
+
+    el::Loggers::flushAll();
+}
+
 
 // --------------------------------------------------------------------------
-// UnityRenderEvent
-// This will be called for GL.IssuePluginEvent script calls; eventID will
-// be the integer passed to IssuePluginEvent. In this example, we just ignore
-// that value.
+// Render events.
+// Each PluginEventID issued from the scripts maps to a distinct operation.
 
 static void SetDefaultGraphicsState ();
-static void DoRendering (const glm::mat4& worldMatrix,
-                         const glm::mat4& viewMatrix,
-                         const glm::mat4& projectionMatrix );
+static void RenderPlanes( const FrameState& frame );
+static bool RenderPlanesGPUDriven( const FrameState& frame );
+static bool RenderTerrain( const FrameState& frame );
+static void RenderStereoPlanes( const FrameState& frame );
+static void RenderPlane( unsigned int lodLevel, unsigned int objectIndex,
+                         unsigned int extraFeatures = 0, unsigned int instanceCount = 1 );
+static void UpdateProceduralTexture( float time, void* texturePointer, int width, int height, int format );
+static void UpdateFrameProceduralTexture( const FrameState& frame, void* texturePointer );
+static void SetProceduralTextureCompression( bool enabled, float updateInterval );
+static void SetProceduralTextureBackend( int backend );
+static void SetProceduralTextureSchedule( float updateRate, float frameBudget );
+static void SetDistortion( const DistortionParameters& parameters, void* sourceTexture );
+static void SetOcclusionCulling( int mode );
+static void SetGPUDrivenRendering( bool enabled );
+static void LoadTerrain( const char* path, unsigned int viewRadius );
+static void RenderDistortion();
 
 void EXPORT_API InitPlugin()
 {
@@ -155,85 +380,1256 @@ void EXPORT_API InitPlugin()
 }
 
 
-void EXPORT_API UnityRenderEvent (int eventID)
+// --------------------------------------------------------------------------
+// Plane textures.
+// Plane LOD textures are packed into a single texture array / atlas, so every
+// plane is drawn with the same texture bound whatever its LOD level.
+
+static const unsigned int MAX_PACKED_TEXTURES = 16;
+static const GLsizei PACKED_TEXTURE_SIZE = 256;
+
+static TexturePacker texturePacker_;
+
+
+// Compressed textures loaded by the plugin itself. They aren't packed (the
+// packer stores uncompressed RGBA), so they keep their smaller footprint.
+static GLuint compressedPlaneTextures_[3] = { 0, 0, 0 };
+
+
+// Frees the packer slot of a LOD level, so another texture can use it.
+static void ReleasePlaneTextureSlot( unsigned int lodLevel )
+{
+    const int slot = lodPlane->textureSlot( lodLevel );
+    if( slot >= 0 ){
+        texturePacker_.remove( slot );
+        lodPlane->setTextureSlot( -1, lodLevel );
+    }
+}
+
+
+// Deletes the compressed texture of a LOD level, if it has one.
+static void ReleaseCompressedPlaneTexture( unsigned int lodLevel )
+{
+    if( compressedPlaneTextures_[lodLevel] != 0 ){
+        glDeleteTextures( 1, &compressedPlaneTextures_[lodLevel] );
+        compressedPlaneTextures_[lodLevel] = 0;
+        glState.invalidate();
+    }
+}
+
+
+static void SetPlaneTexture( GLuint textureID, unsigned int lodLevel )
+{
+    if( lodLevel >= 3 ){
+        LOG(ERROR) << "SetPlaneTexture - invalid LOD level (" << lodLevel << ")" << std::endl;
+        return;
+    }
+
+    ReleaseCompressedPlaneTexture( lodLevel );
+    lodPlane->setTextureID( textureID, lodLevel );
+    lodPlane->setTextureOpaque( false, lodLevel );
+    if( textureID == 0 ){
+        ReleasePlaneTextureSlot( lodLevel );
+        return;
+    }
+
+    if( !texturePacker_.initialized() ){
+        texturePacker_.init( MAX_PACKED_TEXTURES, PACKED_TEXTURE_SIZE );
+    }
+
+    // When the packer is full, the level keeps using its own texture.
+    int slot = lodPlane->textureSlot( lodLevel );
+    if( slot >= 0 ){
+        texturePacker_.replace( slot, textureID );
+    }else{
+        slot = texturePacker_.add( textureID );
+        lodPlane->setTextureSlot( slot, lodLevel );
+    }
+
+    // Unpacked textures are never read back, so they stay translucent.
+    if( slot >= 0 ){
+        lodPlane->setTextureOpaque( texturePacker_.packedTexture( slot ).opaque, lodLevel );
+    }
+    LOG(INFO) << "SetPlaneTexture - LOD level " << lodLevel << ": "
+              << ( lodPlane->textureOpaque( lodLevel ) ? "opaque" : "translucent" ) << " texture" << std::endl;
+}
+
+
+static void LoadPlaneTexture( const char* basePath, unsigned int lodLevel )
+{
+    if( lodLevel >= 3 ){
+        LOG(ERROR) << "LoadPlaneTexture - invalid LOD level (" << lodLevel << ")" << std::endl;
+        return;
+    }
+
+    GLenum internalFormat = 0;
+    const GLuint texture = LoadCompressedTexture( basePath, &internalFormat );
+    if( texture == 0 ){
+        return;
+    }
+
+    ReleaseCompressedPlaneTexture( lodLevel );
+    ReleasePlaneTextureSlot( lodLevel );
+    compressedPlaneTextures_[lodLevel] = texture;
+    lodPlane->setTextureID( texture, lodLevel );
+    lodPlane->setTextureOpaque( IsOpaqueCompressedFormat( internalFormat ), lodLevel );
+}
+
+
+static void ReleasePlaneTextures()
+{
+    texturePacker_.release();
+    if( lodPlane ){
+        for( unsigned int lodLevel = 0; lodLevel < 3; lodLevel++ ){
+            lodPlane->setTextureSlot( -1, lodLevel );
+        }
+    }
+    for( GLuint& texture : compressedPlaneTextures_ ){
+        if( texture != 0 ){
+            glDeleteTextures( 1, &texture );
+            texture = 0;
+        }
+    }
+}
+
+
+// Object uniforms and LOD levels of the current batch of draws, reused
+// between events.
+static std::vector< ObjectUniforms > objectUniforms_;
+static std::vector< unsigned int > objectLODs_;
+
+
+// LOD level of a plane seen from cameraPos.
+static unsigned int SelectPlaneLOD( const glm::mat4& modelMatrix, const glm::vec4& cameraPos )
+{
+    // Compute the distance between the camera and the plane.
+    const float distance = glm::distance( cameraPos, modelMatrix * lodPlane->centroid() );
+    return lodPlane->selectLOD( distance );
+}
+
+
+// Computes the uniforms of a plane and adds them to the current batch.
+static void AddPlaneToBatch( const glm::mat4& modelMatrix,
+                             const glm::mat4& viewMatrix,
+                             const glm::mat4& projectionMatrix,
+                             unsigned int lodLevel )
+{
+    ObjectUniforms objectUniforms = ComputeObjectUniforms( modelMatrix, viewMatrix, projectionMatrix );
+    const int slot = lodPlane->textureSlot( lodLevel );
+    if( slot >= 0 ){
+        const PackedTexture& packedTexture = texturePacker_.packedTexture( slot );
+        objectUniforms.textureRegion = packedTexture.region;
+        objectUniforms.textureLayer.x = packedTexture.layer;
+    }
+
+    objectUniforms_.push_back( objectUniforms );
+    objectLODs_.push_back( lodLevel );
+}
+
+
+// Uploads the uniforms of the current batch (unless they are still the ones
+// of the last upload) and binds the textures shared by all its planes.
+static void PrepareBatch( bool uploadUniforms = true )
+{
+    if( objectUniforms_.empty() ){
+        return;
+    }
+    if( uploadUniforms ){
+        UploadObjectUniforms( objectUniforms_ );
+    }
+    if( texturePacker_.initialized() ){
+        texturePacker_.bind();
+    }
+}
+
+
+// --------------------------------------------------------------------------
+// Per-frame and per-view work.
+// With stereo (Cardboard) or multi-camera rendering, every eye / camera
+// publishes its own FrameState, with the same frameId and its own view, and
+// issues its own render event. Work which only depends on the frame (LOD
+// selection, the procedural texture) is done by the first event of a frame
+// and shared with the others, so both eyes also see the same LOD levels.
+// Work which depends on the view (object uniforms) is done once per view.
+
+static unsigned int batchFrameId_ = 0;
+static unsigned int batchObjectCount_ = 0;
+static bool batchViewValid_ = false;
+static glm::mat4 batchViewMatrix_;
+static glm::mat4 batchProjectionMatrix_;
+
+static unsigned int textureFrameId_ = 0;
+static void* textureFramePointer_ = nullptr;
+
+
+static void InvalidateFrameBatch()
+{
+    batchFrameId_ = 0;
+    batchViewValid_ = false;
+}
+
+
+// Whether the frame was already seen by a previous event (frameId 0 means
+// unknown, so it never was).
+static bool IsSameFrame( unsigned int frameId, unsigned int previousFrameId )
+{
+    return frameId != 0 && frameId == previousFrameId;
+}
+
+
+// Fills objectUniforms_ and objectLODs_ for the planes of a frame, reusing
+// the LOD levels of the frame's previous views and the uniforms of an
+// identical previous view. Returns false when the uniforms are the ones
+// already uploaded.
+static bool BuildFrameBatch( const FrameState& frame )
+{
+    const bool sameFrame = IsSameFrame( frame.frameId, batchFrameId_ ) &&
+                           frame.objectCount == batchObjectCount_ &&
+                           objectLODs_.size() == frame.objectCount;
+    const bool sameView = sameFrame && batchViewValid_ &&
+                          frame.viewMatrix == batchViewMatrix_ &&
+                          frame.projectionMatrix == batchProjectionMatrix_;
+    if( sameView ){
+        return false;
+    }
+
+    if( !sameFrame ){
+        objectLODs_.clear();
+        for( unsigned int i = 0; i < frame.objectCount; i++ ){
+            objectLODs_.push_back( SelectPlaneLOD( frame.modelMatrices[i], frame.cameraPos ) );
+        }
+    }
+
+    objectUniforms_.clear();
+    for( unsigned int i = 0; i < frame.objectCount; i++ ){
+        AddPlaneToBatch( frame.modelMatrices[i], frame.viewMatrix, frame.projectionMatrix, objectLODs_[i] );
+    }
+
+    batchFrameId_ = frame.frameId;
+    batchObjectCount_ = frame.objectCount;
+    batchViewMatrix_ = frame.viewMatrix;
+    batchProjectionMatrix_ = frame.projectionMatrix;
+    batchViewValid_ = true;
+    return true;
+}
+
+
+// --------------------------------------------------------------------------
+// Occlusion culling.
+// Planes hidden behind other geometry are skipped, in one of two ways (see
+// OcclusionCullingMode), and only in mono views: stereo frames draw every
+// plane.
+// - Queries test the planes against the depth Unity left, so they are
+//   issued before our own draws, and only for the first view of every
+//   frame: further views of the frame draw every plane.
+// - The software culler tests the planes against the opaque ones, with the
+//   matrices of the view, before their LOD levels are selected.
+
+static OcclusionCullingMode occlusionCullingMode_ = kOcclusionCullingOff;
+static OcclusionCuller occlusionCuller_;
+static unsigned int occlusionFrameId_ = 0;
+static SoftwareOcclusionCuller softwareCuller_;
+static std::vector< bool > planeOccluded_;  // Software culled view, per plane.
+
+
+void EXPORT_API SetOcclusionCullingFromUnity( int mode )
+{
+    SetOcclusionCullingCommand command;
+    command.mode = mode;
+    commandQueue_.recording().record( command );
+}
+
+
+static void SetOcclusionCulling( int mode )
+{
+    if( mode != kOcclusionCullingOff && mode != kOcclusionCullingQueries && mode != kOcclusionCullingSoftware ){
+        LOG(ERROR) << "Unknown occlusion culling mode (" << mode << ")" << std::endl;
+        return;
+    }
+    if( mode == kOcclusionCullingQueries && !glext.occlusionQueries ){
+        LOG(ERROR) << "SetOcclusionCulling - occlusion queries not supported" << std::endl;
+    }
+    if( mode != kOcclusionCullingQueries ){
+        occlusionCuller_.release();
+    }
+    if( mode != kOcclusionCullingSoftware ){
+        softwareCuller_.release();
+    }
+    occlusionCullingMode_ = static_cast< OcclusionCullingMode >( mode );
+}
+
+
+static void ReleaseOcclusionCulling()
+{
+    occlusionCuller_.release();
+    occlusionFrameId_ = 0;
+    softwareCuller_.release();
+}
+
+
+// Collects the visibility of the planes of a mono view and issues the
+// queries of this frame. Returns whether the view is occlusion culled.
+static bool CullFramePlanes( const FrameState& frame )
+{
+    if( occlusionCullingMode_ != kOcclusionCullingQueries || !glext.occlusionQueries ||
+        IsSameFrame( frame.frameId, occlusionFrameId_ ) ){
+        return false;
+    }
+    occlusionFrameId_ = frame.frameId;
+
+    glm::vec3 boxMin;
+    glm::vec3 boxMax;
+    lodPlane->bounds( boxMin, boxMax );
+    occlusionCuller_.beginFrame( frame.objectCount );
+    occlusionCuller_.issueQueries( frame.modelMatrices, frame.projectionMatrix * frame.viewMatrix, boxMin, boxMax );
+
+    // Queries leave their own state.
+    SetDefaultGraphicsState();
+    return true;
+}
+
+
+// Fills planeOccluded_ for a mono view, rasterizing the planes which are
+// opaque at every LOD level as occluders. Returns whether the view is
+// occlusion culled.
+static bool SoftwareCullFramePlanes( const FrameState& frame )
+{
+    if( occlusionCullingMode_ != kOcclusionCullingSoftware ){
+        return false;
+    }
+
+    softwareCuller_.beginFrame( frame.projectionMatrix * frame.viewMatrix );
+    if( lodPlane->textureOpaque( 0 ) && lodPlane->textureOpaque( 1 ) && lodPlane->textureOpaque( 2 ) ){
+        std::vector< glm::vec3 > vertices;
+        std::vector< uint16_t > indices;
+        lodPlane->occluderMesh( vertices, indices );
+        for( unsigned int i = 0; i < frame.objectCount; i++ ){
+            softwareCuller_.addOccluder( frame.modelMatrices[i], vertices.data(), indices.data(), indices.size() / 3 );
+        }
+    }
+    softwareCuller_.rasterize();
+
+    // Occluders only hide what is strictly behind them, so they stay.
+    glm::vec3 boxMin;
+    glm::vec3 boxMax;
+    lodPlane->bounds( boxMin, boxMax );
+    planeOccluded_.assign( frame.objectCount, false );
+    for( unsigned int i = 0; i < frame.objectCount; i++ ){
+        planeOccluded_[i] = !softwareCuller_.visible( frame.modelMatrices[i], boxMin, boxMax );
+    }
+    return true;
+}
+
+
+// Draw order of the planes of the current batch.
+static RenderQueue renderQueue_;
+
+
+// Sorts the planes of a frame (already in the batch) by their sort key, as
+// seen with viewProjectionMatrix. Occluded planes are left out when the
+// view is occlusion culled.
+static void SortFramePlanes( const FrameState& frame, const glm::mat4& viewProjectionMatrix, bool occlusionCulled = false )
+{
+    const bool softwareCulled = occlusionCulled && occlusionCullingMode_ == kOcclusionCullingSoftware;
+    renderQueue_.clear();
+    for( unsigned int i = 0; i < frame.objectCount; i++ ){
+        if( softwareCulled ? planeOccluded_[i] : ( occlusionCulled && !occlusionCuller_.visible( i ) ) ){
+            continue;
+        }
+        const unsigned int lodLevel = objectLODs_[i];
+
+        // Window depth of the plane center.
+        const glm::vec4 center = viewProjectionMatrix * ( frame.modelMatrices[i] * lodPlane->centroid() );
+        const float depth = ( center.w > 0.0f ) ? 0.5f * center.z / center.w + 0.5f : 0.0f;
+
+        // Packed textures are all the same one.
+        const unsigned int texture = ( lodPlane->textureSlot( lodLevel ) >= 0 ) ? 0 : lodPlane->textureID( lodLevel );
+
+        const bool transparent = !lodPlane->textureOpaque( lodLevel );
+        renderQueue_.push( MakeSortKey( 0, transparent, depth, lodPlane->shaderFeatures( lodLevel ), texture, lodLevel ), i );
+    }
+    renderQueue_.sort();
+}
+
+
+// Replays a command buffer, in order. Matrices default to the frame ones
+// until a kCommandUpdateMatrices is found. Draws are batched until a command
+// which may change how they look (or the end of the buffer), so a run of
+// draws takes a single uniform buffer write.
+static void ExecuteCommandBuffer( const CommandBuffer& buffer, const FrameState& frame )
+{
+    glm::mat4 viewMatrix = frame.viewMatrix;
+    glm::mat4 projectionMatrix = frame.projectionMatrix;
+    glm::vec4 cameraPos = frame.cameraPos;
+
+    auto flushDraws = [&](){
+        if( objectUniforms_.empty() ){
+            return;
+        }
+        SendFrameUniforms( viewMatrix, projectionMatrix, frame.time );
+        PrepareBatch();
+        SetDefaultGraphicsState();
+        for( unsigned int i = 0; i < objectUniforms_.size(); i++ ){
+            RenderPlane( objectLODs_[i], i );
+        }
+        objectUniforms_.clear();
+        objectLODs_.clear();
+    };
+
+    bool batchUsed = false;
+    for( const CommandHeader* command = buffer.first(); command; command = buffer.next( command ) ){
+        if( command->type == kCommandDrawPlane ){
+            if( !batchUsed ){
+                // The batch isn't the one of the frame anymore.
+                InvalidateFrameBatch();
+                objectUniforms_.clear();
+                objectLODs_.clear();
+                batchUsed = true;
+            }
+            const DrawPlaneCommand& drawPlane = CommandBuffer::payload< DrawPlaneCommand >( command );
+            const glm::mat4 modelMatrix = glm::make_mat4( drawPlane.modelMatrix );
+            AddPlaneToBatch( modelMatrix, viewMatrix, projectionMatrix, SelectPlaneLOD( modelMatrix, cameraPos ) );
+            continue;
+        }
+        flushDraws();
+
+        switch( command->type ){
+            case kCommandSetPlaneTexture:{
+                const SetPlaneTextureCommand& setTexture = CommandBuffer::payload< SetPlaneTextureCommand >( command );
+                SetPlaneTexture( setTexture.textureID, setTexture.lodLevel );
+            }break;
+            case kCommandLoadPlaneTexture:{
+                const LoadPlaneTextureCommand& loadTexture = CommandBuffer::payload< LoadPlaneTextureCommand >( command );
+                LoadPlaneTexture( loadTexture.basePath, loadTexture.lodLevel );
+            }break;
+            case kCommandSetProceduralTextureBackend:{
+                const SetProceduralTextureBackendCommand& setBackend = CommandBuffer::payload< SetProceduralTextureBackendCommand >( command );
+                SetProceduralTextureBackend( setBackend.backend );
+            }break;
+            case kCommandSetProceduralTextureSchedule:{
+                const SetProceduralTextureScheduleCommand& setSchedule = CommandBuffer::payload< SetProceduralTextureScheduleCommand >( command );
+                SetProceduralTextureSchedule( setSchedule.updateRate, setSchedule.frameBudget );
+            }break;
+            case kCommandSetDistortion:{
+                const SetDistortionCommand& setDistortion = CommandBuffer::payload< SetDistortionCommand >( command );
+                SetDistortion( setDistortion.parameters, setDistortion.sourceTexture );
+            }break;
+            case kCommandSetOcclusionCulling:{
+                const SetOcclusionCullingCommand& setCulling = CommandBuffer::payload< SetOcclusionCullingCommand >( command );
+                SetOcclusionCulling( setCulling.mode );
+            }break;
+            case kCommandSetGPUDrivenRendering:{
+                const SetGPUDrivenRenderingCommand& setGPUDriven = CommandBuffer::payload< SetGPUDrivenRenderingCommand >( command );
+                SetGPUDrivenRendering( setGPUDriven.enabled != 0 );
+            }break;
+            case kCommandLoadTerrain:{
+                const LoadTerrainCommand& loadTerrain = CommandBuffer::payload< LoadTerrainCommand >( command );
+                LoadTerrain( loadTerrain.path, loadTerrain.viewRadius );
+            }break;
+            case kCommandSetProceduralTextureCompression:{
+                const SetProceduralTextureCompressionCommand& setCompression = CommandBuffer::payload< SetProceduralTextureCompressionCommand >( command );
+                SetProceduralTextureCompression( setCompression.enabled != 0, setCompression.updateInterval );
+            }break;
+            case kCommandUpdateMatrices:{
+                const UpdateMatricesCommand& updateMatrices = CommandBuffer::payload< UpdateMatricesCommand >( command );
+                viewMatrix = glm::make_mat4( updateMatrices.viewMatrix );
+                projectionMatrix = glm::make_mat4( updateMatrices.projectionMatrix );
+                cameraPos = CameraPosition( viewMatrix );
+            }break;
+            case kCommandUpdateDynamicTexture:{
+                const UpdateDynamicTextureCommand& updateTexture = CommandBuffer::payload< UpdateDynamicTextureCommand >( command );
+                UpdateProceduralTexture( frame.time, updateTexture.texturePointer, updateTexture.width, updateTexture.height, updateTexture.format );
+            }break;
+        }
+    }
+    flushDraws();
+}
+
+
+// Totals of glState, published after every event.
+static std::atomic< unsigned int > glStateIssuedCalls_( 0 );
+static std::atomic< unsigned int > glStateAvoidedCalls_( 0 );
+
+
+// GL state calls made and avoided (redundant) by the plugin since it was
+// loaded.
+void EXPORT_API GetGLStateCountersFromUnity( unsigned int* issuedCalls, unsigned int* avoidedCalls )
+{
+    *issuedCalls = glStateIssuedCalls_.load();
+    *avoidedCalls = glStateAvoidedCalls_.load();
+}
+
+
+static void HandleRenderEvent( int eventID, void* data )
 {
 	// Unknown graphics device type? Do nothing.
 	if (g_DeviceType == -1)
 		return;
 
-	// Actual functions defined below
-	SetDefaultGraphicsState ();
-	DoRendering( modelMatrix_, viewMatrix_, projectionMatrix_ );
+	// Unity may have changed any state since our last event.
+	glState.invalidate();
+
+	// Take the latest frame published by the main thread. If nothing new was
+	// published since the last event (ie. stereo rendering), we keep drawing
+	// the previous one.
+	frameStates_.acquire();
+	const FrameState& frame = frameStates_.front();
+
+	// Replay every command recorded since the last event, whatever the event.
+	auto executor = [&frame]( const CommandBuffer& buffer ){
+		ExecuteCommandBuffer( buffer, frame );
+	};
+	commandQueue_.execute( executor );
+
+	switch( eventID ){
+		case kPluginEventRenderFrame:
+			SetDefaultGraphicsState ();
+			RenderPlanes( frame );
+			UpdateFrameProceduralTexture( frame, frame.texturePointer );
+		break;
+		case kPluginEventRenderPlanes:
+			SetDefaultGraphicsState ();
+			RenderPlanes( frame );
+		break;
+		case kPluginEventUpdateTexture:
+			// Scripts may give the texture to update as the event data.
+			UpdateFrameProceduralTexture( frame, data ? data : frame.texturePointer );
+		break;
+		case kPluginEventExecuteCommands:
+			// Already done above.
+		break;
+		case kPluginEventRenderStereoFrame:
+			RenderStereoPlanes( frame );
+			UpdateFrameProceduralTexture( frame, frame.texturePointer );
+		break;
+		case kPluginEventRenderDistortion:
+			RenderDistortion();
+		break;
+		default:
+			LOG(ERROR) << "Unknown plugin event (" << eventID << ")" << std::endl;
+		break;
+	}
+
+	glStateIssuedCalls_.store( glState.issuedCalls() );
+	glStateAvoidedCalls_.store( glState.avoidedCalls() );
 }
 
 
-static void SetDefaultGraphicsState ()
+// --------------------------------------------------------------------------
+// IUnityGraphics entry points (Unity >= 5.2).
+// Unity calls the device event callback and the render event functions on
+// its render thread, which makes the plugin work with the multithreaded
+// renderer.
+
+static IUnityInterfaces* s_UnityInterfaces = nullptr;
+static IUnityGraphics* s_Graphics = nullptr;
+
+static void UNITY_INTERFACE_API OnGraphicsDeviceEvent( UnityGfxDeviceEventType eventType )
 {
-	glEnable(GL_BLEND);
-    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-    glDisable(GL_CULL_FACE);
-    glDepthFunc(GL_LEQUAL);
-    glEnable(GL_DEPTH_TEST);
-    glDepthMask(GL_FALSE);
+    switch( eventType ){
+        case kUnityGfxDeviceEventInitialize:
+        case kUnityGfxDeviceEventAfterReset:
+            InitGraphicsDevice( s_Graphics->GetRenderer() );
+        break;
+        case kUnityGfxDeviceEventShutdown:
+        case kUnityGfxDeviceEventBeforeReset:
+            ShutdownGraphicsDevice();
+        break;
+    }
 }
 
 
-static void FillTextureFromCode (int width, int height, int stride, unsigned char* dst)
+static void UNITY_INTERFACE_API OnRenderEvent( int eventID )
 {
-	const float t = g_Time * 4.0f;
+    HandleRenderEvent( eventID, nullptr );
+}
 
-	for (int y = 0; y < height; ++y)
-	{
-		unsigned char* ptr = dst;
-		for (int x = 0; x < width; ++x)
-		{
-			// Simple oldskool "plasma effect", a bunch of combined sine waves
-			int vv = int(
-				(127.0f + (127.0f * sinf(x/7.0f+t))) +
-				(127.0f + (127.0f * sinf(y/5.0f-t))) +
-				(127.0f + (127.0f * sinf((x+y)/6.0f-t))) +
-				(127.0f + (127.0f * sinf(sqrtf(float(x*x + y*y))/4.0f-t)))
-				) / 4;
 
-			// Write the texture pixel
-			ptr[0] = vv;
-			ptr[1] = vv;
-			ptr[2] = vv;
-			ptr[3] = vv;
+static void UNITY_INTERFACE_API OnRenderEventAndData( int eventID, void* data )
+{
+    HandleRenderEvent( eventID, data );
+}
 
-			// To next pixel (our pixels are 4 bpp)
-			ptr += 4;
-		}
 
-		// To next image row
-		dst += stride;
-	}
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API UnityPluginLoad( IUnityInterfaces* unityInterfaces )
+{
+    s_UnityInterfaces = unityInterfaces;
+    s_Graphics = s_UnityInterfaces->Get<IUnityGraphics>();
+    if( !s_Graphics ){
+        return;
+    }
+    s_Graphics->RegisterDeviceEventCallback( OnGraphicsDeviceEvent );
+
+    // The graphics device may already exist when the plugin is loaded, in
+    // which case the initialize event won't come.
+    OnGraphicsDeviceEvent( kUnityGfxDeviceEventInitialize );
 }
 
-static void DoRendering ( const glm::mat4& modelMatrix,
-                         const glm::mat4& viewMatrix,
-                         const glm::mat4& projectionMatrix )
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API UnityPluginUnload()
 {
-    if( UsePluginShader() ){
-        // Send modelview matrix to shader.
-        SendMatricesToShader( modelMatrix, viewMatrix, projectionMatrix );
-    
-        // Compute the distance between the camera and the plane.
-        const float distance = glm::distance( cameraPos_, lodPlane->centroid() );
-    
+    if( s_Graphics ){
+        s_Graphics->UnregisterDeviceEventCallback( OnGraphicsDeviceEvent );
+    }
+    s_Graphics = nullptr;
+    s_UnityInterfaces = nullptr;
+}
+
+
+UnityRenderingEvent EXPORT_API GetRenderEventFunc()
+{
+    return OnRenderEvent;
+}
+
+
+UnityRenderingEventAndData EXPORT_API GetRenderEventAndDataFunc()
+{
+    return OnRenderEventAndData;
+}
+
+
+// --------------------------------------------------------------------------
+// Legacy entry points (Unity < 5.2).
+// Ignored once UnityPluginLoad has been called, so the device is never
+// initialized twice.
+
+void EXPORT_API UnitySetGraphicsDevice (void* device, int deviceType, int eventType)
+{
+    if( s_Graphics ){
+        return;
+    }
+
+    switch( eventType ){
+        case kGfxDeviceEventInitialize:
+        case kGfxDeviceEventAfterReset:
+            InitGraphicsDevice( deviceType );
+        break;
+        case kGfxDeviceEventShutdown:
+        case kGfxDeviceEventBeforeReset:
+            ShutdownGraphicsDevice();
+        break;
+    }
+}
+
+
+void EXPORT_API UnityRenderEvent (int eventID)
+{
+    HandleRenderEvent( eventID, nullptr );
+}
+
+
+static void SetDefaultGraphicsState ()
+{
+	glState.setEnabled(GL_BLEND, true);
+    glState.blendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glState.setEnabled(GL_CULL_FACE, false);
+    glState.depthFunc(GL_LEQUAL);
+    glState.setEnabled(GL_DEPTH_TEST, true);
+    glState.depthMask(GL_FALSE);
+}
+
+
+// Planes without translucent texels: no blending, and depth writes so the
+// planes behind them are rejected before shading.
+static void SetOpaqueGraphicsState()
+{
+    glState.setEnabled( GL_BLEND, false );
+    glState.setEnabled( GL_CULL_FACE, false );
+    glState.depthFunc( GL_LEQUAL );
+    glState.setEnabled( GL_DEPTH_TEST, true );
+    glState.depthMask( GL_TRUE );
+}
+
+
+static void RenderPlane( unsigned int lodLevel, unsigned int objectIndex,
+                         unsigned int extraFeatures, unsigned int instanceCount )
+{
+    // Use the cheapest shader variant for this LOD level.
+    if( UseShaderVariant( lodPlane->shaderFeatures( lodLevel ) | extraFeatures ) ){
+        // Send the matrices (already uploaded) of this object to the shader.
+        SendObjectUniforms( objectIndex );
+
         // Render the plane
-        lodPlane->render( distance );
+        lodPlane->render( lodLevel, instanceCount );
+    }
+}
+
+
+// Renders the planes of renderQueue_: the opaque pass first (front to
+// back), then the transparent one (back to front) with the default state.
+static void RenderQueuedPlanes( unsigned int extraFeatures = 0, unsigned int instanceCount = 1 )
+{
+    bool opaquePass = false;
+    for( const RenderQueueEntry& draw : renderQueue_.entries() ){
+        const unsigned int lodLevel = objectLODs_[draw.index];
+        const bool opaque = lodPlane->textureOpaque( lodLevel );
+        if( opaque != opaquePass ){
+            if( opaque ){
+                SetOpaqueGraphicsState();
+            }else{
+                SetDefaultGraphicsState();
+            }
+            opaquePass = opaque;
+        }
+        RenderPlane( lodLevel, draw.index, extraFeatures, instanceCount );
+    }
+    if( opaquePass ){
+        SetDefaultGraphicsState();
+    }
+}
+
+
+static void RenderPlanes( const FrameState& frame )
+{
+    const bool terrainUploaded = RenderTerrain( frame );
+    if( frame.objectCount == 0 ){
+        return;
+    }
+    if( RenderPlanesGPUDriven( frame ) ){
+        return;
+    }
+
+    // Cull on the CPU before selecting the LOD levels.
+    const bool softwareCulled = SoftwareCullFramePlanes( frame );
+
+    // Upload the matrices of every object at once (again if the terrain's
+    // upload replaced them).
+    const bool uploadUniforms = BuildFrameBatch( frame ) || terrainUploaded;
+    SendFrameUniforms( frame.viewMatrix, frame.projectionMatrix, frame.time );
+    PrepareBatch( uploadUniforms );
+
+    // Render a plane per visible object.
+    const bool occlusionCulled = softwareCulled || CullFramePlanes( frame );
+    SortFramePlanes( frame, frame.projectionMatrix * frame.viewMatrix, occlusionCulled );
+    RenderQueuedPlanes();
+}
+
+
+// --------------------------------------------------------------------------
+// GPU driven rendering.
+// Mono views can have their planes culled and their LOD levels selected by
+// a compute shader, each level being drawn with a single indirect draw (see
+// GPUCuller), instead of all the per plane work of RenderPlanes. Planes
+// aren't occlusion culled nor sorted then: opaque levels are drawn before
+// translucent ones, in no particular order.
+
+static bool gpuDrivenRendering_ = false;
+static GPUCuller gpuCuller_;
+
+
+void EXPORT_API SetGPUDrivenRenderingFromUnity( int enabled )
+{
+    SetGPUDrivenRenderingCommand command;
+    command.enabled = enabled;
+    commandQueue_.recording().record( command );
+}
+
+
+static void SetGPUDrivenRendering( bool enabled )
+{
+    if( enabled && !glext.computeShaders ){
+        LOG(ERROR) << "SetGPUDrivenRendering - compute shaders not supported" << std::endl;
+        enabled = false;
+    }
+    if( !enabled ){
+        gpuCuller_.release();
+    }
+    gpuDrivenRendering_ = enabled;
+}
+
+
+static void ReleaseGPUDrivenRendering()
+{
+    gpuCuller_.release();
+}
+
+
+// Returns false (and the view must be rendered as usual) when the GPU
+// driven path is disabled or isn't available.
+static bool RenderPlanesGPUDriven( const FrameState& frame )
+{
+    if( !gpuDrivenRendering_ ){
+        return false;
+    }
+    if( !gpuCuller_.initialized() && !gpuCuller_.init( *lodPlane ) ){
+        LOG(ERROR) << "RenderPlanesGPUDriven - GPU culler not available, GPU driven rendering disabled" << std::endl;
+        gpuDrivenRendering_ = false;
+        return false;
+    }
+    gpuCuller_.cull( frame.modelMatrices, frame.objectCount, frame.projectionMatrix * frame.viewMatrix, frame.cameraPos );
+
+    // A batch entry per level, as instances carry their own model matrix.
+    InvalidateFrameBatch();
+    objectUniforms_.clear();
+    objectLODs_.clear();
+    for( unsigned int lodLevel = 0; lodLevel < 3; lodLevel++ ){
+        AddPlaneToBatch( glm::mat4( 1.0f ), frame.viewMatrix, frame.projectionMatrix, lodLevel );
+    }
+    SendFrameUniforms( frame.viewMatrix, frame.projectionMatrix, frame.time );
+    PrepareBatch();
+
+    const bool passes[] = { true, false };
+    for( bool opaquePass : passes ){
+        if( opaquePass ){
+            SetOpaqueGraphicsState();
+        }else{
+            SetDefaultGraphicsState();
+        }
+        for( unsigned int lodLevel = 0; lodLevel < 3; lodLevel++ ){
+            if( lodPlane->textureOpaque( lodLevel ) != opaquePass ){
+                continue;
+            }
+            if( UseShaderVariant( lodPlane->shaderFeatures( lodLevel ) | SHADER_FEATURE_INSTANCING ) ){
+                SendObjectUniforms( lodLevel );
+                lodPlane->bindTexture( lodLevel );
+                gpuCuller_.draw( lodLevel );
+            }
+        }
+    }
+    return true;
+}
+
+
+// --------------------------------------------------------------------------
+// Terrain.
+// Mono views can draw a terrain paged in from a heightmap file around the
+// camera (see TerrainPager), before the planes: it is opaque, so the planes
+// behind it are rejected by the depth test. Stereo views don't draw it.
+
+static TerrainPager terrainPager_;
+static TerrainMesh terrainMesh_;
+static unsigned int terrainFrameId_ = 0;
+
+// Uploaded on their own, so the planes' batch is left alone.
+static std::vector< ObjectUniforms > terrainUniforms_;
+
+
+void EXPORT_API LoadTerrainFromUnity( const char* path, unsigned int viewRadius )
+{
+    LoadTerrainCommand command;
+    strncpy( command.path, path ? path : "", sizeof( command.path ) - 1 );
+    command.path[sizeof( command.path ) - 1] = '\0';
+    command.viewRadius = viewRadius;
+    commandQueue_.recording().record( command );
+}
+
+
+// Replaces the terrain with the one in the heightmap file at path (none if
+// path is empty).
+static void LoadTerrain( const char* path, unsigned int viewRadius )
+{
+    terrainMesh_.release();
+    terrainPager_.close();
+    if( path[0] == '\0' ){
+        return;
+    }
+    if( viewRadius > TerrainPager::MAX_VIEW_RADIUS ){
+        LOG(ERROR) << "LoadTerrain - view radius " << viewRadius << " clamped to "
+                   << TerrainPager::MAX_VIEW_RADIUS << std::endl;
+        viewRadius = TerrainPager::MAX_VIEW_RADIUS;
+    }
+    if( !terrainPager_.open( path, viewRadius ) ){
+        LOG(ERROR) << "LoadTerrain - can't page a heightmap from " << path << std::endl;
+        return;
+    }
+    const HeightmapHeader& header = terrainPager_.header();
+    LOG(INFO) << "LoadTerrain - " << path << ": " << header.tilesX << "x" << header.tilesZ
+              << " tiles of " << header.tileSize << " quads, " << terrainPager_.slotCount() << " resident" << std::endl;
+}
+
+
+// GL objects only: the terrain is still paged, and its mesh is made again
+// on the next draw.
+static void ReleaseTerrain()
+{
+    terrainMesh_.release();
+}
+
+
+// Returns true when it uploaded object uniforms (which are then the current
+// ones instead of the planes').
+static bool RenderTerrain( const FrameState& frame )
+{
+    if( !terrainPager_.isOpen() ){
+        return false;
+    }
+    if( !terrainMesh_.initialized() ){
+        if( !terrainMesh_.init( terrainPager_ ) ){
+            LOG(ERROR) << "RenderTerrain - terrain buffers not available, terrain unloaded" << std::endl;
+            terrainPager_.close();
+            return false;
+        }
+        terrainFrameId_ = 0;
+    }
+
+    // Paging follows the frame's camera, once per frame.
+    if( !IsSameFrame( frame.frameId, terrainFrameId_ ) ){
+        terrainFrameId_ = frame.frameId;
+        terrainPager_.update( glm::vec3( frame.cameraPos ), frame.time );
+        terrainMesh_.update( terrainPager_ );
+    }
+
+    // Vertices are already in world space.
+    terrainUniforms_.assign( 1, ComputeObjectUniforms( glm::mat4( 1.0f ), frame.viewMatrix, frame.projectionMatrix ) );
+    SendFrameUniforms( frame.viewMatrix, frame.projectionMatrix, frame.time );
+    UploadObjectUniforms( terrainUniforms_ );
+
+    SetOpaqueGraphicsState();
+    if( UseShaderVariant( SHADER_FEATURE_VERTEX_COLOR ) ){
+        SendObjectUniforms( 0 );
+        terrainMesh_.render( frame.projectionMatrix * frame.viewMatrix, glm::vec3( frame.cameraPos ) );
+    }
+    SetDefaultGraphicsState();
+    return true;
+}
+
+
+// --------------------------------------------------------------------------
+// Stereo rendering.
+// Cardboard renders both eyes side by side into the same target, one camera
+// per eye. Instead of a render event per eye, scripts give the matrices of
+// both eyes and issue a single kPluginEventRenderStereoFrame from the camera
+// of the last one, and every plane is submitted once for both eyes: with
+// OVR_multiview into our own two layer target (composited afterwards), or
+// with an instance per eye clipped to its half of the viewport. GLES2 draws
+// each eye in turn.
+
+static MultiviewTarget multiviewTarget_;
+
+// Lens undistortion of the stereo image, replacing Cardboard's own pass.
+// Scripts send the viewer parameters whenever they (or the stereo image)
+// change, and issue kPluginEventRenderDistortion from the post render
+// camera.
+static DistortionMesh distortionMesh_;
+static GLuint distortionSourceTexture_ = 0;
+
+
+void EXPORT_API SetDistortionFromUnity( float k1, float k2,
+                                        float* lensFrustum,
+                                        float* noLensFrustum,
+                                        float* viewport,
+                                        void* sourceTexture )
+{
+    SetDistortionCommand command;
+    command.parameters.k1 = k1;
+    command.parameters.k2 = k2;
+    memcpy( command.parameters.lensFrustum, lensFrustum, sizeof( command.parameters.lensFrustum ) );
+    memcpy( command.parameters.noLensFrustum, noLensFrustum, sizeof( command.parameters.noLensFrustum ) );
+    memcpy( command.parameters.viewport, viewport, sizeof( command.parameters.viewport ) );
+    command.sourceTexture = sourceTexture;
+    commandQueue_.recording().record( command );
+}
+
+
+static void SetDistortion( const DistortionParameters& parameters, void* sourceTexture )
+{
+    distortionMesh_.build( parameters );
+    distortionSourceTexture_ = (GLuint)(size_t)(sourceTexture);
+}
+
+
+static void RenderDistortion()
+{
+    if( distortionSourceTexture_ != 0 ){
+        distortionMesh_.render( distortionSourceTexture_ );
+    }
+}
+
+
+static void ReleaseStereoResources()
+{
+    multiviewTarget_.release();
+    distortionMesh_.release();
+    distortionSourceTexture_ = 0;
+}
+
+
+static void RenderPlanesPerEye( const FrameState& frame, const GLint stereoViewport[4] )
+{
+    const GLint eyeWidth = stereoViewport[2] / 2;
+    for( int eye = 0; eye < 2; eye++ ){
+        objectUniforms_.clear();
+        for( unsigned int i = 0; i < frame.objectCount; i++ ){
+            AddPlaneToBatch( frame.modelMatrices[i], frame.eyeViewMatrices[eye], frame.eyeProjectionMatrices[eye], objectLODs_[i] );
+        }
+        SendFrameUniforms( frame.eyeViewMatrices[eye], frame.eyeProjectionMatrices[eye], frame.time );
+        PrepareBatch();
+
+        glViewport( stereoViewport[0] + eye * eyeWidth, stereoViewport[1], eyeWidth, stereoViewport[3] );
+        RenderQueuedPlanes();
+    }
+
+    // The uploaded uniforms are the ones of the right eye.
+    batchViewValid_ = false;
+}
+
+
+static void RenderStereoPlanes( const FrameState& frame )
+{
+    if( frame.stereoEye < 0 ){
+        // Scripts didn't give the eye matrices.
+        SetDefaultGraphicsState();
+        RenderPlanes( frame );
+        return;
+    }
+    if( frame.objectCount == 0 ){
+        return;
+    }
+
+    // Unity set the viewport (and maybe a scissor box) of the current eye.
+    GLint eyeViewport[4];
+    glGetIntegerv( GL_VIEWPORT, eyeViewport );
+    GLint stereoViewport[4];
+    StereoViewport( eyeViewport, frame.stereoEye, stereoViewport );
+    const GLboolean scissorTest = glIsEnabled( GL_SCISSOR_TEST );
+    glState.setEnabled( GL_SCISSOR_TEST, false );
+
+    // LOD levels are selected from the current eye, so both eyes use the
+    // same ones. Stereo variants only take the model matrices from the batch.
+    const bool uploadUniforms = BuildFrameBatch( frame );
+    SendFrameUniforms( frame.viewMatrix, frame.projectionMatrix, frame.time );
+    PrepareBatch( uploadUniforms );
+
+    // Both eyes draw in the order of the current one.
+    SortFramePlanes( frame, frame.projectionMatrix * frame.viewMatrix );
+
+    const glm::mat4 eyeViewProjMatrices[2] = {
+        frame.eyeProjectionMatrices[0] * frame.eyeViewMatrices[0],
+        frame.eyeProjectionMatrices[1] * frame.eyeViewMatrices[1]
+    };
+
+    StereoMode mode = SupportedStereoMode();
+    if( mode == kStereoModeMultiview ){
+        bool rendered = false;
+        {
+            // Unity state we are going to change.
+            ScopedRenderTargetState savedState;
+            if( multiviewTarget_.bind( stereoViewport[2] / 2, stereoViewport[3] ) ){
+                SetDefaultGraphicsState();
+                SendStereoUniforms( eyeViewProjMatrices, 0.0f );
+                RenderQueuedPlanes( SHADER_FEATURE_MULTIVIEW );
+                rendered = true;
+            }
+        }
+        if( rendered ){
+            multiviewTarget_.composite( stereoViewport );
+        }else{
+            mode = glext.instancedStereo ? kStereoModeInstanced : kStereoModeTwoPasses;
+        }
+    }
+
+    if( mode == kStereoModeInstanced ){
+        SetDefaultGraphicsState();
+        glViewport( stereoViewport[0], stereoViewport[1], stereoViewport[2], stereoViewport[3] );
+        SendStereoUniforms( eyeViewProjMatrices, static_cast< float >( stereoViewport[0] + stereoViewport[2] / 2 ) );
+        RenderQueuedPlanes( SHADER_FEATURE_STEREO, 2 );
+    }else if( mode == kStereoModeTwoPasses ){
+        SetDefaultGraphicsState();
+        RenderPlanesPerEye( frame, stereoViewport );
+    }
+
+    glViewport( eyeViewport[0], eyeViewport[1], eyeViewport[2], eyeViewport[3] );
+    if( scissorTest ){
+        glState.setEnabled( GL_SCISSOR_TEST, true );
+    }
+}
+
+
+// --------------------------------------------------------------------------
+// Compressed procedural texture.
+// When enabled (and ETC1 is supported), the procedural texture is encoded to
+// ETC1 into a texture owned by the plugin, which scripts get with
+// GetCompressedProceduralTextureFromUnity() and wrap with
+// Texture2D.CreateExternalTexture(). Encoding is much slower than a plain
+// upload, so it's only redone every updateInterval seconds.
+
+static bool proceduralCompression_ = false;
+static float proceduralCompressionInterval_ = 0.0f;
+static float lastProceduralEncodeTime_ = 0.0f;
+static GLuint compressedProceduralTexture_ = 0;
+static std::atomic< unsigned int > compressedProceduralTextureName_( 0 );
+static std::vector< unsigned char > proceduralPixels_;
+static PlasmaEvaluator plasmaEvaluator_;
+static std::vector< unsigned char > proceduralETC1Data_;
+
+
+unsigned int EXPORT_API GetCompressedProceduralTextureFromUnity()
+{
+    return compressedProceduralTextureName_.load();
+}
+
+
+static void SetProceduralTextureCompression( bool enabled, float updateInterval )
+{
+    proceduralCompression_ = enabled;
+    proceduralCompressionInterval_ = updateInterval;
+
+    if( !enabled && compressedProceduralTexture_ != 0 ){
+        glDeleteTextures( 1, &compressedProceduralTexture_ );
+        glState.invalidate();
+        compressedProceduralTexture_ = 0;
+        compressedProceduralTextureName_.store( 0 );
+    }
+}
+
+
+static void UpdateCompressedProceduralTexture( float time, int width, int height )
+{
+    // Only update when it's due (or time went backwards, ie. a new level).
+    if( compressedProceduralTexture_ != 0 &&
+        time >= lastProceduralEncodeTime_ &&
+        time - lastProceduralEncodeTime_ < proceduralCompressionInterval_ ){
+        return;
+    }
+    lastProceduralEncodeTime_ = time;
+
+    // ETC1 works on 4x4 blocks.
+    width &= ~3;
+    height &= ~3;
+
+    proceduralPixels_.resize( width * height * 4 );
+    plasmaEvaluator_.fill( width, height, width * 4, time, proceduralPixels_.data() );
+    proceduralETC1Data_.resize( ETC1DataSize( width, height ) );
+    EncodeETC1( proceduralPixels_.data(), width, height, width * 4, proceduralETC1Data_.data() );
+
+    if( compressedProceduralTexture_ == 0 ){
+        glGenTextures( 1, &compressedProceduralTexture_ );
+        glState.bindTexture( GL_TEXTURE_2D, compressedProceduralTexture_ );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+        compressedProceduralTextureName_.store( compressedProceduralTexture_ );
+    }else{
+        glState.bindTexture( GL_TEXTURE_2D, compressedProceduralTexture_ );
+    }
+
+    // ETC1 textures can't be partially updated, so respecify the whole level.
+    const GLenum format = glext.compressedETC2 ? GL_COMPRESSED_RGB8_ETC2 : GL_ETC1_RGB8_OES;
+    glCompressedTexImage2D( GL_TEXTURE_2D, 0, format, width, height, 0,
+                            static_cast< GLsizei >( proceduralETC1Data_.size() ), proceduralETC1Data_.data() );
+}
+
+
+// --------------------------------------------------------------------------
+// Procedural texture backends.
+
+static ProceduralTextureBackend proceduralBackend_ = kProceduralTextureCPU;
+static GPUPlasmaGenerator gpuPlasmaGenerator_;
+
+// CPU copy of the procedural texture. Only the tiles which changed since the
+// previous frame are uploaded.
+static DynamicTexture proceduralTexture_;
+
+// The CPU backend generates the texture in row slices into
+// proceduralSlicePixels_ (its own, as images span several frames), within a
+// per-frame budget, and only hands complete images to proceduralTexture_.
+static TextureUpdateScheduler proceduralScheduler_;
+static std::vector< unsigned char > proceduralSlicePixels_;
+static int proceduralSliceStride_ = 0;
+static ProceduralTextureFormat proceduralSliceFormat_ = kProceduralTextureRGBA32;
+
+
+void EXPORT_API SetProceduralTextureBackendFromUnity( int backend )
+{
+    SetProceduralTextureBackendCommand command;
+    command.backend = backend;
+    commandQueue_.recording().record( command );
+}
+
+
+static void SetProceduralTextureBackend( int backend )
+{
+    if( backend != kProceduralTextureCPU && backend != kProceduralTextureGPU ){
+        LOG(ERROR) << "Unknown procedural texture backend (" << backend << ")" << std::endl;
+        return;
+    }
+    proceduralBackend_ = static_cast< ProceduralTextureBackend >( backend );
+}
+
+
+void EXPORT_API SetProceduralTextureScheduleFromUnity( float updateRate, float frameBudget )
+{
+    SetProceduralTextureScheduleCommand command;
+    command.updateRate = updateRate;
+    command.frameBudget = frameBudget;
+    commandQueue_.recording().record( command );
+}
+
+
+static void SetProceduralTextureSchedule( float updateRate, float frameBudget )
+{
+    proceduralScheduler_.setTargetRate( updateRate );
+    proceduralScheduler_.setFrameBudget( frameBudget * 1.0e-3f );
+}
+
+
+static void ReleaseProceduralTextures()
+{
+    SetProceduralTextureCompression( false, 0.0f );
+    gpuPlasmaGenerator_.release();
+}
+
+
+static void UpdateProceduralTexture( float time, void* texturePointer, int width, int height, int format )
+{
+    if( proceduralCompression_ && glext.compressedETC1 && width >= 4 && height >= 4 ){
+        UpdateCompressedProceduralTexture( time, width, height );
+        return;
+    }
+
+    if( texturePointer && proceduralBackend_ == kProceduralTextureGPU ){
+        if( !gpuPlasmaGenerator_.initialized() ){
+            gpuPlasmaGenerator_.init();
+        }
+        if( gpuPlasmaGenerator_.render( (GLuint)(size_t)(texturePointer), width, height, time ) ){
+            // The CPU copy doesn't match the texture anymore.
+            proceduralTexture_.markAllDirty();
+            return;
+        }
+        // Not renderable: go on with the CPU.
     }
 
     // update native texture from code
-    if (g_TexturePointer)
+    if (texturePointer)
     {
-        GLuint gltex = (GLuint)(size_t)(g_TexturePointer);
-        glBindTexture(GL_TEXTURE_2D, gltex);
+        GLuint gltex = (GLuint)(size_t)(texturePointer);
+
+        // Rows are tightly packed, whatever the texel size.
+        const ProceduralTextureFormat textureFormat = static_cast< ProceduralTextureFormat >( format );
+        proceduralTexture_.resize( width, height, textureFormat );
+        const int stride = proceduralTexture_.stride();
 
-        unsigned char* data = new unsigned char[g_TexWidth*g_TexHeight*4];
-        FillTextureFromCode(g_TexWidth, g_TexHeight, g_TexHeight*4, data);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, g_TexWidth, g_TexHeight, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        delete[] data;
+        // Rows already generated are in the old layout.
+        if( stride != proceduralSliceStride_ || textureFormat != proceduralSliceFormat_ ){
+            proceduralScheduler_.restart();
+            proceduralSliceStride_ = stride;
+            proceduralSliceFormat_ = textureFormat;
+        }
+
+        // Only the tiles whose texels changed get uploaded (none while the
+        // time is paused or an image is in progress).
+        proceduralSlicePixels_.resize( stride * height );
+        const bool completed = proceduralScheduler_.update( time, height,
+            [=]( int firstRow, int rowCount, float imageTime ){
+                plasmaEvaluator_.fillSlice( width, height, firstRow, rowCount, stride, imageTime,
+                                            proceduralSlicePixels_.data(), textureFormat );
+            } );
+        if( completed ){
+            proceduralTexture_.write( proceduralSlicePixels_.data(), stride );
+        }
+        proceduralTexture_.upload( gltex );
     }
 }
+
+
+// Updates the procedural texture once per frame, however many views the
+// frame has.
+static void UpdateFrameProceduralTexture( const FrameState& frame, void* texturePointer )
+{
+    if( IsSameFrame( frame.frameId, textureFrameId_ ) && texturePointer == textureFramePointer_ ){
+        return;
+    }
+    textureFrameId_ = frame.frameId;
+    textureFramePointer_ = texturePointer;
+
+    UpdateProceduralTexture( frame.time, texturePointer, frame.texWidth, frame.texHeight, frame.texFormat );
+}
@@ -0,0 +1,83 @@
+#include <command_buffer.hpp>
+
+// --------------------------------------------------------------------------
+// CommandBuffer
+
+CommandBuffer::CommandBuffer( size_t initialCapacity ) :
+    arena_( initialCapacity ),
+    size_( 0 )
+{}
+
+
+const CommandHeader* CommandBuffer::first() const
+{
+    return empty() ? nullptr : reinterpret_cast< const CommandHeader* >( arena_.data() );
+}
+
+
+const CommandHeader* CommandBuffer::next( const CommandHeader* command ) const
+{
+    const uint8_t* nextCommand = reinterpret_cast< const uint8_t* >( command ) + command->size;
+    if( nextCommand >= arena_.data() + size_ ){
+        return nullptr;
+    }
+    return reinterpret_cast< const CommandHeader* >( nextCommand );
+}
+
+
+// --------------------------------------------------------------------------
+// CommandQueue
+
+CommandQueue::CommandQueue() :
+    recordingIndex_( 0 )
+{
+    for( unsigned int i = 1; i < N_BUFFERS; i++ ){
+        free_.push( i );
+    }
+}
+
+
+void CommandQueue::submit()
+{
+    if( recording().empty() ){
+        return;
+    }
+
+    unsigned int freeIndex;
+    if( !free_.pop( freeIndex ) ){
+        // Render thread is behind: keep appending to the current buffer.
+        return;
+    }
+
+    // There are only N_BUFFERS buffers, so this never fails.
+    submitted_.push( recordingIndex_ );
+    recordingIndex_ = freeIndex;
+}
+
+
+// --------------------------------------------------------------------------
+// CommandQueue::IndexRing
+
+bool CommandQueue::IndexRing::push( unsigned int index )
+{
+    const unsigned int tail = tail_.load( std::memory_order_relaxed );
+    const unsigned int nextTail = ( tail + 1 ) % CAPACITY;
+    if( nextTail == head_.load( std::memory_order_acquire ) ){
+        return false;
+    }
+    slots_[tail] = index;
+    tail_.store( nextTail, std::memory_order_release );
+    return true;
+}
+
+
+bool CommandQueue::IndexRing::pop( unsigned int& index )
+{
+    const unsigned int head = head_.load( std::memory_order_relaxed );
+    if( head == tail_.load( std::memory_order_acquire ) ){
+        return false;
+    }
+    index = slots_[head];
+    head_.store( ( head + 1 ) % CAPACITY, std::memory_order_release );
+    return true;
+}
@@ -0,0 +1,390 @@
+#include <compressed_texture.hpp>
+#include <gl_extensions.hpp>
+#include <gl_state.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+// --------------------------------------------------------------------------
+// Formats.
+
+bool IsCompressedFormatSupported( GLenum internalFormat )
+{
+    if( internalFormat == GL_ETC1_RGB8_OES ){
+        return glext.compressedETC1;
+    }
+    // EAC R11 / RG11 and ETC2 RGB8 / RGBA8 (sRGB variants included).
+    if( internalFormat >= 0x9270 && internalFormat <= 0x9279 ){
+        return glext.compressedETC2;
+    }
+    // ASTC LDR, linear and sRGB.
+    if( ( internalFormat >= 0x93B0 && internalFormat <= 0x93BD ) ||
+        ( internalFormat >= 0x93D0 && internalFormat <= 0x93DD ) ){
+        return glext.compressedASTC;
+    }
+    // DXT1 RGB / RGBA, DXT3, DXT5.
+    if( internalFormat >= 0x83F0 && internalFormat <= 0x83F3 ){
+        return glext.compressedS3TC;
+    }
+    return false;
+}
+
+
+// Bytes of a width x height image in the given format (0 if it's none of
+// the formats above).
+static size_t CompressedImageSize( GLenum internalFormat, uint32_t width, uint32_t height )
+{
+    // ASTC block sizes, in format order (the sRGB formats follow the same).
+    static const uint32_t ASTC_BLOCKS[14][2] =
+    {
+        { 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 },
+        { 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 }
+    };
+
+    uint32_t blockWidth = 4;
+    uint32_t blockHeight = 4;
+    size_t blockSize = 0;
+    if( internalFormat == GL_ETC1_RGB8_OES ||
+        internalFormat == 0x83F0 || internalFormat == 0x83F1 ){
+        blockSize = 8;
+    }else if( internalFormat >= 0x9270 && internalFormat <= 0x9279 ){
+        // EAC RG11 and ETC2 RGBA8 have a second 8 bytes half.
+        const bool twoHalves = ( internalFormat == 0x9272 || internalFormat == 0x9273 ||
+                                 internalFormat == 0x9278 || internalFormat == 0x9279 );
+        blockSize = twoHalves ? 16 : 8;
+    }else if( internalFormat == 0x83F2 || internalFormat == 0x83F3 ){
+        blockSize = 16;
+    }else if( ( internalFormat >= 0x93B0 && internalFormat <= 0x93BD ) ||
+              ( internalFormat >= 0x93D0 && internalFormat <= 0x93DD ) ){
+        const unsigned int i = internalFormat & 0xF;
+        blockWidth = ASTC_BLOCKS[i][0];
+        blockHeight = ASTC_BLOCKS[i][1];
+        blockSize = 16;
+    }
+    return static_cast< size_t >( ( width + blockWidth - 1 ) / blockWidth ) *
+           ( ( height + blockHeight - 1 ) / blockHeight ) * blockSize;
+}
+
+
+// Levels of a full mip chain, down to 1x1.
+static uint32_t MipChainLength( uint32_t width, uint32_t height )
+{
+    uint32_t levels = 1;
+    for( uint32_t size = std::max( width, height ); size > 1; size /= 2 ){
+        levels++;
+    }
+    return levels;
+}
+
+
+bool IsOpaqueCompressedFormat( GLenum internalFormat )
+{
+    // ETC1, ETC2 RGB8 (linear and sRGB) and DXT1 RGB.
+    return internalFormat == GL_ETC1_RGB8_OES ||
+           internalFormat == GL_COMPRESSED_RGB8_ETC2 ||
+           internalFormat == 0x9275 ||
+           internalFormat == 0x83F0;
+}
+
+
+// --------------------------------------------------------------------------
+// KTX files.
+
+struct KTXHeader {
+    uint8_t identifier[12];
+    uint32_t endianness;
+    uint32_t glType;
+    uint32_t glTypeSize;
+    uint32_t glFormat;
+    uint32_t glInternalFormat;
+    uint32_t glBaseInternalFormat;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t numberOfArrayElements;
+    uint32_t numberOfFaces;
+    uint32_t numberOfMipmapLevels;
+    uint32_t bytesOfKeyValueData;
+};
+
+static const uint8_t KTX_IDENTIFIER[12] =
+{
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+static const uint32_t KTX_ENDIANNESS = 0x04030201;
+
+// Upper bound for a sane texture side. Anything bigger is a corrupt file.
+static const uint32_t MAX_KTX_SIZE = 8192;
+
+
+bool LoadKTX( const std::string& path, CompressedImage& image )
+{
+    std::ifstream file( path.c_str(), std::ios::binary );
+    if( !file ){
+        return false;
+    }
+
+    KTXHeader header;
+    if( !file.read( reinterpret_cast< char* >( &header ), sizeof( header ) ) ||
+        memcmp( header.identifier, KTX_IDENTIFIER, sizeof( KTX_IDENTIFIER ) ) ){
+        LOG(ERROR) << "LoadKTX - " << path << " is not a KTX file" << std::endl;
+        return false;
+    }
+
+    // Only what our tools produce: compressed, little endian, 2D, single
+    // face textures.
+    if( header.endianness != KTX_ENDIANNESS ||
+        header.glType != 0 ||
+        header.pixelDepth > 1 ||
+        header.numberOfArrayElements > 0 ||
+        header.numberOfFaces != 1 ){
+        LOG(ERROR) << "LoadKTX - " << path << ": unsupported KTX layout" << std::endl;
+        return false;
+    }
+
+    // Sizes are checked before anything is allocated from them.
+    const uint32_t levelCount = header.numberOfMipmapLevels ? header.numberOfMipmapLevels : 1;
+    if( header.pixelWidth == 0 || header.pixelWidth > MAX_KTX_SIZE ||
+        header.pixelHeight == 0 || header.pixelHeight > MAX_KTX_SIZE ||
+        levelCount > MipChainLength( header.pixelWidth, header.pixelHeight ) ||
+        CompressedImageSize( header.glInternalFormat, 1, 1 ) == 0 ){
+        LOG(ERROR) << "LoadKTX - " << path << ": unsupported size or format" << std::endl;
+        return false;
+    }
+
+    file.seekg( header.bytesOfKeyValueData, std::ios::cur );
+
+    image.internalFormat = header.glInternalFormat;
+    image.width = header.pixelWidth;
+    image.height = header.pixelHeight;
+    image.levels.resize( levelCount );
+    uint32_t width = header.pixelWidth;
+    uint32_t height = header.pixelHeight;
+    for( std::vector< uint8_t >& level : image.levels ){
+        uint32_t imageSize = 0;
+        if( !file.read( reinterpret_cast< char* >( &imageSize ), sizeof( imageSize ) ) ||
+            imageSize != CompressedImageSize( header.glInternalFormat, width, height ) ){
+            LOG(ERROR) << "LoadKTX - " << path << ": truncated or corrupt file" << std::endl;
+            return false;
+        }
+        width = std::max( width / 2, 1u );
+        height = std::max( height / 2, 1u );
+        level.resize( imageSize );
+        if( !file.read( reinterpret_cast< char* >( level.data() ), imageSize ) ){
+            LOG(ERROR) << "LoadKTX - " << path << ": truncated file" << std::endl;
+            return false;
+        }
+        // Levels are padded to 4 bytes.
+        file.seekg( 3 - ( ( imageSize + 3 ) % 4 ), std::ios::cur );
+    }
+    return true;
+}
+
+
+GLuint UploadCompressedImage( const CompressedImage& image )
+{
+    if( !IsCompressedFormatSupported( image.internalFormat ) || image.levels.empty() ){
+        return 0;
+    }
+
+    // Errors left by Unity would fail our upload (and be lost to it anyway).
+    while( glGetError() != GL_NO_ERROR ){
+    }
+
+    GLuint texture = 0;
+    glGenTextures( 1, &texture );
+    glState.bindTexture( GL_TEXTURE_2D, texture );
+
+    GLsizei width = image.width;
+    GLsizei height = image.height;
+    for( size_t i = 0; i < image.levels.size(); i++ ){
+        glCompressedTexImage2D( GL_TEXTURE_2D, static_cast< GLint >( i ), image.internalFormat,
+                                width, height, 0,
+                                static_cast< GLsizei >( image.levels[i].size() ), image.levels[i].data() );
+        width = ( width > 1 ) ? width / 2 : 1;
+        height = ( height > 1 ) ? height / 2 : 1;
+    }
+
+    // A chain stopping before 1x1 is incomplete unless its last level is
+    // set, which GLES2 can't do: it only uses the first level then.
+    const GLint maxLevel = static_cast< GLint >( image.levels.size() ) - 1;
+    const bool fullChain = ( image.levels.size() == MipChainLength( image.width, image.height ) );
+    const bool setMaxLevel = !fullChain && ( !glext.isES || IsGLVersionAtLeast( 3, 0 ) );
+    if( setMaxLevel ){
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, maxLevel );
+    }
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                     ( maxLevel > 0 && ( fullChain || setMaxLevel ) ) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    glState.bindTexture( GL_TEXTURE_2D, 0 );
+
+    if( glGetError() != GL_NO_ERROR ){
+        LOG(ERROR) << "UploadCompressedImage - upload of format 0x" << std::hex << image.internalFormat << std::dec << " failed" << std::endl;
+        glDeleteTextures( 1, &texture );
+        return 0;
+    }
+    return texture;
+}
+
+
+GLuint LoadCompressedTexture( const std::string& basePath, GLenum* internalFormat )
+{
+    // From the best quality / compression ratio to the worst.
+    const struct {
+        const char* suffix;
+        bool supported;
+    } candidates[] =
+    {
+        { ".astc.ktx", glext.compressedASTC },
+        { ".etc2.ktx", glext.compressedETC2 },
+        { ".dxt.ktx", glext.compressedS3TC },
+        { ".etc1.ktx", glext.compressedETC1 }
+    };
+
+    for( const auto& candidate : candidates ){
+        if( !candidate.supported ){
+            continue;
+        }
+
+        const std::string path = basePath + candidate.suffix;
+        CompressedImage image;
+        if( LoadKTX( path, image ) ){
+            const GLuint texture = UploadCompressedImage( image );
+            if( texture != 0 ){
+                LOG(INFO) << "LoadCompressedTexture - " << path << " (" << image.width << "x" << image.height
+                          << ", " << image.levels.size() << " levels)" << std::endl;
+                if( internalFormat ){
+                    *internalFormat = image.internalFormat;
+                }
+                return texture;
+            }
+        }
+    }
+
+    LOG(ERROR) << "LoadCompressedTexture - no usable compressed version of " << basePath << std::endl;
+    return 0;
+}
+
+
+// --------------------------------------------------------------------------
+// ETC1 encoder.
+
+// Intensity modifiers of each ETC1 table, in pixel index order.
+static const int ETC1_MODIFIERS[8][4] =
+{
+    {  2,   8,  -2,   -8 },
+    {  5,  17,  -5,  -17 },
+    {  9,  29,  -9,  -29 },
+    { 13,  42, -13,  -42 },
+    { 18,  60, -18,  -60 },
+    { 24,  80, -24,  -80 },
+    { 33, 106, -33, -106 },
+    { 47, 183, -47, -183 }
+};
+
+
+static inline int Clamp255( int value )
+{
+    return ( value < 0 ) ? 0 : ( ( value > 255 ) ? 255 : value );
+}
+
+
+// Encodes the 2x4 sub-block of a 4x4 block starting at column firstX.
+// Returns its 4 bit base color and modifier table, and sets the pixel
+// indices in the msb / lsb halves of pixelBits.
+static void EncodeETC1SubBlock( const unsigned char* block, int stride, int firstX,
+                                int baseColor[3], int& table, uint32_t& pixelBits )
+{
+    // Average color, quantized to 4 bits per channel.
+    int sum[3] = { 0, 0, 0 };
+    for( int y = 0; y < 4; y++ ){
+        for( int x = firstX; x < firstX + 2; x++ ){
+            const unsigned char* pixel = block + y * stride + x * 4;
+            for( int c = 0; c < 3; c++ ){
+                sum[c] += pixel[c];
+            }
+        }
+    }
+    int base[3];
+    for( int c = 0; c < 3; c++ ){
+        baseColor[c] = ( ( sum[c] / 8 ) * 15 + 127 ) / 255;
+        base[c] = baseColor[c] * 17;
+    }
+
+    // Best table, with the best modifier of each pixel.
+    int bestError = -1;
+    for( int t = 0; t < 8; t++ ){
+        int error = 0;
+        uint32_t bits = 0;
+        for( int y = 0; y < 4; y++ ){
+            for( int x = firstX; x < firstX + 2; x++ ){
+                const unsigned char* pixel = block + y * stride + x * 4;
+                int bestPixelError = -1;
+                int bestIndex = 0;
+                for( int i = 0; i < 4; i++ ){
+                    int pixelError = 0;
+                    for( int c = 0; c < 3; c++ ){
+                        const int diff = Clamp255( base[c] + ETC1_MODIFIERS[t][i] ) - pixel[c];
+                        pixelError += diff * diff;
+                    }
+                    if( bestPixelError < 0 || pixelError < bestPixelError ){
+                        bestPixelError = pixelError;
+                        bestIndex = i;
+                    }
+                }
+                error += bestPixelError;
+
+                // Pixels are indexed in column major order.
+                const int bit = x * 4 + y;
+                bits |= static_cast< uint32_t >( ( bestIndex >> 1 ) & 1 ) << ( bit + 16 );
+                bits |= static_cast< uint32_t >( bestIndex & 1 ) << bit;
+            }
+        }
+        if( bestError < 0 || error < bestError ){
+            bestError = error;
+            table = t;
+            pixelBits = bits;
+        }
+    }
+}
+
+
+size_t ETC1DataSize( int width, int height )
+{
+    return static_cast< size_t >( width / 4 ) * ( height / 4 ) * 8;
+}
+
+
+void EncodeETC1( const unsigned char* rgba, int width, int height, int stride, unsigned char* dst )
+{
+    for( int blockY = 0; blockY < height; blockY += 4 ){
+        for( int blockX = 0; blockX < width; blockX += 4 ){
+            const unsigned char* block = rgba + blockY * stride + blockX * 4;
+
+            int color1[3], color2[3];
+            int table1 = 0, table2 = 0;
+            uint32_t bits1 = 0, bits2 = 0;
+            EncodeETC1SubBlock( block, stride, 0, color1, table1, bits1 );
+            EncodeETC1SubBlock( block, stride, 2, color2, table2, bits2 );
+
+            // Individual mode (diff bit 0), no flip.
+            const uint32_t high = ( static_cast< uint32_t >( color1[0] ) << 28 ) |
+                                  ( static_cast< uint32_t >( color2[0] ) << 24 ) |
+                                  ( static_cast< uint32_t >( color1[1] ) << 20 ) |
+                                  ( static_cast< uint32_t >( color2[1] ) << 16 ) |
+                                  ( static_cast< uint32_t >( color1[2] ) << 12 ) |
+                                  ( static_cast< uint32_t >( color2[2] ) << 8 ) |
+                                  ( static_cast< uint32_t >( table1 ) << 5 ) |
+                                  ( static_cast< uint32_t >( table2 ) << 2 );
+            const uint32_t low = bits1 | bits2;
+
+            // Blocks are stored big endian.
+            for( int i = 0; i < 4; i++ ){
+                dst[i] = static_cast< unsigned char >( high >> ( 24 - 8 * i ) );
+                dst[4 + i] = static_cast< unsigned char >( low >> ( 24 - 8 * i ) );
+            }
+            dst += 8;
+        }
+    }
+}
@@ -0,0 +1,244 @@
+#include <distortion_mesh.hpp>
+#include <gl_state.hpp>
+#include <shaders.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// Positions are already in clip space, so the shader is a plain texture
+// lookup faded by the vignette of the grid borders.
+static const char distortionVertexShaderCode[] =
+    "#if __VERSION__ >= 130\n"
+    "#define attribute in\n"
+    "#define varying out\n"
+    "#endif\n"
+    "attribute vec2 pos;\n"
+    "attribute vec2 uv;\n"
+    "attribute float vignette;\n"
+    "varying vec2 ouv;\n"
+    "varying float ovignette;\n"
+    "void main()\n"
+    "{\n"
+    "    ouv = uv;\n"
+    "    ovignette = vignette;\n"
+    "    gl_Position = vec4( pos, 0.0, 1.0 );\n"
+    "}\n";
+
+static const char distortionFragmentShaderCode[] =
+    "#ifdef GL_ES\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "#if __VERSION__ >= 130\n"
+    "#define varying in\n"
+    "#define texture2D texture\n"
+    "out vec4 fragColor;\n"
+    "#define gl_FragColor fragColor\n"
+    "#endif\n"
+    "varying vec2 ouv;\n"
+    "varying float ovignette;\n"
+    "uniform sampler2D sourceTexture;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = vec4( texture2D( sourceTexture, ouv ).rgb * ovignette, 1.0 );\n"
+    "}\n";
+
+
+struct DistortionVertex {
+    float x, y;         // Clip space.
+    float u, v;         // Source texture (both eyes).
+    float vignette;
+};
+
+
+static float LensDistortion( float k1, float k2, float r )
+{
+    const float r2 = r * r;
+    return ( ( k2 * r2 + k1 ) * r2 + 1.0f ) * r;
+}
+
+
+float InverseLensDistortion( float k1, float k2, float radius )
+{
+    // Secant method, as CardboardProfile does.
+    const unsigned int MAX_ITERATIONS = 32;
+    float r0 = 0.0f;
+    float r1 = 1.0f;
+    float dr0 = radius - LensDistortion( k1, k2, r0 );
+    for( unsigned int i = 0; i < MAX_ITERATIONS && std::fabs( r1 - r0 ) > 0.0001f; i++ ){
+        const float dr1 = radius - LensDistortion( k1, k2, r1 );
+        if( dr1 == dr0 ){
+            break;
+        }
+        const float r2 = r1 - dr1 * ( ( r1 - r0 ) / ( dr1 - dr0 ) );
+        r0 = r1;
+        r1 = r2;
+        dr0 = dr1;
+    }
+    return r1;
+}
+
+
+static float Lerp( float a, float b, float t )
+{
+    return a + ( b - a ) * t;
+}
+
+
+DistortionMesh::DistortionMesh() :
+    vertexBuffer_( 0 ),
+    indexBuffer_( 0 ),
+    indexCount_( 0 ),
+    program_( 0 ),
+    uvLocation_( -1 ),
+    vignetteLocation_( -1 )
+{}
+
+
+// Same mesh as CardboardPostRender's (with its vertices distorted): grid
+// points are regularly spaced in the source image and barrel distorted on
+// screen.
+void DistortionMesh::build( const DistortionParameters& parameters )
+{
+    const unsigned int N = GRID_SIZE;
+
+    float lensFrustum[4];
+    float noLensFrustum[4];
+    float viewport[4];
+    for( unsigned int i = 0; i < 4; i++ ){
+        lensFrustum[i] = parameters.lensFrustum[i];
+        noLensFrustum[i] = parameters.noLensFrustum[i];
+        viewport[i] = parameters.viewport[i];
+    }
+
+    std::vector< DistortionVertex > vertices;
+    vertices.reserve( 2 * N * N );
+    for( unsigned int eye = 0; eye < 2; eye++ ){
+        for( unsigned int j = 0; j < N; j++ ){
+            for( unsigned int i = 0; i < N; i++ ){
+                const float s = static_cast< float >( i ) / ( N - 1 );
+                const float t = static_cast< float >( j ) / ( N - 1 );
+
+                // Undistort the direction seen through the lens.
+                const float x = Lerp( lensFrustum[0], lensFrustum[2], s );
+                const float y = Lerp( lensFrustum[3], lensFrustum[1], t );
+                const float d = std::sqrt( x * x + y * y );
+                const float r = InverseLensDistortion( parameters.k1, parameters.k2, d );
+                const float p = ( d > 0.0f ) ? x * r / d : 0.0f;
+                const float q = ( d > 0.0f ) ? y * r / d : 0.0f;
+                const float u = ( p - noLensFrustum[0] ) / ( noLensFrustum[2] - noLensFrustum[0] );
+                const float v = ( q - noLensFrustum[3] ) / ( noLensFrustum[1] - noLensFrustum[3] );
+
+                DistortionVertex vertex;
+                vertex.x = ( viewport[0] + u * viewport[2] ) * 2.0f - 1.0f;
+                vertex.y = ( viewport[1] + v * viewport[3] ) * 2.0f - 1.0f;
+                vertex.u = ( s + eye ) * 0.5f;
+                vertex.v = t;
+                vertex.vignette = ( i == 0 || j == 0 || i == N - 1 || j == N - 1 ) ? 0.0f : 1.0f;
+                vertices.push_back( vertex );
+            }
+        }
+
+        // The right eye is the mirror image of the left one.
+        float w = lensFrustum[2] - lensFrustum[0];
+        lensFrustum[0] = -( w + lensFrustum[0] );
+        lensFrustum[2] = w - lensFrustum[2];
+        w = noLensFrustum[2] - noLensFrustum[0];
+        noLensFrustum[0] = -( w + noLensFrustum[0] );
+        noLensFrustum[2] = w - noLensFrustum[2];
+        viewport[0] = 1.0f - ( viewport[0] + viewport[2] );
+    }
+
+    // Quads in the lower right and upper left quadrants have their diagonal
+    // flipped, so the vignette interpolates symmetrically.
+    std::vector< GLushort > indices;
+    indices.reserve( 2 * ( N - 1 ) * ( N - 1 ) * 6 );
+    for( unsigned int eye = 0, vertex = 0; eye < 2; eye++ ){
+        for( unsigned int j = 0; j < N; j++ ){
+            for( unsigned int i = 0; i < N; i++, vertex++ ){
+                if( i == 0 || j == 0 ){
+                    continue;
+                }
+                const GLushort quad[4] = {
+                    static_cast< GLushort >( vertex - N - 1 ),  // Bottom left.
+                    static_cast< GLushort >( vertex - N ),      // Bottom right.
+                    static_cast< GLushort >( vertex - 1 ),      // Top left.
+                    static_cast< GLushort >( vertex )           // Top right.
+                };
+                if( ( i <= N / 2 ) == ( j <= N / 2 ) ){
+                    const GLushort triangles[6] = { quad[3], quad[1], quad[0], quad[0], quad[2], quad[3] };
+                    indices.insert( indices.end(), triangles, triangles + 6 );
+                }else{
+                    const GLushort triangles[6] = { quad[2], quad[3], quad[1], quad[1], quad[0], quad[2] };
+                    indices.insert( indices.end(), triangles, triangles + 6 );
+                }
+            }
+        }
+    }
+
+    if( vertexBuffer_ == 0 ){
+        glGenBuffers( 1, &vertexBuffer_ );
+        glGenBuffers( 1, &indexBuffer_ );
+    }
+    glState.bindBuffer( GL_ARRAY_BUFFER, vertexBuffer_ );
+    glBufferData( GL_ARRAY_BUFFER, vertices.size() * sizeof( DistortionVertex ), vertices.data(), GL_STATIC_DRAW );
+    glState.bindBuffer( GL_ARRAY_BUFFER, 0 );
+    glState.bindBuffer( GL_ELEMENT_ARRAY_BUFFER, indexBuffer_ );
+    glBufferData( GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof( GLushort ), indices.data(), GL_STATIC_DRAW );
+    glState.bindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+    indexCount_ = static_cast< GLsizei >( indices.size() );
+
+    if( program_ == 0 ){
+        program_ = BuildUtilityProgram( distortionVertexShaderCode, distortionFragmentShaderCode );
+        if( program_ != 0 ){
+            uvLocation_ = glGetAttribLocation( program_, "uv" );
+            vignetteLocation_ = glGetAttribLocation( program_, "vignette" );
+        }
+    }
+}
+
+
+void DistortionMesh::release()
+{
+    if( vertexBuffer_ != 0 ){
+        glDeleteBuffers( 1, &vertexBuffer_ );
+        glDeleteBuffers( 1, &indexBuffer_ );
+        vertexBuffer_ = 0;
+        indexBuffer_ = 0;
+    }
+    if( program_ != 0 ){
+        glDeleteProgram( program_ );
+        program_ = 0;
+    }
+    indexCount_ = 0;
+}
+
+
+void DistortionMesh::render( GLuint sourceTexture )
+{
+    if( !built() || program_ == 0 || uvLocation_ < 0 || vignetteLocation_ < 0 ){
+        return;
+    }
+
+    // Unity state we are going to change.
+    ScopedRenderTargetState savedState;
+
+    const GLsizei stride = sizeof( DistortionVertex );
+    glUseProgram( program_ );
+    glUniform1i( glGetUniformLocation( program_, "sourceTexture" ), 0 );
+    glBindTexture( GL_TEXTURE_2D, sourceTexture );
+    glBindBuffer( GL_ARRAY_BUFFER, vertexBuffer_ );
+    glEnableVertexAttribArray( 0 );
+    glVertexAttribPointer( 0, 2, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)offsetof( DistortionVertex, x ) );
+    glEnableVertexAttribArray( uvLocation_ );
+    glVertexAttribPointer( uvLocation_, 2, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)offsetof( DistortionVertex, u ) );
+    glEnableVertexAttribArray( vignetteLocation_ );
+    glVertexAttribPointer( vignetteLocation_, 1, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)offsetof( DistortionVertex, vignette ) );
+
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, indexBuffer_ );
+    glDrawElements( GL_TRIANGLES, indexCount_, GL_UNSIGNED_SHORT, 0 );
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+
+    glDisableVertexAttribArray( uvLocation_ );
+    glDisableVertexAttribArray( vignetteLocation_ );
+}
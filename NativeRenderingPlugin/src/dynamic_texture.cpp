@@ -0,0 +1,190 @@
+#include <dynamic_texture.hpp>
+#include <gl_extensions.hpp>
+#include <gl_state.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+DynamicTexture::DynamicTexture() :
+    width_( 0 ),
+    height_( 0 ),
+    format_( kProceduralTextureRGBA32 ),
+    bytesPerPixel_( 4 ),
+    stride_( 0 ),
+    tilesX_( 0 ),
+    tilesY_( 0 ),
+    lastTexture_( 0 )
+{}
+
+
+void DynamicTexture::resize( int width, int height, ProceduralTextureFormat format )
+{
+    if( width == width_ && height == height_ && format == format_ ){
+        return;
+    }
+
+    width_ = width;
+    height_ = height;
+    format_ = format;
+    bytesPerPixel_ = ProceduralTextureBytesPerPixel( format );
+    stride_ = width * bytesPerPixel_;
+    tilesX_ = ( width + TILE_SIZE - 1 ) / TILE_SIZE;
+    tilesY_ = ( height + TILE_SIZE - 1 ) / TILE_SIZE;
+
+    pixels_.assign( stride_ * height, 0 );
+    dirtyTiles_.assign( tilesX_ * tilesY_, 1 );
+}
+
+
+void DynamicTexture::markDirty( int x, int y, int width, int height )
+{
+    const int firstTileX = std::max( x, 0 ) / TILE_SIZE;
+    const int firstTileY = std::max( y, 0 ) / TILE_SIZE;
+    const int lastTileX = std::min( ( x + width - 1 ) / TILE_SIZE, tilesX_ - 1 );
+    const int lastTileY = std::min( ( y + height - 1 ) / TILE_SIZE, tilesY_ - 1 );
+
+    for( int tileY = firstTileY; tileY <= lastTileY; tileY++ ){
+        for( int tileX = firstTileX; tileX <= lastTileX; tileX++ ){
+            dirtyTiles_[tileY * tilesX_ + tileX] = 1;
+        }
+    }
+}
+
+
+void DynamicTexture::markAllDirty()
+{
+    std::fill( dirtyTiles_.begin(), dirtyTiles_.end(), 1 );
+}
+
+
+unsigned int DynamicTexture::dirtyTileCount() const
+{
+    return static_cast< unsigned int >( std::count( dirtyTiles_.begin(), dirtyTiles_.end(), 1 ) );
+}
+
+
+void DynamicTexture::write( const unsigned char* src, int srcStride )
+{
+    const int tileRowSize = TILE_SIZE * bytesPerPixel_;
+
+    for( int tileY = 0; tileY < tilesY_; tileY++ ){
+        const int firstY = tileY * TILE_SIZE;
+        const int lastY = std::min( firstY + TILE_SIZE, height_ );
+
+        for( int tileX = 0; tileX < tilesX_; tileX++ ){
+            const int offset = tileX * tileRowSize;
+            const int size = std::min( tileRowSize, stride_ - offset );
+
+            // Tiles already dirty are copied without comparing them.
+            bool changed = ( dirtyTiles_[tileY * tilesX_ + tileX] != 0 );
+            for( int y = firstY; y < lastY; y++ ){
+                unsigned char* dst = &pixels_[y * stride_ + offset];
+                const unsigned char* row = src + y * srcStride + offset;
+                if( changed || memcmp( dst, row, size ) ){
+                    changed = true;
+                    memcpy( dst, row, size );
+                }
+            }
+            dirtyTiles_[tileY * tilesX_ + tileX] = changed ? 1 : 0;
+        }
+    }
+}
+
+
+void DynamicTexture::dirtyRects( std::vector< TextureRect >& rects ) const
+{
+    rects.clear();
+
+    // Rectangles which may still grow down, in tile units.
+    std::vector< TextureRect > open;
+    std::vector< TextureRect > next;
+
+    for( int tileY = 0; tileY <= tilesY_; tileY++ ){
+        next.clear();
+        int tileX = 0;
+        while( tileY < tilesY_ && tileX < tilesX_ ){
+            if( !dirtyTiles_[tileY * tilesX_ + tileX] ){
+                tileX++;
+                continue;
+            }
+            TextureRect run = { tileX, tileY, 0, 1 };
+            while( tileX < tilesX_ && dirtyTiles_[tileY * tilesX_ + tileX] ){
+                tileX++;
+            }
+            run.width = tileX - run.x;
+
+            // Continue an open rectangle with the same span, if any.
+            for( TextureRect& rect : open ){
+                if( rect.width > 0 && rect.x == run.x && rect.width == run.width ){
+                    run.y = rect.y;
+                    run.height = rect.height + 1;
+                    rect.width = 0;
+                    break;
+                }
+            }
+            next.push_back( run );
+        }
+
+        // Rectangles not continued are done.
+        for( const TextureRect& rect : open ){
+            if( rect.width > 0 ){
+                rects.push_back( rect );
+            }
+        }
+        open.swap( next );
+    }
+
+    // Tiles to texels, clamped to the texture size.
+    for( TextureRect& rect : rects ){
+        rect.x *= TILE_SIZE;
+        rect.y *= TILE_SIZE;
+        rect.width = std::min( rect.width * TILE_SIZE, width_ - rect.x );
+        rect.height = std::min( rect.height * TILE_SIZE, height_ - rect.y );
+    }
+}
+
+
+size_t DynamicTexture::upload( GLuint texture )
+{
+    if( texture != lastTexture_ ){
+        markAllDirty();
+        lastTexture_ = texture;
+    }
+
+    dirtyRects( rects_ );
+    if( rects_.empty() ){
+        return 0;
+    }
+
+    GLenum glFormat, glType;
+    ProceduralTextureUploadFormat( format_, glFormat, glType );
+
+    glState.bindTexture( GL_TEXTURE_2D, texture );
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+
+    size_t uploadedBytes = 0;
+    for( const TextureRect& rect : rects_ ){
+        const unsigned char* first = &pixels_[rect.y * stride_ + rect.x * bytesPerPixel_];
+        const int rowSize = rect.width * bytesPerPixel_;
+
+        if( rect.width == width_ ){
+            // Full rows are contiguous.
+            glTexSubImage2D( GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width, rect.height, glFormat, glType, first );
+        }else if( glext.unpackRowLength ){
+            glPixelStorei( GL_UNPACK_ROW_LENGTH, width_ );
+            glTexSubImage2D( GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width, rect.height, glFormat, glType, first );
+            glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+        }else{
+            repackBuffer_.resize( rowSize * rect.height );
+            for( int y = 0; y < rect.height; y++ ){
+                memcpy( &repackBuffer_[y * rowSize], first + y * stride_, rowSize );
+            }
+            glTexSubImage2D( GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width, rect.height, glFormat, glType, repackBuffer_.data() );
+        }
+        uploadedBytes += rowSize * rect.height;
+    }
+
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+    std::fill( dirtyTiles_.begin(), dirtyTiles_.end(), 0 );
+    return uploadedBytes;
+}
@@ -0,0 +1,341 @@
+#include <gl_extensions.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <sstream>
+#include <string>
+
+#if UNITY_ANDROID || __ANDROID__
+#include <EGL/egl.h>
+#endif
+
+// Resolves an optional entry point. On Android it comes from EGL, as GLES2
+// headers and libGLESv2 don't expose GLES3 / extension functions. Elsewhere
+// it comes from GLEW or the system headers.
+#if UNITY_ANDROID || __ANDROID__
+    #define GL_EXT_LOAD( pointer, name ) \
+        pointer = reinterpret_cast< decltype( pointer ) >( eglGetProcAddress( #name ) )
+#else
+    #define GL_EXT_LOAD( pointer, name ) \
+        pointer = reinterpret_cast< decltype( pointer ) >( name )
+#endif
+
+// Same as GL_EXT_LOAD, for entry points too recent to be declared by the
+// GLEW version we build against. Only resolved on Android and Windows.
+#define GL_EXT_LOAD_DYNAMIC( pointer, name ) \
+    pointer = reinterpret_cast< decltype( pointer ) >( GetGLProcAddress( #name ) )
+
+static void* GetGLProcAddress( const char* name )
+{
+#if UNITY_ANDROID || __ANDROID__
+    return reinterpret_cast< void* >( eglGetProcAddress( name ) );
+#elif UNITY_WIN
+    return reinterpret_cast< void* >( wglGetProcAddress( name ) );
+#else
+    (void)( name );
+    return nullptr;
+#endif
+}
+
+GLExtensions glext;
+
+static std::set< std::string > extensions_;
+
+
+static void ParseGLVersion()
+{
+    glext.isES = false;
+    glext.majorVersion = 0;
+    glext.minorVersion = 0;
+
+    const char* version = reinterpret_cast< const char* >( glGetString( GL_VERSION ) );
+    if( !version ){
+        return;
+    }
+
+    // GLES version strings look like "OpenGL ES 3.0 <vendor stuff>", desktop
+    // ones like "4.5.0 <vendor stuff>".
+    const char esPrefix[] = "OpenGL ES ";
+    if( !strncmp( version, esPrefix, strlen( esPrefix ) ) ){
+        glext.isES = true;
+        version += strlen( esPrefix );
+    }
+    sscanf( version, "%d.%d", &glext.majorVersion, &glext.minorVersion );
+}
+
+
+static void ParseGLExtensions()
+{
+    extensions_.clear();
+
+    const char* extensions = reinterpret_cast< const char* >( glGetString( GL_EXTENSIONS ) );
+    if( extensions ){
+        std::istringstream stream( extensions );
+        std::string extension;
+        while( stream >> extension ){
+            extensions_.insert( extension );
+        }
+    }
+#if !( UNITY_ANDROID || __ANDROID__ ) && !UNITY_IPHONE
+    else if( IsGLVersionAtLeast( 3, 0 ) ){
+        // Core profiles only expose extensions through glGetStringi.
+        GLint nExtensions = 0;
+        glGetIntegerv( GL_NUM_EXTENSIONS, &nExtensions );
+        for( GLint i = 0; i < nExtensions; i++ ){
+            extensions_.insert( reinterpret_cast< const char* >( glGetStringi( GL_EXTENSIONS, i ) ) );
+        }
+    }
+#endif
+}
+
+
+static void LoadProgramBinaryFunctions()
+{
+    glext.getProgramBinary = nullptr;
+    glext.programBinaryFunc = nullptr;
+    glext.programParameteri = nullptr;
+
+#if UNITY_ANDROID || __ANDROID__
+    if( IsGLVersionAtLeast( 3, 0 ) ){
+        GL_EXT_LOAD( glext.getProgramBinary, glGetProgramBinary );
+        GL_EXT_LOAD( glext.programBinaryFunc, glProgramBinary );
+        GL_EXT_LOAD( glext.programParameteri, glProgramParameteri );
+    }else if( HasGLExtension( "GL_OES_get_program_binary" ) ){
+        GL_EXT_LOAD( glext.getProgramBinary, glGetProgramBinaryOES );
+        GL_EXT_LOAD( glext.programBinaryFunc, glProgramBinaryOES );
+    }
+#elif !UNITY_IPHONE
+    if( IsGLVersionAtLeast( 4, 1 ) || HasGLExtension( "GL_ARB_get_program_binary" ) ){
+        GL_EXT_LOAD( glext.getProgramBinary, glGetProgramBinary );
+        GL_EXT_LOAD( glext.programBinaryFunc, glProgramBinary );
+        GL_EXT_LOAD( glext.programParameteri, glProgramParameteri );
+    }
+#endif
+
+    glext.programBinary = glext.getProgramBinary && glext.programBinaryFunc;
+
+    // Some drivers advertise the extension but support no binary format.
+    if( glext.programBinary ){
+        GLint nFormats = 0;
+        glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &nFormats );
+        glext.programBinary = ( nFormats > 0 );
+    }
+}
+
+
+static void LoadParallelShaderCompileFunctions()
+{
+    glext.maxShaderCompilerThreads = nullptr;
+
+    if( HasGLExtension( "GL_KHR_parallel_shader_compile" ) ){
+        GL_EXT_LOAD_DYNAMIC( glext.maxShaderCompilerThreads, glMaxShaderCompilerThreadsKHR );
+    }else if( HasGLExtension( "GL_ARB_parallel_shader_compile" ) ){
+        GL_EXT_LOAD_DYNAMIC( glext.maxShaderCompilerThreads, glMaxShaderCompilerThreadsARB );
+    }
+
+    glext.parallelShaderCompile = ( glext.maxShaderCompilerThreads != nullptr );
+    if( glext.parallelShaderCompile ){
+        // Let the driver pick the number of threads.
+        glext.maxShaderCompilerThreads( 0xFFFFFFFF );
+    }
+}
+
+
+static void LoadUniformBufferFunctions()
+{
+    glext.getUniformBlockIndex = nullptr;
+    glext.uniformBlockBinding = nullptr;
+    glext.bindBufferRange = nullptr;
+    glext.bindBufferBase = nullptr;
+    glext.glslVersionDirective = "";
+
+#if !UNITY_IPHONE
+    if( glext.isES ? IsGLVersionAtLeast( 3, 0 ) : IsGLVersionAtLeast( 3, 1 ) ){
+        GL_EXT_LOAD( glext.getUniformBlockIndex, glGetUniformBlockIndex );
+        GL_EXT_LOAD( glext.uniformBlockBinding, glUniformBlockBinding );
+        GL_EXT_LOAD( glext.bindBufferRange, glBindBufferRange );
+        GL_EXT_LOAD( glext.bindBufferBase, glBindBufferBase );
+    }
+#endif
+
+    glext.uniformBuffers = glext.getUniformBlockIndex && glext.uniformBlockBinding &&
+                           glext.bindBufferRange && glext.bindBufferBase;
+    if( glext.uniformBuffers ){
+        glext.glslVersionDirective = glext.isES ? "#version 300 es\n" : "#version 140\n";
+    }
+}
+
+
+static void LoadTextureArrayFunctions()
+{
+    glext.texImage3D = nullptr;
+    glext.framebufferTextureLayer = nullptr;
+
+    if( glext.uniformBuffers ){
+        GL_EXT_LOAD( glext.texImage3D, glTexImage3D );
+        GL_EXT_LOAD( glext.framebufferTextureLayer, glFramebufferTextureLayer );
+    }
+
+    glext.textureArrays = glext.texImage3D && glext.framebufferTextureLayer;
+}
+
+
+static void LoadStereoFunctions()
+{
+    glext.drawElementsInstanced = nullptr;
+    glext.framebufferTextureMultiview = nullptr;
+
+    if( glext.uniformBuffers ){
+        GL_EXT_LOAD( glext.drawElementsInstanced, glDrawElementsInstanced );
+    }
+    glext.instancedStereo = ( glext.drawElementsInstanced != nullptr );
+
+    if( glext.instancedStereo && glext.textureArrays &&
+        ( HasGLExtension( "GL_OVR_multiview" ) || HasGLExtension( "GL_OVR_multiview2" ) ) ){
+        GL_EXT_LOAD_DYNAMIC( glext.framebufferTextureMultiview, glFramebufferTextureMultiviewOVR );
+    }
+    glext.multiview = ( glext.framebufferTextureMultiview != nullptr );
+}
+
+
+static void LoadOcclusionQueryFunctions()
+{
+    glext.genQueries = nullptr;
+    glext.deleteQueries = nullptr;
+    glext.beginQuery = nullptr;
+    glext.endQuery = nullptr;
+    glext.getQueryObjectuiv = nullptr;
+    glext.occlusionQueryTarget = GL_ANY_SAMPLES_PASSED_CONSERVATIVE;
+
+#if UNITY_ANDROID || __ANDROID__
+    if( IsGLVersionAtLeast( 3, 0 ) ){
+        GL_EXT_LOAD( glext.genQueries, glGenQueries );
+        GL_EXT_LOAD( glext.deleteQueries, glDeleteQueries );
+        GL_EXT_LOAD( glext.beginQuery, glBeginQuery );
+        GL_EXT_LOAD( glext.endQuery, glEndQuery );
+        GL_EXT_LOAD( glext.getQueryObjectuiv, glGetQueryObjectuiv );
+    }else if( HasGLExtension( "GL_EXT_occlusion_query_boolean" ) ){
+        GL_EXT_LOAD( glext.genQueries, glGenQueriesEXT );
+        GL_EXT_LOAD( glext.deleteQueries, glDeleteQueriesEXT );
+        GL_EXT_LOAD( glext.beginQuery, glBeginQueryEXT );
+        GL_EXT_LOAD( glext.endQuery, glEndQueryEXT );
+        GL_EXT_LOAD( glext.getQueryObjectuiv, glGetQueryObjectuivEXT );
+    }
+#elif !UNITY_IPHONE
+    if( !glext.isES || IsGLVersionAtLeast( 3, 0 ) ){
+        GL_EXT_LOAD( glext.genQueries, glGenQueries );
+        GL_EXT_LOAD( glext.deleteQueries, glDeleteQueries );
+        GL_EXT_LOAD( glext.beginQuery, glBeginQuery );
+        GL_EXT_LOAD( glext.endQuery, glEndQuery );
+        GL_EXT_LOAD( glext.getQueryObjectuiv, glGetQueryObjectuiv );
+    }
+    if( !glext.isES && !IsGLVersionAtLeast( 4, 3 ) && !HasGLExtension( "GL_ARB_ES3_compatibility" ) ){
+        glext.occlusionQueryTarget = ( IsGLVersionAtLeast( 3, 3 ) || HasGLExtension( "GL_ARB_occlusion_query2" ) ) ?
+                                     GL_ANY_SAMPLES_PASSED : GL_SAMPLES_PASSED;
+    }
+#endif
+
+    glext.occlusionQueries = glext.genQueries && glext.deleteQueries && glext.beginQuery &&
+                             glext.endQuery && glext.getQueryObjectuiv;
+}
+
+
+static void LoadComputeFunctions()
+{
+    glext.dispatchCompute = nullptr;
+    glext.memoryBarrier = nullptr;
+    glext.drawElementsIndirect = nullptr;
+    glext.vertexAttribDivisor = nullptr;
+    glext.genVertexArrays = nullptr;
+    glext.deleteVertexArrays = nullptr;
+    glext.bindVertexArray = nullptr;
+    glext.mapBufferRange = nullptr;
+    glext.unmapBuffer = nullptr;
+    glext.glslComputeVersionDirective = "";
+
+#if !UNITY_IPHONE
+    if( glext.uniformBuffers && glext.drawElementsInstanced &&
+        ( glext.isES ? IsGLVersionAtLeast( 3, 1 ) : IsGLVersionAtLeast( 4, 3 ) ) ){
+        GL_EXT_LOAD( glext.dispatchCompute, glDispatchCompute );
+        GL_EXT_LOAD( glext.memoryBarrier, glMemoryBarrier );
+        GL_EXT_LOAD( glext.drawElementsIndirect, glDrawElementsIndirect );
+        GL_EXT_LOAD( glext.vertexAttribDivisor, glVertexAttribDivisor );
+        GL_EXT_LOAD( glext.genVertexArrays, glGenVertexArrays );
+        GL_EXT_LOAD( glext.deleteVertexArrays, glDeleteVertexArrays );
+        GL_EXT_LOAD( glext.bindVertexArray, glBindVertexArray );
+        GL_EXT_LOAD( glext.mapBufferRange, glMapBufferRange );
+        GL_EXT_LOAD( glext.unmapBuffer, glUnmapBuffer );
+    }
+#endif
+
+    glext.computeShaders = glext.dispatchCompute && glext.memoryBarrier && glext.drawElementsIndirect &&
+                           glext.vertexAttribDivisor && glext.genVertexArrays && glext.deleteVertexArrays &&
+                           glext.bindVertexArray && glext.mapBufferRange && glext.unmapBuffer;
+    if( glext.computeShaders ){
+        glext.glslComputeVersionDirective = glext.isES ? "#version 310 es\n" : "#version 430\n";
+    }
+}
+
+
+static void ParseCompressedTextureFormats()
+{
+    glext.compressedETC2 = ( glext.isES && IsGLVersionAtLeast( 3, 0 ) ) ||
+                           IsGLVersionAtLeast( 4, 3 ) ||
+                           HasGLExtension( "GL_ARB_ES3_compatibility" );
+
+    // ETC2 decoders decode ETC1 too.
+    glext.compressedETC1 = glext.compressedETC2 ||
+                           HasGLExtension( "GL_OES_compressed_ETC1_RGB8_texture" );
+
+    glext.compressedASTC = HasGLExtension( "GL_KHR_texture_compression_astc_ldr" ) ||
+                           HasGLExtension( "GL_OES_texture_compression_astc" );
+
+    glext.compressedS3TC = HasGLExtension( "GL_EXT_texture_compression_s3tc" );
+}
+
+
+void InitGLExtensions()
+{
+    ParseGLVersion();
+    ParseGLExtensions();
+
+    LoadProgramBinaryFunctions();
+    LoadParallelShaderCompileFunctions();
+    LoadUniformBufferFunctions();
+    LoadTextureArrayFunctions();
+    LoadStereoFunctions();
+    LoadOcclusionQueryFunctions();
+    LoadComputeFunctions();
+    ParseCompressedTextureFormats();
+
+    glext.unpackRowLength = !glext.isES || IsGLVersionAtLeast( 3, 0 ) ||
+                            HasGLExtension( "GL_EXT_unpack_subimage" );
+
+    LOG(INFO) << "GL " << ( glext.isES ? "ES " : "" )
+              << glext.majorVersion << "." << glext.minorVersion
+              << ", " << extensions_.size() << " extensions"
+              << ", program binary: " << glext.programBinary
+              << ", parallel shader compile: " << glext.parallelShaderCompile
+              << ", uniform buffers: " << glext.uniformBuffers
+              << ", texture arrays: " << glext.textureArrays
+              << ", instanced stereo / multiview: " << glext.instancedStereo << glext.multiview
+              << ", occlusion queries: " << glext.occlusionQueries
+              << ", compute shaders: " << glext.computeShaders
+              << ", unpack row length: " << glext.unpackRowLength
+              << ", ETC1/ETC2/ASTC/S3TC: " << glext.compressedETC1 << glext.compressedETC2
+              << glext.compressedASTC << glext.compressedS3TC << std::endl;
+}
+
+
+bool HasGLExtension( const char* name )
+{
+    return extensions_.count( name ) != 0;
+}
+
+
+bool IsGLVersionAtLeast( int major, int minor )
+{
+    return ( glext.majorVersion > major ) ||
+           ( glext.majorVersion == major && glext.minorVersion >= minor );
+}
@@ -0,0 +1,261 @@
+#include <gl_state.hpp>
+#include <gl_extensions.hpp>
+
+static const GLenum CAPABILITIES[] = { GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_SCISSOR_TEST };
+
+
+ScopedRenderTargetState::ScopedRenderTargetState()
+{
+    glGetIntegerv( GL_FRAMEBUFFER_BINDING, &framebuffer_ );
+    glGetIntegerv( GL_CURRENT_PROGRAM, &program_ );
+    glGetIntegerv( GL_ACTIVE_TEXTURE, &activeTexture_ );
+    glActiveTexture( GL_TEXTURE0 );
+    glGetIntegerv( GL_TEXTURE_BINDING_2D, &texture_ );
+    arrayTexture_ = 0;
+    if( glext.textureArrays ){
+        glGetIntegerv( GL_TEXTURE_BINDING_2D_ARRAY, &arrayTexture_ );
+    }
+    glGetIntegerv( GL_ARRAY_BUFFER_BINDING, &arrayBuffer_ );
+    glGetIntegerv( GL_VIEWPORT, viewport_ );
+    for( unsigned int i = 0; i < N_CAPABILITIES; i++ ){
+        capabilities_[i] = glIsEnabled( CAPABILITIES[i] );
+        glDisable( CAPABILITIES[i] );
+    }
+    glState.invalidate();
+}
+
+
+ScopedRenderTargetState::~ScopedRenderTargetState()
+{
+    glBindFramebuffer( GL_FRAMEBUFFER, framebuffer_ );
+    glBindTexture( GL_TEXTURE_2D, texture_ );
+    if( glext.textureArrays ){
+        glBindTexture( GL_TEXTURE_2D_ARRAY, arrayTexture_ );
+    }
+    glActiveTexture( activeTexture_ );
+    glBindBuffer( GL_ARRAY_BUFFER, arrayBuffer_ );
+    glUseProgram( program_ );
+    glViewport( viewport_[0], viewport_[1], viewport_[2], viewport_[3] );
+    for( unsigned int i = 0; i < N_CAPABILITIES; i++ ){
+        if( capabilities_[i] ){
+            glEnable( CAPABILITIES[i] );
+        }
+    }
+
+    // Whatever the pass did, the state is now Unity's.
+    glState.invalidate();
+}
+
+
+// --------------------------------------------------------------------------
+// GLStateCache
+
+GLStateCache glState;
+
+
+// Index of a shadowed GL enum in its table, or -1 if it isn't shadowed.
+static int ShadowIndex( GLenum value, const GLenum* table, unsigned int size )
+{
+    for( unsigned int i = 0; i < size; i++ ){
+        if( table[i] == value ){
+            return static_cast< int >( i );
+        }
+    }
+    return -1;
+}
+
+static const GLenum TEXTURE_TARGETS[] = { GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY };
+static const GLenum BUFFER_TARGETS[] = { GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER };
+
+
+bool GLStateCache::AttribPointer::operator == ( const AttribPointer& other ) const
+{
+    return buffer == other.buffer && size == other.size && type == other.type &&
+           normalized == other.normalized && stride == other.stride && pointer == other.pointer;
+}
+
+
+GLStateCache::GLStateCache() :
+    issuedCalls_( 0 ),
+    avoidedCalls_( 0 )
+{
+    invalidate();
+}
+
+
+void GLStateCache::invalidate()
+{
+    for( Shadowed< bool >& capability : capabilities_ ){
+        capability.known = false;
+    }
+    blendSourceFactor_.known = false;
+    blendDestinationFactor_.known = false;
+    depthFunc_.known = false;
+    depthMask_.known = false;
+    program_.known = false;
+    activeTexture_.known = false;
+    for( unsigned int unit = 0; unit < N_TEXTURE_UNITS; unit++ ){
+        for( Shadowed< GLuint >& texture : textures_[unit] ){
+            texture.known = false;
+        }
+    }
+    for( Shadowed< GLuint >& buffer : buffers_ ){
+        buffer.known = false;
+    }
+    for( unsigned int i = 0; i < N_VERTEX_ATTRIBS; i++ ){
+        vertexAttribArrays_[i].known = false;
+        vertexAttribPointers_[i].known = false;
+    }
+}
+
+
+template < class T >
+bool GLStateCache::change( Shadowed< T >& shadow, const T& value )
+{
+    if( shadow.known && shadow.value == value ){
+        avoidedCalls_++;
+        return false;
+    }
+    shadow.value = value;
+    shadow.known = true;
+    issuedCalls_++;
+    return true;
+}
+
+
+void GLStateCache::setEnabled( GLenum capability, bool enabled )
+{
+    const int index = ShadowIndex( capability, CAPABILITIES, N_CAPABILITIES );
+    if( index < 0 ){
+        issuedCalls_++;
+    }else if( !change( capabilities_[index], enabled ) ){
+        return;
+    }
+
+    if( enabled ){
+        glEnable( capability );
+    }else{
+        glDisable( capability );
+    }
+}
+
+
+void GLStateCache::blendFunc( GLenum sourceFactor, GLenum destinationFactor )
+{
+    // Both factors are set by a single call.
+    const bool sourceChanged = !blendSourceFactor_.known || blendSourceFactor_.value != sourceFactor;
+    const bool destinationChanged = !blendDestinationFactor_.known || blendDestinationFactor_.value != destinationFactor;
+    if( !sourceChanged && !destinationChanged ){
+        avoidedCalls_++;
+        return;
+    }
+    blendSourceFactor_.value = sourceFactor;
+    blendSourceFactor_.known = true;
+    blendDestinationFactor_.value = destinationFactor;
+    blendDestinationFactor_.known = true;
+    issuedCalls_++;
+    glBlendFunc( sourceFactor, destinationFactor );
+}
+
+
+void GLStateCache::depthFunc( GLenum function )
+{
+    if( change( depthFunc_, function ) ){
+        glDepthFunc( function );
+    }
+}
+
+
+void GLStateCache::depthMask( GLboolean mask )
+{
+    if( change( depthMask_, mask ) ){
+        glDepthMask( mask );
+    }
+}
+
+
+void GLStateCache::useProgram( GLuint program )
+{
+    if( change( program_, program ) ){
+        glUseProgram( program );
+    }
+}
+
+
+void GLStateCache::activeTexture( GLenum unit )
+{
+    if( change( activeTexture_, unit ) ){
+        glActiveTexture( unit );
+    }
+}
+
+
+void GLStateCache::bindTexture( GLenum target, GLuint texture )
+{
+    const int targetIndex = ShadowIndex( target, TEXTURE_TARGETS, N_TEXTURE_TARGETS );
+    const GLenum unit = activeTexture_.known ? activeTexture_.value - GL_TEXTURE0 : N_TEXTURE_UNITS;
+    if( targetIndex < 0 || unit >= N_TEXTURE_UNITS ){
+        // Not shadowed. If we don't know the unit, it may be any of ours.
+        if( targetIndex >= 0 && !activeTexture_.known ){
+            for( unsigned int i = 0; i < N_TEXTURE_UNITS; i++ ){
+                textures_[i][targetIndex].known = false;
+            }
+        }
+        issuedCalls_++;
+        glBindTexture( target, texture );
+        return;
+    }
+
+    if( change( textures_[unit][targetIndex], texture ) ){
+        glBindTexture( target, texture );
+    }
+}
+
+
+void GLStateCache::bindBuffer( GLenum target, GLuint buffer )
+{
+    const int index = ShadowIndex( target, BUFFER_TARGETS, N_BUFFER_TARGETS );
+    if( index < 0 ){
+        issuedCalls_++;
+    }else if( !change( buffers_[index], buffer ) ){
+        return;
+    }
+    glBindBuffer( target, buffer );
+}
+
+
+void GLStateCache::setVertexAttribArrayEnabled( GLuint index, bool enabled )
+{
+    if( index >= N_VERTEX_ATTRIBS ){
+        issuedCalls_++;
+    }else if( !change( vertexAttribArrays_[index], enabled ) ){
+        return;
+    }
+
+    if( enabled ){
+        glEnableVertexAttribArray( index );
+    }else{
+        glDisableVertexAttribArray( index );
+    }
+}
+
+
+void GLStateCache::vertexAttribPointer( GLuint index, GLint size, GLenum type, GLboolean normalized,
+                                        GLsizei stride, const GLvoid* pointer )
+{
+    // The pointer is an offset into the bound array buffer, so it's only
+    // comparable when we know which one that is.
+    const Shadowed< GLuint >& arrayBuffer = buffers_[0];
+    if( index >= N_VERTEX_ATTRIBS || !arrayBuffer.known ){
+        if( index < N_VERTEX_ATTRIBS ){
+            vertexAttribPointers_[index].known = false;
+        }
+        issuedCalls_++;
+    }else{
+        const AttribPointer attribPointer = { arrayBuffer.value, size, type, normalized, stride, pointer };
+        if( !change( vertexAttribPointers_[index], attribPointer ) ){
+            return;
+        }
+    }
+    glVertexAttribPointer( index, size, type, normalized, stride, pointer );
+}
@@ -0,0 +1,311 @@
+#include <gpu_culler.hpp>
+#include <gl_extensions.hpp>
+#include <gl_state.hpp>
+#include <shaders.hpp>
+
+#include <algorithm>
+#include <glm/gtc/type_ptr.hpp>
+
+// An invocation per instance: frustum culling of its bounding sphere, LOD
+// selection (as LODPlane::selectLOD(), on the distance to the centroid) and
+// append to its level's part of the visible instances.
+static const char cullingShaderCode[] =
+    "layout(local_size_x = 64) in;\n"
+    "struct DrawCommand\n"
+    "{\n"
+    "    uint count;\n"
+    "    uint instanceCount;\n"
+    "    uint firstIndex;\n"
+    "    int baseVertex;\n"
+    "    uint reserved;\n"
+    "};\n"
+    "layout(std430, binding = 0) readonly buffer InstanceBuffer\n"
+    "{\n"
+    "    mat4 modelMatrices[];\n"
+    "};\n"
+    "layout(std430, binding = 1) writeonly buffer VisibleBuffer\n"
+    "{\n"
+    "    mat4 visibleMatrices[];\n"
+    "};\n"
+    "layout(std430, binding = 2) buffer CommandBuffer\n"
+    "{\n"
+    "    DrawCommand commands[];\n"
+    "};\n"
+    "uniform int instanceCount;\n"
+    "uniform int capacity;\n"
+    "uniform vec4 frustumPlanes[6];\n"
+    "uniform vec4 boundingSphere;\n"
+    "uniform vec4 planeCentroid;\n"
+    "uniform vec4 cameraPosition;\n"
+    "uniform vec2 lodDistances;\n"
+    "void main()\n"
+    "{\n"
+    "    int instance = int( gl_GlobalInvocationID.x );\n"
+    "    if( instance >= instanceCount ){\n"
+    "        return;\n"
+    "    }\n"
+    "    mat4 modelMatrix = modelMatrices[instance];\n"
+    "\n"
+    "    vec3 center = ( modelMatrix * vec4( boundingSphere.xyz, 1.0 ) ).xyz;\n"
+    "    float scale = max( length( modelMatrix[0].xyz ), max( length( modelMatrix[1].xyz ), length( modelMatrix[2].xyz ) ) );\n"
+    "    float radius = boundingSphere.w * scale;\n"
+    "    for( int i = 0; i < 6; i++ ){\n"
+    "        if( dot( frustumPlanes[i].xyz, center ) + frustumPlanes[i].w < -radius ){\n"
+    "            return;\n"
+    "        }\n"
+    "    }\n"
+    "\n"
+    "    float distanceToObserver = distance( cameraPosition, modelMatrix * planeCentroid );\n"
+    "    uint lodLevel = ( distanceToObserver > lodDistances.x ) ? 0u : ( ( distanceToObserver > lodDistances.y ) ? 1u : 2u );\n"
+    "    uint slot = atomicAdd( commands[lodLevel].instanceCount, 1u );\n"
+    "    visibleMatrices[lodLevel * uint( capacity ) + slot] = modelMatrix;\n"
+    "}\n";
+
+
+void FrustumPlanes( const glm::mat4& viewProjectionMatrix, glm::vec4 planes[6] )
+{
+    const glm::mat4& m = viewProjectionMatrix;
+    const glm::vec4 rows[4] = {
+        glm::vec4( m[0][0], m[1][0], m[2][0], m[3][0] ),
+        glm::vec4( m[0][1], m[1][1], m[2][1], m[3][1] ),
+        glm::vec4( m[0][2], m[1][2], m[2][2], m[3][2] ),
+        glm::vec4( m[0][3], m[1][3], m[2][3], m[3][3] )
+    };
+    for( unsigned int i = 0; i < 3; i++ ){
+        planes[2 * i] = rows[3] + rows[i];
+        planes[2 * i + 1] = rows[3] - rows[i];
+    }
+
+    // Normalized, so distances to them are in world units.
+    for( unsigned int i = 0; i < 6; i++ ){
+        planes[i] /= glm::length( glm::vec3( planes[i] ) );
+    }
+}
+
+
+GPUCuller::GPUCuller() :
+    program_( 0 ),
+    instanceCountLocation_( -1 ),
+    capacityLocation_( -1 ),
+    frustumPlanesLocation_( -1 ),
+    boundingSphereLocation_( -1 ),
+    centroidLocation_( -1 ),
+    cameraPositionLocation_( -1 ),
+    lodDistancesLocation_( -1 ),
+    vertexBuffer_( 0 ),
+    indexBuffer_( 0 ),
+    instanceBuffer_( 0 ),
+    visibleBuffer_( 0 ),
+    commandBuffer_( 0 ),
+    capacity_( 0 )
+{
+    for( GLuint& vertexArray : vertexArrays_ ){
+        vertexArray = 0;
+    }
+}
+
+
+bool GPUCuller::init( const LODPlane& plane )
+{
+    release();
+    if( !glext.computeShaders ){
+        return false;
+    }
+
+    program_ = BuildComputeProgram( cullingShaderCode );
+    if( program_ == 0 ){
+        LOG(ERROR) << "GPUCuller - culling program not built" << std::endl;
+        return false;
+    }
+    instanceCountLocation_ = glGetUniformLocation( program_, "instanceCount" );
+    capacityLocation_ = glGetUniformLocation( program_, "capacity" );
+    frustumPlanesLocation_ = glGetUniformLocation( program_, "frustumPlanes" );
+    boundingSphereLocation_ = glGetUniformLocation( program_, "boundingSphere" );
+    centroidLocation_ = glGetUniformLocation( program_, "planeCentroid" );
+    cameraPositionLocation_ = glGetUniformLocation( program_, "cameraPosition" );
+    lodDistancesLocation_ = glGetUniformLocation( program_, "lodDistances" );
+
+    glm::vec3 boxMin;
+    glm::vec3 boxMax;
+    plane.bounds( boxMin, boxMax );
+    boundingSphere_ = glm::vec4( 0.5f * ( boxMin + boxMax ), 0.5f * glm::length( boxMax - boxMin ) );
+    centroid_ = plane.centroid();
+    lodDistances_ = glm::vec2( plane.lodDistance( 0 ), plane.lodDistance( 1 ) );
+    for( unsigned int lodLevel = 0; lodLevel < N_LOD_LEVELS; lodLevel++ ){
+        DrawCommand& command = commands_[lodLevel];
+        plane.levelIndices( lodLevel, command.firstIndex, command.count );
+        command.instanceCount = 0;
+        command.baseVertex = 0;
+        command.reserved = 0;
+    }
+
+    glGenBuffers( 1, &vertexBuffer_ );
+    glGenBuffers( 1, &indexBuffer_ );
+    glGenBuffers( 1, &instanceBuffer_ );
+    glGenBuffers( 1, &visibleBuffer_ );
+    glGenBuffers( 1, &commandBuffer_ );
+    glState.bindBuffer( GL_ARRAY_BUFFER, vertexBuffer_ );
+    glBufferData( GL_ARRAY_BUFFER, plane.vertices().size() * sizeof( MyVertex ), plane.vertices().data(), GL_STATIC_DRAW );
+    glState.bindBuffer( GL_ARRAY_BUFFER, 0 );
+    glState.bindBuffer( GL_ELEMENT_ARRAY_BUFFER, indexBuffer_ );
+    glBufferData( GL_ELEMENT_ARRAY_BUFFER, plane.indices().size(), plane.indices().data(), GL_STATIC_DRAW );
+    glState.bindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+    glext.genVertexArrays( N_LOD_LEVELS, vertexArrays_ );
+
+    reserve( 256 );
+    return true;
+}
+
+
+void GPUCuller::release()
+{
+    if( program_ == 0 ){
+        return;
+    }
+    glDeleteProgram( program_ );
+    program_ = 0;
+
+    glext.deleteVertexArrays( N_LOD_LEVELS, vertexArrays_ );
+    const GLuint buffers[] = { vertexBuffer_, indexBuffer_, instanceBuffer_, visibleBuffer_, commandBuffer_ };
+    glDeleteBuffers( 5, buffers );
+    for( GLuint& vertexArray : vertexArrays_ ){
+        vertexArray = 0;
+    }
+    vertexBuffer_ = indexBuffer_ = instanceBuffer_ = visibleBuffer_ = commandBuffer_ = 0;
+    capacity_ = 0;
+    glState.invalidate();
+}
+
+
+void GPUCuller::cull( const glm::mat4* modelMatrices,
+                      unsigned int instanceCount,
+                      const glm::mat4& viewProjectionMatrix,
+                      const glm::vec4& cameraPos )
+{
+    if( !initialized() ){
+        return;
+    }
+    reserve( instanceCount );
+
+    // Fresh storage every frame (as UniformRing does), so the GPU can still
+    // be using the previous one: the instances and the commands, with their
+    // instance counts reset.
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, instanceBuffer_ );
+    glBufferData( GL_SHADER_STORAGE_BUFFER, capacity_ * sizeof( glm::mat4 ), nullptr, GL_STREAM_DRAW );
+    if( instanceCount > 0 ){
+        glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, instanceCount * sizeof( glm::mat4 ), modelMatrices );
+    }
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, commandBuffer_ );
+    glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof( commands_ ), commands_, GL_DYNAMIC_COPY );
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+    if( instanceCount == 0 ){
+        return;
+    }
+
+    glext.bindBufferBase( GL_SHADER_STORAGE_BUFFER, 0, instanceBuffer_ );
+    glext.bindBufferBase( GL_SHADER_STORAGE_BUFFER, 1, visibleBuffer_ );
+    glext.bindBufferBase( GL_SHADER_STORAGE_BUFFER, 2, commandBuffer_ );
+
+    glm::vec4 frustumPlanes[6];
+    FrustumPlanes( viewProjectionMatrix, frustumPlanes );
+    glState.useProgram( program_ );
+    glUniform1i( instanceCountLocation_, static_cast< GLint >( instanceCount ) );
+    glUniform1i( capacityLocation_, static_cast< GLint >( capacity_ ) );
+    glUniform4fv( frustumPlanesLocation_, 6, glm::value_ptr( frustumPlanes[0] ) );
+    glUniform4fv( boundingSphereLocation_, 1, glm::value_ptr( boundingSphere_ ) );
+    glUniform4fv( centroidLocation_, 1, glm::value_ptr( centroid_ ) );
+    glUniform4fv( cameraPositionLocation_, 1, glm::value_ptr( cameraPos ) );
+    glUniform2fv( lodDistancesLocation_, 1, glm::value_ptr( lodDistances_ ) );
+
+    const unsigned int workGroupSize = WORK_GROUP_SIZE;
+    glext.dispatchCompute( ( instanceCount + workGroupSize - 1 ) / workGroupSize, 1, 1 );
+
+    // The draws read what the shader wrote as commands and attributes.
+    glext.memoryBarrier( GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT );
+}
+
+
+void GPUCuller::draw( unsigned int lodLevel )
+{
+    if( !initialized() ){
+        return;
+    }
+
+    // The vertex array has its own element array buffer binding, so nothing
+    // glState shadows changes.
+    glext.bindVertexArray( vertexArrays_[lodLevel] );
+    glBindBuffer( GL_DRAW_INDIRECT_BUFFER, commandBuffer_ );
+    glext.drawElementsIndirect( GL_TRIANGLES, GL_UNSIGNED_BYTE,
+                                reinterpret_cast< const void* >( lodLevel * sizeof( DrawCommand ) ) );
+    glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+    glext.bindVertexArray( 0 );
+}
+
+
+void GPUCuller::readInstanceCounts( unsigned int counts[3] )
+{
+    for( unsigned int lodLevel = 0; lodLevel < N_LOD_LEVELS; lodLevel++ ){
+        counts[lodLevel] = 0;
+    }
+    if( !initialized() ){
+        return;
+    }
+
+    glext.memoryBarrier( GL_BUFFER_UPDATE_BARRIER_BIT );
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, commandBuffer_ );
+    const DrawCommand* commands = static_cast< const DrawCommand* >(
+        glext.mapBufferRange( GL_SHADER_STORAGE_BUFFER, 0, sizeof( commands_ ), GL_MAP_READ_BIT ) );
+    if( commands ){
+        for( unsigned int lodLevel = 0; lodLevel < N_LOD_LEVELS; lodLevel++ ){
+            counts[lodLevel] = commands[lodLevel].instanceCount;
+        }
+        glext.unmapBuffer( GL_SHADER_STORAGE_BUFFER );
+    }
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+}
+
+
+void GPUCuller::reserve( unsigned int capacity )
+{
+    if( capacity <= capacity_ ){
+        return;
+    }
+    capacity_ = std::max( 2 * capacity_, capacity );
+
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, visibleBuffer_ );
+    glBufferData( GL_SHADER_STORAGE_BUFFER, N_LOD_LEVELS * capacity_ * sizeof( glm::mat4 ), nullptr, GL_DYNAMIC_COPY );
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+    // Each level reads its instances from its own offset.
+    for( unsigned int lodLevel = 0; lodLevel < N_LOD_LEVELS; lodLevel++ ){
+        setupVertexArray( lodLevel );
+    }
+}
+
+
+void GPUCuller::setupVertexArray( unsigned int lodLevel )
+{
+    // Same vertex layout as LODPlane::render().
+    const GLsizei stride = sizeof( MyVertex );
+    glext.bindVertexArray( vertexArrays_[lodLevel] );
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, indexBuffer_ );
+    glState.bindBuffer( GL_ARRAY_BUFFER, vertexBuffer_ );
+    glEnableVertexAttribArray( 0 );
+    glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast< const void* >( 0 ) );
+    glEnableVertexAttribArray( 1 );
+    glVertexAttribPointer( 1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, reinterpret_cast< const void* >( 3 * sizeof( GLfloat ) ) );
+    glEnableVertexAttribArray( 2 );
+    glVertexAttribPointer( 2, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast< const void* >( 3 * sizeof( GLfloat ) + sizeof( unsigned int ) ) );
+
+    // instanceModelMatrix: a column per attribute (4 to 7).
+    const GLintptr levelOffset = lodLevel * capacity_ * sizeof( glm::mat4 );
+    glState.bindBuffer( GL_ARRAY_BUFFER, visibleBuffer_ );
+    for( GLuint column = 0; column < 4; column++ ){
+        glEnableVertexAttribArray( 4 + column );
+        glVertexAttribPointer( 4 + column, 4, GL_FLOAT, GL_FALSE, sizeof( glm::mat4 ),
+                               reinterpret_cast< const void* >( levelOffset + column * sizeof( glm::vec4 ) ) );
+        glext.vertexAttribDivisor( 4 + column, 1 );
+    }
+    glext.bindVertexArray( 0 );
+    glState.bindBuffer( GL_ARRAY_BUFFER, 0 );
+}
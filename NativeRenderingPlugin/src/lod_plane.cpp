@@ -1,9 +1,14 @@
 #include <lod_plane.hpp>
+#include <shaders.hpp>
+#include <gl_extensions.hpp>
+#include <gl_state.hpp>
 
 INITIALIZE_EASYLOGGINGPP
 
 LODPlane::LODPlane( GLuint textureID ) :
-	textureIDs_( 3, textureID )
+	textureIDs_( 3, textureID ),
+    textureSlots_( 3, -1 ),
+    textureOpaque_( 3, false )
 {
     // A plane.
     MyVertex srcVertices[] =
@@ -44,53 +49,133 @@ void LODPlane::setTextureID( GLuint textureID, unsigned int lodLevel )
 }
 
 
-void LODPlane::render( float distanceToObserver )
+GLuint LODPlane::textureID( unsigned int lodLevel ) const
 {
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindTexture( GL_TEXTURE_2D, 0 );
+    return textureIDs_.at( lodLevel );
+}
 
-    // Vertex layout.
-    const int stride = 3*sizeof(float) + sizeof(unsigned int) + 2 * sizeof( float );
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (const GLfloat*)vertices_.data());
-    
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (const GLfloat*)vertices_.data() + 3);
+void LODPlane::setTextureSlot( int slot, unsigned int lodLevel )
+{
+    textureSlots_.at( lodLevel ) = slot;
+}
+
+
+int LODPlane::textureSlot( unsigned int lodLevel ) const
+{
+    return textureSlots_.at( lodLevel );
+}
+
+
+void LODPlane::setTextureOpaque( bool opaque, unsigned int lodLevel )
+{
+    textureOpaque_.at( lodLevel ) = opaque;
+}
 
-	glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_TRUE, stride, (const GLbyte*)vertices_.data() + 3 * sizeof(GLfloat) + sizeof(unsigned int) );
 
-	GLint currentShaderProgram;
+bool LODPlane::textureOpaque( unsigned int lodLevel ) const
+{
+    return textureOpaque_.at( lodLevel );
+}
 
-	// Get current shader program id.
-	glGetIntegerv(GL_CURRENT_PROGRAM, &currentShaderProgram);
 
-	// Get location of sampler in shader.
-	const GLint samplerShaderLocation = glGetUniformLocation(currentShaderProgram, "textureSampler");
-	LOG(INFO) << "samplerShaderLocation: " << samplerShaderLocation << std::endl;
+// Distances beyond which each level is used (the last one is used at any
+// distance). GPUCuller selects levels with the same ones.
+static const float LOD_DISTANCES[] = { 3.0f, 2.0f, 0.0f };
 
-	// Connect sampler to texture unit 0.
-	glActiveTexture(GL_TEXTURE0);
-	glUniform1i(samplerShaderLocation, 0);
 
+unsigned int LODPlane::selectLOD( float distanceToObserver ) const
+{
     // Draw a version of the plane or another depending on the distance between
     // the camera and the plane.
-    const unsigned int N_INDICES_PER_PLANE = 6;
-    if( distanceToObserver > 3.0f ){
-		glBindTexture(GL_TEXTURE_2D, textureIDs_.at( 0 ) );
-        glDrawElements( GL_TRIANGLES, N_INDICES_PER_PLANE, GL_UNSIGNED_BYTE, indices_.data() );
-    }else if( distanceToObserver > 2.0f ){
-		glBindTexture(GL_TEXTURE_2D, textureIDs_.at( 1 ) );
-        glDrawElements( GL_TRIANGLES, 4 * N_INDICES_PER_PLANE, GL_UNSIGNED_BYTE, indices_.data() + N_INDICES_PER_PLANE );
+    unsigned int lodLevel = 0;
+    while( lodLevel < 2 && distanceToObserver <= LOD_DISTANCES[lodLevel] ){
+        lodLevel++;
+    }
+    return lodLevel;
+}
+
+
+float LODPlane::lodDistance( unsigned int lodLevel ) const
+{
+    return LOD_DISTANCES[lodLevel];
+}
+
+
+unsigned int LODPlane::shaderFeatures( unsigned int lodLevel ) const
+{
+    // Until its texture is given, a level is drawn with its vertex colors.
+    if( textureIDs_.at( lodLevel ) == 0 ){
+        return SHADER_FEATURE_VERTEX_COLOR;
+    }
+    // Premultiplying by an alpha of 1 changes nothing.
+    unsigned int features = SHADER_FEATURE_TEXTURE;
+    if( textureSlots_.at( lodLevel ) >= 0 ){
+        features |= SHADER_FEATURE_PACKED_TEXTURE;
+    }
+    if( !textureOpaque_.at( lodLevel ) ){
+        features |= SHADER_FEATURE_PREMULTIPLY;
+    }
+    return features;
+}
+
+
+void LODPlane::render( unsigned int lodLevel, unsigned int instanceCount )
+{
+    // Vertices come from client memory. Consecutive planes share all this
+    // state, so glState only sends it for the first one.
+    glState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glState.bindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Vertex layout.
+    const int stride = 3*sizeof(float) + sizeof(unsigned int) + 2 * sizeof( float );
+
+    glState.setVertexAttribArrayEnabled(0, true);
+    glState.vertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (const GLfloat*)vertices_.data());
+    
+    glState.setVertexAttribArrayEnabled(1, true);
+    glState.vertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (const GLfloat*)vertices_.data() + 3);
+
+	glState.setVertexAttribArrayEnabled(2, true);
+    glState.vertexAttribPointer(2, 2, GL_FLOAT, GL_TRUE, stride, (const GLbyte*)vertices_.data() + 3 * sizeof(GLfloat) + sizeof(unsigned int) );
+
+    bindTexture( lodLevel );
+
+    unsigned int first = 0;
+    unsigned int count = 0;
+    levelIndices( lodLevel, first, count );
+    const GLsizei nIndices = count;
+    const GLubyte* firstIndex = indices_.data() + first;
+    if( instanceCount > 1 ){
+        glext.drawElementsInstanced( GL_TRIANGLES, nIndices, GL_UNSIGNED_BYTE, firstIndex, instanceCount );
     }else{
-		glBindTexture(GL_TEXTURE_2D, textureIDs_.at( 2 ) );
-        glDrawElements( GL_TRIANGLES, 16 * N_INDICES_PER_PLANE, GL_UNSIGNED_BYTE, indices_.data() + 5 * N_INDICES_PER_PLANE );
+        glDrawElements( GL_TRIANGLES, nIndices, GL_UNSIGNED_BYTE, firstIndex );
+    }
+}
+
+
+void LODPlane::bindTexture( unsigned int lodLevel ) const
+{
+    // The shader sampler is connected to texture unit 0. Packed textures are
+    // bound once for every plane.
+    if( textureSlots_.at( lodLevel ) < 0 ){
+        glState.activeTexture( GL_TEXTURE0 );
+        glState.bindTexture( GL_TEXTURE_2D, textureIDs_.at( lodLevel ) );
     }
 }
 
 
+void LODPlane::levelIndices( unsigned int lodLevel, unsigned int& firstIndex, unsigned int& indexCount ) const
+{
+    // Each level is stored right after the previous one in indices_.
+    const unsigned int N_INDICES_PER_PLANE = 6;
+    const unsigned int firstPlane[] = { 0, 1, 5 };
+    const unsigned int nPlanes[] = { 1, 4, 16 };
+    firstIndex = firstPlane[lodLevel] * N_INDICES_PER_PLANE;
+    indexCount = nPlanes[lodLevel] * N_INDICES_PER_PLANE;
+}
+
+
 glm::vec4 LODPlane::centroid() const
 {
     glm::vec4 centroid( 0.0f );
@@ -108,6 +193,28 @@ glm::vec4 LODPlane::centroid() const
 }
 
 
+void LODPlane::bounds( glm::vec3& boxMin, glm::vec3& boxMax ) const
+{
+    boxMin = boxMax = glm::vec3( vertices_[0].x, vertices_[0].y, vertices_[0].z );
+    for( const MyVertex& vertex : vertices_ ){
+        const glm::vec3 position( vertex.x, vertex.y, vertex.z );
+        boxMin = glm::min( boxMin, position );
+        boxMax = glm::max( boxMax, position );
+    }
+}
+
+
+void LODPlane::occluderMesh( std::vector< glm::vec3 >& vertices, std::vector< uint16_t >& indices ) const
+{
+    // Level 0 is the original plane: its first 4 vertices and 6 indices.
+    vertices.clear();
+    for( unsigned int i = 0; i < 4; i++ ){
+        vertices.push_back( glm::vec3( vertices_[i].x, vertices_[i].y, vertices_[i].z ) );
+    }
+    indices.assign( indices_.begin(), indices_.begin() + 6 );
+}
+
+
 void LODPlane::subdividePlane( std::vector< MyVertex >& vertices,
                               std::vector< GLubyte>& indices,
                               unsigned int planeFirstVertexIndex )
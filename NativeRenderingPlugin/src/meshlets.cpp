@@ -0,0 +1,158 @@
+#include <meshlets.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+void BuildMeshlets( const uint16_t* indices,
+                    unsigned int indexCount,
+                    unsigned int vertexCount,
+                    std::vector< uint16_t >& meshletIndices,
+                    std::vector< Meshlet >& meshlets )
+{
+    const unsigned int triangleCount = indexCount / 3;
+
+    // Triangles of every vertex: those of vertex v are
+    // vertexTriangles[firstVertexTriangle[v], firstVertexTriangle[v + 1]).
+    std::vector< unsigned int > firstVertexTriangle( vertexCount + 1, 0 );
+    for( unsigned int i = 0; i < triangleCount * 3; i++ ){
+        firstVertexTriangle[indices[i] + 1]++;
+    }
+    for( unsigned int v = 0; v < vertexCount; v++ ){
+        firstVertexTriangle[v + 1] += firstVertexTriangle[v];
+    }
+    std::vector< unsigned int > vertexTriangles( triangleCount * 3 );
+    std::vector< unsigned int > cursors( firstVertexTriangle.begin(), firstVertexTriangle.end() - 1 );
+    for( unsigned int i = 0; i < triangleCount * 3; i++ ){
+        vertexTriangles[cursors[indices[i]]++] = i / 3;
+    }
+
+    std::vector< bool > emitted( triangleCount, false );
+    std::vector< int > vertexMeshlet( vertexCount, -1 );   // Last meshlet using each vertex.
+    std::vector< unsigned int > candidates;     // Triangles next to the current meshlet.
+    meshletIndices.clear();
+    meshletIndices.reserve( triangleCount * 3 );
+    meshlets.clear();
+
+    unsigned int seed = 0;
+    for( ;; ){
+        while( seed < triangleCount && emitted[seed] ){
+            seed++;
+        }
+        if( seed == triangleCount ){
+            break;
+        }
+
+        const int id = static_cast< int >( meshlets.size() );
+        Meshlet meshlet = { static_cast< unsigned int >( meshletIndices.size() / 3 ), 0, 0 };
+        candidates.clear();
+        for( unsigned int triangle = seed;; ){
+            emitted[triangle] = true;
+            meshlet.triangleCount++;
+            for( unsigned int k = 0; k < 3; k++ ){
+                const uint16_t v = indices[triangle * 3 + k];
+                meshletIndices.push_back( v );
+                if( vertexMeshlet[v] != id ){
+                    vertexMeshlet[v] = id;
+                    meshlet.vertexCount++;
+                    candidates.insert( candidates.end(),
+                                       vertexTriangles.begin() + firstVertexTriangle[v],
+                                       vertexTriangles.begin() + firstVertexTriangle[v + 1] );
+                }
+            }
+            if( meshlet.triangleCount == MAX_MESHLET_TRIANGLES ){
+                break;
+            }
+
+            // Next, the oldest candidate adding the fewest vertices (if it
+            // fits), dropping the ones emitted since they were found.
+            int best = -1;
+            unsigned int bestNewVertices = 4;
+            unsigned int kept = 0;
+            for( unsigned int candidate : candidates ){
+                if( emitted[candidate] ){
+                    continue;
+                }
+                candidates[kept++] = candidate;
+                unsigned int newVertices = 0;
+                for( unsigned int k = 0; k < 3; k++ ){
+                    newVertices += ( vertexMeshlet[indices[candidate * 3 + k]] != id );
+                }
+                if( newVertices < bestNewVertices && meshlet.vertexCount + newVertices <= MAX_MESHLET_VERTICES ){
+                    best = static_cast< int >( candidate );
+                    bestNewVertices = newVertices;
+                }
+            }
+            candidates.resize( kept );
+            if( best < 0 ){
+                break;
+            }
+            triangle = static_cast< unsigned int >( best );
+        }
+        meshlets.push_back( meshlet );
+    }
+}
+
+
+// Unnormalized (zero for degenerate triangles).
+static glm::vec3 TriangleNormal( const glm::vec3* positions, const uint16_t* triangle )
+{
+    const glm::vec3& a = positions[triangle[0]];
+    return glm::cross( positions[triangle[1]] - a, positions[triangle[2]] - a );
+}
+
+
+MeshletBounds ComputeMeshletBounds( const glm::vec3* positions,
+                                    const uint16_t* indices,
+                                    unsigned int triangleCount )
+{
+    MeshletBounds bounds;
+
+    // Sphere around the box of the vertices.
+    glm::vec3 boxMin = positions[indices[0]];
+    glm::vec3 boxMax = boxMin;
+    for( unsigned int i = 1; i < triangleCount * 3; i++ ){
+        boxMin = glm::min( boxMin, positions[indices[i]] );
+        boxMax = glm::max( boxMax, positions[indices[i]] );
+    }
+    bounds.center = 0.5f * ( boxMin + boxMax );
+    bounds.radius = 0.0f;
+    for( unsigned int i = 0; i < triangleCount * 3; i++ ){
+        bounds.radius = std::max( bounds.radius, glm::distance( bounds.center, positions[indices[i]] ) );
+    }
+
+    // Cone around the average normal, opening to the farthest normal
+    // (degenerate triangles have none).
+    glm::vec3 normalSum( 0.0f );
+    for( unsigned int t = 0; t < triangleCount; t++ ){
+        const glm::vec3 normal = TriangleNormal( positions, indices + t * 3 );
+        if( normal != glm::vec3( 0.0f ) ){
+            normalSum += glm::normalize( normal );
+        }
+    }
+    const float normalSumLength = glm::length( normalSum );
+    bounds.coneAxis = ( normalSumLength > 0.0f ) ? normalSum / normalSumLength : glm::vec3( 0.0f, 1.0f, 0.0f );
+    float minDot = ( normalSumLength > 0.0f ) ? 1.0f : -1.0f;
+    for( unsigned int t = 0; t < triangleCount; t++ ){
+        const glm::vec3 normal = TriangleNormal( positions, indices + t * 3 );
+        if( normal != glm::vec3( 0.0f ) ){
+            minDot = std::min( minDot, glm::dot( glm::normalize( normal ), bounds.coneAxis ) );
+        }
+    }
+
+    // Normals within angle a of the axis face away from every direction
+    // within 90 - a degrees of it: cos( 90 - a ) = sin( a ).
+    bounds.coneCutoff = ( minDot <= 0.0f ) ? 1.0f : std::sqrt( 1.0f - minDot * minDot );
+    return bounds;
+}
+
+
+bool MeshletVisible( const MeshletBounds& bounds, const glm::vec4 frustumPlanes[6], const glm::vec3& cameraPos )
+{
+    for( unsigned int i = 0; i < 6; i++ ){
+        if( glm::dot( glm::vec3( frustumPlanes[i] ), bounds.center ) + frustumPlanes[i].w < -bounds.radius ){
+            return false;
+        }
+    }
+    const glm::vec3 toCenter = bounds.center - cameraPos;
+    return glm::dot( toCenter, bounds.coneAxis ) < bounds.coneCutoff * glm::length( toCenter ) + bounds.radius;
+}
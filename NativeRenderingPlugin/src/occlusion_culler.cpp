@@ -0,0 +1,253 @@
+#include <occlusion_culler.hpp>
+#include <gl_extensions.hpp>
+#include <gl_state.hpp>
+#include <shaders.hpp>
+
+#include <algorithm>
+#include <glm/gtc/type_ptr.hpp>
+
+// Unit cube scaled and moved to the box of the object.
+static const char proxyVertexShaderCode[] =
+    "#if __VERSION__ >= 130\n"
+    "#define attribute in\n"
+    "#endif\n"
+    "attribute vec3 pos;\n"
+    "uniform mat4 mvp;\n"
+    "uniform vec3 boxMin;\n"
+    "uniform vec3 boxSize;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = mvp * vec4( boxMin + pos * boxSize, 1.0 );\n"
+    "}\n";
+
+// Color writes are off: only the samples passing the depth test matter.
+static const char proxyFragmentShaderCode[] =
+    "#ifdef GL_ES\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "#if __VERSION__ >= 130\n"
+    "out vec4 fragColor;\n"
+    "#define gl_FragColor fragColor\n"
+    "#endif\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = vec4( 1.0 );\n"
+    "}\n";
+
+static const GLfloat CUBE_VERTICES[] =
+{
+    0.0f, 0.0f, 0.0f,
+    1.0f, 0.0f, 0.0f,
+    0.0f, 1.0f, 0.0f,
+    1.0f, 1.0f, 0.0f,
+    0.0f, 0.0f, 1.0f,
+    1.0f, 0.0f, 1.0f,
+    0.0f, 1.0f, 1.0f,
+    1.0f, 1.0f, 1.0f
+};
+
+static const GLubyte CUBE_INDICES[] =
+{
+    0, 1, 3,  0, 3, 2,     // z = 0
+    4, 6, 7,  4, 7, 5,     // z = 1
+    0, 4, 5,  0, 5, 1,     // y = 0
+    2, 3, 7,  2, 7, 6,     // y = 1
+    0, 2, 6,  0, 6, 4,     // x = 0
+    1, 5, 7,  1, 7, 3      // x = 1
+};
+
+
+// Whether part of the box is behind the near plane, where the proxy would
+// be clipped away.
+static bool CrossesNearPlane( const glm::mat4& mvp, const glm::vec3& boxMin, const glm::vec3& boxMax )
+{
+    for( unsigned int i = 0; i < 8; i++ ){
+        const glm::vec4 corner( ( i & 1 ) ? boxMax.x : boxMin.x,
+                                ( i & 2 ) ? boxMax.y : boxMin.y,
+                                ( i & 4 ) ? boxMax.z : boxMin.z,
+                                1.0f );
+        const glm::vec4 clip = mvp * corner;
+        if( clip.w <= 0.0f || clip.z < -clip.w ){
+            return true;
+        }
+    }
+    return false;
+}
+
+
+OcclusionCuller::OcclusionCuller() :
+    frame_( 0 ),
+    program_( 0 ),
+    mvpLocation_( -1 ),
+    boxMinLocation_( -1 ),
+    boxSizeLocation_( -1 ),
+    vertexBuffer_( 0 ),
+    indexBuffer_( 0 )
+{}
+
+
+void OcclusionCuller::release()
+{
+    for( const ObjectState& object : objects_ ){
+        glext.deleteQueries( 1, &object.query );
+    }
+    objects_.clear();
+    if( program_ != 0 ){
+        glDeleteProgram( program_ );
+        program_ = 0;
+    }
+    if( vertexBuffer_ != 0 ){
+        glDeleteBuffers( 1, &vertexBuffer_ );
+        glDeleteBuffers( 1, &indexBuffer_ );
+        vertexBuffer_ = 0;
+        indexBuffer_ = 0;
+        glState.invalidate();
+    }
+}
+
+
+void OcclusionCuller::beginFrame( unsigned int objectCount )
+{
+    frame_++;
+
+    if( objectCount != objects_.size() ){
+        while( objects_.size() > objectCount ){
+            glext.deleteQueries( 1, &objects_.back().query );
+            objects_.pop_back();
+        }
+        while( objects_.size() < objectCount ){
+            ObjectState object;
+            glext.genQueries( 1, &object.query );
+            objects_.push_back( object );
+        }
+
+        // Different objects: forget everything (pending results included).
+        for( ObjectState& object : objects_ ){
+            object.pending = false;
+            object.visible = true;
+            object.history = 0;
+            object.nextQueryFrame = frame_;
+        }
+        return;
+    }
+
+    for( unsigned int i = 0; i < objects_.size(); i++ ){
+        ObjectState& object = objects_[i];
+        if( !object.pending ){
+            continue;
+        }
+        GLuint available = GL_FALSE;
+        glext.getQueryObjectuiv( object.query, GL_QUERY_RESULT_AVAILABLE, &available );
+        if( available ){
+            GLuint samplesPassed = 0;
+            glext.getQueryObjectuiv( object.query, GL_QUERY_RESULT, &samplesPassed );
+            object.pending = false;
+            setResult( i, samplesPassed != 0 );
+        }
+    }
+}
+
+
+bool OcclusionCuller::visible( unsigned int object ) const
+{
+    return ( object >= objects_.size() ) || objects_[object].visible;
+}
+
+
+void OcclusionCuller::issueQueries( const glm::mat4* modelMatrices,
+                                    const glm::mat4& viewProjectionMatrix,
+                                    const glm::vec3& boxMin,
+                                    const glm::vec3& boxMax )
+{
+    if( program_ == 0 ){
+        initProxy();
+        if( program_ == 0 ){
+            return;
+        }
+    }
+
+    bool stateSet = false;
+    for( unsigned int i = 0; i < objects_.size(); i++ ){
+        ObjectState& object = objects_[i];
+        if( object.pending || frame_ < object.nextQueryFrame ){
+            continue;
+        }
+
+        const glm::mat4 mvp = viewProjectionMatrix * modelMatrices[i];
+        if( CrossesNearPlane( mvp, boxMin, boxMax ) ){
+            // The camera may be inside the box: the object can't be occluded.
+            setResult( i, true );
+            continue;
+        }
+
+        if( !stateSet ){
+            glState.useProgram( program_ );
+            glUniform3f( boxMinLocation_, boxMin.x, boxMin.y, boxMin.z );
+            glUniform3f( boxSizeLocation_, boxMax.x - boxMin.x, boxMax.y - boxMin.y, boxMax.z - boxMin.z );
+            glState.setEnabled( GL_BLEND, false );
+            glState.setEnabled( GL_CULL_FACE, false );
+            glState.setEnabled( GL_DEPTH_TEST, true );
+            glState.depthFunc( GL_LEQUAL );
+            glState.depthMask( GL_FALSE );
+            glColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
+            glState.bindBuffer( GL_ARRAY_BUFFER, vertexBuffer_ );
+            glState.bindBuffer( GL_ELEMENT_ARRAY_BUFFER, indexBuffer_ );
+            glState.setVertexAttribArrayEnabled( 0, true );
+            glState.vertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 0, 0 );
+            stateSet = true;
+        }
+
+        glUniformMatrix4fv( mvpLocation_, 1, GL_FALSE, glm::value_ptr( mvp ) );
+        glext.beginQuery( glext.occlusionQueryTarget, object.query );
+        glDrawElements( GL_TRIANGLES, sizeof( CUBE_INDICES ), GL_UNSIGNED_BYTE, 0 );
+        glext.endQuery( glext.occlusionQueryTarget );
+        object.pending = true;
+    }
+
+    if( stateSet ){
+        glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
+        glState.bindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+    }
+}
+
+
+void OcclusionCuller::initProxy()
+{
+    program_ = BuildUtilityProgram( proxyVertexShaderCode, proxyFragmentShaderCode );
+    if( program_ == 0 ){
+        LOG(ERROR) << "OcclusionCuller - proxy program not built, occlusion culling disabled" << std::endl;
+        return;
+    }
+    mvpLocation_ = glGetUniformLocation( program_, "mvp" );
+    boxMinLocation_ = glGetUniformLocation( program_, "boxMin" );
+    boxSizeLocation_ = glGetUniformLocation( program_, "boxSize" );
+
+    glGenBuffers( 1, &vertexBuffer_ );
+    glGenBuffers( 1, &indexBuffer_ );
+    glState.bindBuffer( GL_ARRAY_BUFFER, vertexBuffer_ );
+    glBufferData( GL_ARRAY_BUFFER, sizeof( CUBE_VERTICES ), CUBE_VERTICES, GL_STATIC_DRAW );
+    glState.bindBuffer( GL_ARRAY_BUFFER, 0 );
+    glState.bindBuffer( GL_ELEMENT_ARRAY_BUFFER, indexBuffer_ );
+    glBufferData( GL_ELEMENT_ARRAY_BUFFER, sizeof( CUBE_INDICES ), CUBE_INDICES, GL_STATIC_DRAW );
+    glState.bindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+}
+
+
+void OcclusionCuller::setResult( unsigned int object, bool visible )
+{
+    const unsigned int minInterval = MIN_VISIBLE_INTERVAL;
+    const unsigned int maxInterval = MAX_VISIBLE_INTERVAL;
+
+    ObjectState& state = objects_[object];
+    state.history = ( visible == state.visible ) ? std::min( state.history + 1, maxInterval ) : 0;
+    state.visible = visible;
+
+    if( visible ){
+        // Objects which became visible together are spread over a few
+        // frames, so their queries don't come back all at once.
+        const unsigned int interval = std::min( minInterval + state.history, maxInterval );
+        state.nextQueryFrame = frame_ + interval + object % minInterval;
+    }else{
+        state.nextQueryFrame = frame_;
+    }
+}
@@ -0,0 +1,349 @@
+#include <procedural_texture.hpp>
+#include <gl_extensions.hpp>
+#include <gl_state.hpp>
+#include <shaders.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// --------------------------------------------------------------------------
+// Formats.
+
+int ProceduralTextureBytesPerPixel( ProceduralTextureFormat format )
+{
+    switch( format ){
+        case kProceduralTextureAlpha8:
+            return 1;
+        case kProceduralTextureRGB565:
+            return 2;
+        default:
+            return 4;
+    }
+}
+
+
+void ProceduralTextureUploadFormat( ProceduralTextureFormat format, GLenum& glFormat, GLenum& glType )
+{
+    switch( format ){
+        case kProceduralTextureAlpha8:
+            // Unity backs Alpha8 with GL_R8 where GL_ALPHA doesn't exist.
+            glFormat = glext.isES ? GL_ALPHA : GL_RED;
+            glType = GL_UNSIGNED_BYTE;
+        break;
+        case kProceduralTextureRGB565:
+            glFormat = GL_RGB;
+            glType = GL_UNSIGNED_SHORT_5_6_5;
+        break;
+        default:
+            glFormat = GL_RGBA;
+            glType = GL_UNSIGNED_BYTE;
+        break;
+    }
+}
+
+
+// Texel writers, one per ProceduralTextureFormat.
+struct StoreRGBA32 {
+    static const int SIZE = 4;
+    static void store( unsigned char* dst, unsigned char vv )
+    {
+        dst[0] = vv;
+        dst[1] = vv;
+        dst[2] = vv;
+        dst[3] = vv;
+    }
+};
+
+struct StoreAlpha8 {
+    static const int SIZE = 1;
+    static void store( unsigned char* dst, unsigned char vv )
+    {
+        dst[0] = vv;
+    }
+};
+
+struct StoreRGB565 {
+    static const int SIZE = 2;
+    static void store( unsigned char* dst, unsigned char vv )
+    {
+        const uint16_t texel = static_cast< uint16_t >( ( ( vv >> 3 ) << 11 ) | ( ( vv >> 2 ) << 5 ) | ( vv >> 3 ) );
+        memcpy( dst, &texel, sizeof( texel ) );
+    }
+};
+
+
+// --------------------------------------------------------------------------
+// CPU backend.
+
+void FillTextureFromCode( int width, int height, int stride, float time, unsigned char* dst )
+{
+	const float t = time * 4.0f;
+
+	for (int y = 0; y < height; ++y)
+	{
+		unsigned char* ptr = dst;
+		for (int x = 0; x < width; ++x)
+		{
+			// Simple oldskool "plasma effect", a bunch of combined sine waves
+			int vv = int(
+				(127.0f + (127.0f * sinf(x/7.0f+t))) +
+				(127.0f + (127.0f * sinf(y/5.0f-t))) +
+				(127.0f + (127.0f * sinf((x+y)/6.0f-t))) +
+				(127.0f + (127.0f * sinf(sqrtf(float(x*x + y*y))/4.0f-t)))
+				) / 4;
+
+			// Write the texture pixel
+			ptr[0] = vv;
+			ptr[1] = vv;
+			ptr[2] = vv;
+			ptr[3] = vv;
+
+			// To next pixel (our pixels are 4 bpp)
+			ptr += 4;
+		}
+
+		// To next image row
+		dst += stride;
+	}
+}
+
+
+PlasmaEvaluator::PlasmaEvaluator() :
+    width_( 0 ),
+    height_( 0 )
+{}
+
+
+void PlasmaEvaluator::resize( int width, int height )
+{
+    width_ = width;
+    height_ = height;
+
+    radialSin_.resize( width * height );
+    radialCos_.resize( width * height );
+    for( int y = 0; y < height; y++ ){
+        for( int x = 0; x < width; x++ ){
+            const float r = sqrtf( float( x * x + y * y ) ) / 4.0f;
+            radialSin_[y * width + x] = 127.0f * sinf( r );
+            radialCos_[y * width + x] = 127.0f * cosf( r );
+        }
+    }
+
+    xTerm_.resize( width );
+    yTerm_.resize( height );
+    diagonalTerm_.resize( width + height - 1 );
+}
+
+
+void PlasmaEvaluator::fill( int width, int height, int stride, float time, unsigned char* dst,
+                            ProceduralTextureFormat format )
+{
+    fillSlice( width, height, 0, height, stride, time, dst, format );
+}
+
+
+void PlasmaEvaluator::fillSlice( int width, int height, int firstRow, int rowCount, int stride, float time,
+                                 unsigned char* dst, ProceduralTextureFormat format )
+{
+    if( width != width_ || height != height_ ){
+        resize( width, height );
+    }
+
+    const float t = time * 4.0f;
+    const float cosT = cosf( t );
+    const float sinT = sinf( t );
+
+    // 1D terms, only over the range the slice needs. The 4 * 127 offset
+    // goes with the y one.
+    for( int x = 0; x < width; x++ ){
+        xTerm_[x] = 127.0f * sinf( x / 7.0f + t );
+    }
+    for( int y = firstRow; y < firstRow + rowCount; y++ ){
+        yTerm_[y] = 4.0f * 127.0f + 127.0f * sinf( y / 5.0f - t );
+    }
+    for( int d = firstRow; d < firstRow + rowCount + width - 1; d++ ){
+        diagonalTerm_[d] = 127.0f * sinf( d / 6.0f - t );
+    }
+
+    switch( format ){
+        case kProceduralTextureAlpha8:
+            fillRows< StoreAlpha8 >( width, firstRow, rowCount, stride, dst, cosT, sinT );
+        break;
+        case kProceduralTextureRGB565:
+            fillRows< StoreRGB565 >( width, firstRow, rowCount, stride, dst, cosT, sinT );
+        break;
+        default:
+            fillRows< StoreRGBA32 >( width, firstRow, rowCount, stride, dst, cosT, sinT );
+        break;
+    }
+}
+
+
+template < class StoreTexel >
+void PlasmaEvaluator::fillRows( int width, int firstRow, int rowCount, int stride, unsigned char* dst, float cosT, float sinT )
+{
+    dst += firstRow * stride;
+    for( int y = firstRow; y < firstRow + rowCount; y++ ){
+        unsigned char* ptr = dst;
+        const float* radialSin = &radialSin_[y * width];
+        const float* radialCos = &radialCos_[y * width];
+        const float* diagonalTerm = &diagonalTerm_[y];
+        const float yTerm = yTerm_[y];
+
+        for( int x = 0; x < width; x++ ){
+            const float sum = yTerm + xTerm_[x] + diagonalTerm[x] +
+                              radialSin[x] * cosT - radialCos[x] * sinT;
+            StoreTexel::store( ptr, static_cast< unsigned char >( int( sum ) / 4 ) );
+            ptr += StoreTexel::SIZE;
+        }
+        dst += stride;
+    }
+}
+
+
+// --------------------------------------------------------------------------
+// GPU backend.
+
+static const char plasmaVertexShaderCode[] =
+    "#if __VERSION__ >= 130\n"
+    "#define attribute in\n"
+    "#endif\n"
+    "attribute vec2 pos;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = vec4( pos * 2.0 - 1.0, 0.0, 1.0 );\n"
+    "}\n";
+
+// Same formula as FillTextureFromCode(), texel (x, y) being the pixel at
+// row y of the CPU image (GL textures start at their bottom row). Needs
+// highp to match the CPU for big times.
+static const char plasmaFragmentShaderCode[] =
+    "#ifdef GL_ES\n"
+    "#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+    "precision highp float;\n"
+    "#else\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "#endif\n"
+    "#if __VERSION__ >= 130\n"
+    "out vec4 fragColor;\n"
+    "#define gl_FragColor fragColor\n"
+    "#endif\n"
+    "uniform float time;\n"
+    "void main()\n"
+    "{\n"
+    "    vec2 p = floor( gl_FragCoord.xy );\n"
+    "    float t = time * 4.0;\n"
+    "    float sum = 4.0 * 127.0 + 127.0 * ( sin( p.x / 7.0 + t ) +\n"
+    "                                        sin( p.y / 5.0 - t ) +\n"
+    "                                        sin( ( p.x + p.y ) / 6.0 - t ) +\n"
+    "                                        sin( length( p ) / 4.0 - t ) );\n"
+    "    gl_FragColor = vec4( floor( floor( sum ) / 4.0 ) / 255.0 );\n"
+    "}\n";
+
+
+GPUPlasmaGenerator::GPUPlasmaGenerator() :
+    framebuffer_( 0 ),
+    program_( 0 ),
+    timeLocation_( -1 )
+{}
+
+
+void GPUPlasmaGenerator::init()
+{
+    release();
+
+    program_ = BuildUtilityProgram( plasmaVertexShaderCode, plasmaFragmentShaderCode );
+    if( program_ == 0 ){
+        return;
+    }
+    timeLocation_ = glGetUniformLocation( program_, "time" );
+    glGenFramebuffers( 1, &framebuffer_ );
+}
+
+
+void GPUPlasmaGenerator::release()
+{
+    if( framebuffer_ != 0 ){
+        glDeleteFramebuffers( 1, &framebuffer_ );
+        framebuffer_ = 0;
+    }
+    if( program_ != 0 ){
+        glDeleteProgram( program_ );
+        program_ = 0;
+    }
+}
+
+
+bool GPUPlasmaGenerator::render( GLuint texture, int width, int height, float time )
+{
+    if( !initialized() ){
+        return false;
+    }
+
+    // Unity state we are going to change.
+    ScopedRenderTargetState savedState;
+
+    glBindFramebuffer( GL_FRAMEBUFFER, framebuffer_ );
+    glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0 );
+    const bool complete = ( glCheckFramebufferStatus( GL_FRAMEBUFFER ) == GL_FRAMEBUFFER_COMPLETE );
+    if( complete ){
+        const GLfloat quad[] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+
+        glViewport( 0, 0, width, height );
+        glUseProgram( program_ );
+        glUniform1f( timeLocation_, time );
+        glBindBuffer( GL_ARRAY_BUFFER, 0 );
+        glEnableVertexAttribArray( 0 );
+        glVertexAttribPointer( 0, 2, GL_FLOAT, GL_FALSE, 0, quad );
+        glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+    }
+
+    // Don't keep a reference to Unity's texture.
+    glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0 );
+    return complete;
+}
+
+
+// --------------------------------------------------------------------------
+// Backend comparison.
+
+int CompareProceduralTextureBackends( GPUPlasmaGenerator& generator, int width, int height, float time )
+{
+    std::vector< unsigned char > cpuPixels( width * height * 4 );
+    std::vector< unsigned char > gpuPixels( width * height * 4 );
+    FillTextureFromCode( width, height, width * 4, time, cpuPixels.data() );
+
+    GLuint texture = 0;
+    glGenTextures( 1, &texture );
+    glState.bindTexture( GL_TEXTURE_2D, texture );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+    glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr );
+    glState.bindTexture( GL_TEXTURE_2D, 0 );
+
+    int maxDifference = -1;
+    if( generator.render( texture, width, height, time ) ){
+        // Read it back through a framebuffer (GLES has no glGetTexImage).
+        GLint previousFramebuffer = 0;
+        GLuint framebuffer = 0;
+        glGetIntegerv( GL_FRAMEBUFFER_BINDING, &previousFramebuffer );
+        glGenFramebuffers( 1, &framebuffer );
+        glBindFramebuffer( GL_FRAMEBUFFER, framebuffer );
+        glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0 );
+        glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+        glReadPixels( 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, gpuPixels.data() );
+        glBindFramebuffer( GL_FRAMEBUFFER, previousFramebuffer );
+        glDeleteFramebuffers( 1, &framebuffer );
+
+        maxDifference = 0;
+        for( size_t i = 0; i < cpuPixels.size(); i++ ){
+            const int difference = abs( static_cast< int >( cpuPixels[i] ) - gpuPixels[i] );
+            maxDifference = ( difference > maxDifference ) ? difference : maxDifference;
+        }
+    }
+
+    glDeleteTextures( 1, &texture );
+    return maxDifference;
+}
@@ -0,0 +1,97 @@
+#include <render_queue.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+// --------------------------------------------------------------------------
+// Sort keys
+
+static const unsigned int PASS_BITS = 4;
+static const unsigned int DEPTH_BITS = 24;
+static const unsigned int VARIANT_BITS = 9;
+static const unsigned int TEXTURE_BITS = 16;
+static const unsigned int LOD_BITS = 2;
+
+
+uint64_t MakeSortKey( unsigned int pass,
+                      bool transparent,
+                      float depth,
+                      unsigned int shaderVariant,
+                      unsigned int texture,
+                      unsigned int lodLevel )
+{
+    const uint64_t MAX_DEPTH = ( 1u << DEPTH_BITS ) - 1;
+    depth = std::min( std::max( depth, 0.0f ), 1.0f );
+    uint64_t quantizedDepth = static_cast< uint64_t >( depth * MAX_DEPTH );
+    if( transparent ){
+        // Back to front.
+        quantizedDepth = MAX_DEPTH - quantizedDepth;
+    }
+
+    uint64_t key = pass & ( ( 1u << PASS_BITS ) - 1 );
+    key = ( key << 1 ) | ( transparent ? 1 : 0 );
+    key = ( key << DEPTH_BITS ) | quantizedDepth;
+    key = ( key << VARIANT_BITS ) | ( shaderVariant & ( ( 1u << VARIANT_BITS ) - 1 ) );
+    key = ( key << TEXTURE_BITS ) | ( texture & ( ( 1u << TEXTURE_BITS ) - 1 ) );
+    key = ( key << LOD_BITS ) | ( lodLevel & ( ( 1u << LOD_BITS ) - 1 ) );
+
+    // Unused low bits.
+    return key << ( 64 - PASS_BITS - 1 - DEPTH_BITS - VARIANT_BITS - TEXTURE_BITS - LOD_BITS );
+}
+
+
+// --------------------------------------------------------------------------
+// RenderQueue
+
+void RenderQueue::push( uint64_t key, uint32_t index )
+{
+    const RenderQueueEntry entry = { key, index };
+    entries_.push_back( entry );
+}
+
+
+void RenderQueue::sort()
+{
+    const size_t count = entries_.size();
+    if( count < 2 ){
+        return;
+    }
+    scratch_.resize( count );
+
+    // Histograms of the 8 key bytes, all in a single read of the keys.
+    const unsigned int N_BYTES = 8;
+    size_t histograms[N_BYTES][256];
+    memset( histograms, 0, sizeof( histograms ) );
+    for( const RenderQueueEntry& entry : entries_ ){
+        for( unsigned int byte = 0; byte < N_BYTES; byte++ ){
+            histograms[byte][( entry.key >> ( 8 * byte ) ) & 0xFF]++;
+        }
+    }
+
+    RenderQueueEntry* src = entries_.data();
+    RenderQueueEntry* dst = scratch_.data();
+    for( unsigned int byte = 0; byte < N_BYTES; byte++ ){
+        const unsigned int shift = 8 * byte;
+        size_t* histogram = histograms[byte];
+
+        // Nothing to sort if every key has the same byte.
+        if( histogram[( src[0].key >> shift ) & 0xFF] == count ){
+            continue;
+        }
+
+        size_t offset = 0;
+        for( unsigned int bucket = 0; bucket < 256; bucket++ ){
+            const size_t bucketSize = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketSize;
+        }
+        for( size_t i = 0; i < count; i++ ){
+            dst[histogram[( src[i].key >> shift ) & 0xFF]++] = src[i];
+        }
+        std::swap( src, dst );
+    }
+
+    if( src != entries_.data() ){
+        entries_.swap( scratch_ );
+    }
+}
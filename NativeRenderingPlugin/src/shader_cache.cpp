@@ -0,0 +1,189 @@
+#include <shader_cache.hpp>
+#include <gl_extensions.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+// Header of every cache file, followed by binaryLength bytes of binary.
+struct ShaderCacheFileHeader {
+    char magic[4];
+    uint32_t formatVersion;
+    uint64_t key;
+    uint64_t binaryHash;
+    uint32_t binaryFormat;
+    uint32_t binaryLength;
+};
+
+static const char SHADER_CACHE_MAGIC[4] = { 'R', 'P', 'S', 'B' };
+static const uint32_t SHADER_CACHE_FORMAT_VERSION = 1;
+
+// Upper bound for a sane program binary. Anything bigger is a corrupt file.
+static const uint32_t MAX_PROGRAM_BINARY_LENGTH = 16 * 1024 * 1024;
+
+
+// Renames from to to, replacing it if it exists (rename() doesn't replace
+// existing files on Windows).
+static bool RenameReplacing( const char* from, const char* to )
+{
+#if UNITY_WIN
+    return MoveFileExA( from, to, MOVEFILE_REPLACE_EXISTING ) != 0;
+#else
+    return rename( from, to ) == 0;
+#endif
+}
+
+
+uint64_t HashFNV1a( const void* data, size_t size, uint64_t hash )
+{
+    const unsigned char* bytes = static_cast< const unsigned char* >( data );
+    for( size_t i = 0; i < size; i++ ){
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+
+static uint64_t HashString( const char* str, uint64_t hash )
+{
+    // Hash the terminator too, so ("ab", "c") != ("a", "bc").
+    return str ? HashFNV1a( str, strlen( str ) + 1, hash ) : HashFNV1a( "", 1, hash );
+}
+
+
+void ShaderCache::setDirectory( const std::string& directory )
+{
+    std::lock_guard< std::mutex > lock( directoryMutex_ );
+    directory_ = directory;
+}
+
+
+uint64_t ShaderCache::programKey( const std::vector< const char* >& sources ) const
+{
+    uint64_t key = HashFNV1a( &SHADER_CACHE_FORMAT_VERSION, sizeof( SHADER_CACHE_FORMAT_VERSION ) );
+
+    for( const char* source : sources ){
+        key = HashString( source, key );
+    }
+
+    const GLenum driverStrings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    for( GLenum driverString : driverStrings ){
+        key = HashString( reinterpret_cast< const char* >( glGetString( driverString ) ), key );
+    }
+
+    return key;
+}
+
+
+GLuint ShaderCache::loadProgram( uint64_t key )
+{
+    std::string path;
+    if( !glext.programBinary || !filePath( key, path ) ){
+        return 0;
+    }
+
+    std::ifstream file( path.c_str(), std::ios::binary );
+    if( !file ){
+        return 0;
+    }
+
+    ShaderCacheFileHeader header;
+    std::vector< char > binary;
+    bool valid = file.read( reinterpret_cast< char* >( &header ), sizeof( header ) ) &&
+                 !memcmp( header.magic, SHADER_CACHE_MAGIC, sizeof( SHADER_CACHE_MAGIC ) ) &&
+                 header.formatVersion == SHADER_CACHE_FORMAT_VERSION &&
+                 header.key == key &&
+                 header.binaryLength > 0 &&
+                 header.binaryLength <= MAX_PROGRAM_BINARY_LENGTH;
+    if( valid ){
+        binary.resize( header.binaryLength );
+        valid = file.read( binary.data(), binary.size() ) &&
+                HashFNV1a( binary.data(), binary.size() ) == header.binaryHash;
+    }
+    file.close();
+
+    GLuint program = 0;
+    if( valid ){
+        program = glCreateProgram();
+        glext.programBinaryFunc( program, header.binaryFormat, binary.data(), header.binaryLength );
+
+        // The driver may reject binaries from other builds even with the same
+        // version string.
+        GLint linkStatus = GL_FALSE;
+        glGetProgramiv( program, GL_LINK_STATUS, &linkStatus );
+        if( !linkStatus ){
+            glDeleteProgram( program );
+            program = 0;
+            valid = false;
+        }
+    }
+
+    if( !valid ){
+        LOG(INFO) << "Discarding invalid shader cache entry " << path << std::endl;
+        remove( path.c_str() );
+    }
+
+    return program;
+}
+
+
+void ShaderCache::storeProgram( uint64_t key, GLuint program )
+{
+    std::string path;
+    if( !glext.programBinary || !filePath( key, path ) ){
+        return;
+    }
+
+    GLint binaryLength = 0;
+    glGetProgramiv( program, GL_PROGRAM_BINARY_LENGTH, &binaryLength );
+    if( binaryLength <= 0 || binaryLength > static_cast< GLint >( MAX_PROGRAM_BINARY_LENGTH ) ){
+        return;
+    }
+
+    std::vector< char > binary( binaryLength );
+    GLenum binaryFormat = 0;
+    GLsizei writtenLength = 0;
+    glext.getProgramBinary( program, binaryLength, &writtenLength, &binaryFormat, binary.data() );
+    if( writtenLength <= 0 ){
+        return;
+    }
+    binary.resize( writtenLength );
+
+    ShaderCacheFileHeader header;
+    memcpy( header.magic, SHADER_CACHE_MAGIC, sizeof( SHADER_CACHE_MAGIC ) );
+    header.formatVersion = SHADER_CACHE_FORMAT_VERSION;
+    header.key = key;
+    header.binaryHash = HashFNV1a( binary.data(), binary.size() );
+    header.binaryFormat = binaryFormat;
+    header.binaryLength = static_cast< uint32_t >( binary.size() );
+
+    // Write to a temporary file and rename it, so a crash never leaves a
+    // truncated entry behind.
+    const std::string tmpPath = path + ".tmp";
+    std::ofstream file( tmpPath.c_str(), std::ios::binary | std::ios::trunc );
+    file.write( reinterpret_cast< const char* >( &header ), sizeof( header ) );
+    file.write( binary.data(), binary.size() );
+    file.close();
+
+    if( !file || !RenameReplacing( tmpPath.c_str(), path.c_str() ) ){
+        LOG(ERROR) << "Couldn't write shader cache entry " << path << std::endl;
+        remove( tmpPath.c_str() );
+    }
+}
+
+
+bool ShaderCache::filePath( uint64_t key, std::string& path )
+{
+    std::lock_guard< std::mutex > lock( directoryMutex_ );
+    if( directory_.empty() ){
+        return false;
+    }
+
+    std::ostringstream stream;
+    stream << directory_ << "/shader-" << std::hex << std::setw( 16 ) << std::setfill( '0' ) << key << ".bin";
+    path = stream.str();
+    return true;
+}
@@ -1,16 +1,298 @@
 #include <shaders.hpp>
+#include <gl_extensions.hpp>
+#include <gl_state.hpp>
+#include <shader_cache.hpp>
+#include <uniform_buffers.hpp>
+
+#include <chrono>
+#include <cstring>
+
+// --------------------------------------------------------------------------
+// Shader variants.
+// A variant is the plugin shader source compiled with the #defines of a set
+// of ShaderFeature flags. Variants are built on demand (or ahead of time via
+// PrecompileShaderVariants) and cached both in memory and on disk.
+
+static const unsigned int N_SHADER_VARIANTS = 1 << N_SHADER_FEATURES;
+
+struct ShaderVariant {
+    enum State {
+        NOT_BUILT,
+        BUILDING,   // Compiling / linking, maybe in a driver thread.
+        READY,
+        FAILED
+    };
+
+    State state;
+    GLuint program;
+    GLuint vertexShader;
+    GLuint fragmentShader;
+    uint64_t cacheKey;
+    std::chrono::steady_clock::time_point buildStartTime;
+
+    GLint mvpMatrixLocation;
+    GLint modelViewMatrixLocation;
+    GLint textureRegionLocation;
+    GLint samplerLocation;
+    GLint morphFactorLocation;
+    GLint fogColorLocation;
+    GLint fogRangeLocation;
+
+    ShaderVariant() :
+        state( NOT_BUILT ),
+        program( 0 ),
+        vertexShader( 0 ),
+        fragmentShader( 0 ),
+        cacheKey( 0 )
+    {}
+};
+
+static ShaderVariant	g_Variants[N_SHADER_VARIANTS];
+static ShaderVariant*	g_CurrentVariant = nullptr;
+static bool				g_ShadersInitialized = false;
+
+static ShaderCache g_ShaderCache;
+
+static const char* const featureDefines[N_SHADER_FEATURES] =
+{
+    "#define TEXTURE\n",
+    "#define VERTEX_COLOR\n",
+    "#define PREMULTIPLY\n",
+    "#define GEOMORPH\n",
+    "#define INSTANCING\n",
+    "#define FOG\n",
+    "#define PACKED_TEXTURE\n",
+    "#define STEREO\n",
+    "#define MULTIVIEW\n"
+};
+
+// Sources are written in GLSL ES 1.00 and get a "#version 300 es" / 140
+// directive when the context supports uniform buffers (see VariantPrefix()).
+// In that case, per-frame and per-object matrices come from uniform blocks.
+// Stereo variants need uniform buffers.
+static const char vertexShaderCode[] =
+    "#ifdef MULTIVIEW\n"
+    "#extension GL_OVR_multiview : require\n"
+    "layout(num_views = 2) in;\n"
+    "#endif\n"
+    "#if __VERSION__ >= 130\n"
+    "#define attribute in\n"
+    "#define varying out\n"
+    "#endif\n"
+    "attribute vec3 pos;\n"
+    "#ifdef VERTEX_COLOR\n"
+    "attribute vec4 color;\n"
+    "varying vec4 ocolor;\n"
+    "#endif\n"
+    "#ifdef TEXTURE\n"
+    "attribute vec2 uv;\n"
+    "#if defined(PACKED_TEXTURE) && defined(TEXTURE_ARRAYS)\n"
+    "varying vec3 ouv;\n"
+    "#else\n"
+    "varying vec2 ouv;\n"
+    "#endif\n"
+    "#endif\n"
+    "#ifdef GEOMORPH\n"
+    "attribute vec3 morphPos;\n"
+    "uniform float morphFactor;\n"
+    "#endif\n"
+    "#ifdef INSTANCING\n"
+    "attribute mat4 instanceModelMatrix;\n"
+    "#endif\n"
+    "#ifdef FOG\n"
+    "uniform vec2 fogRange;\n"
+    "varying float fogFactor;\n"
+    "#endif\n"
+    "\n"
+    "#ifdef UNIFORM_BUFFERS\n"
+    "layout(std140) uniform FrameBlock\n"
+    "{\n"
+    "    mat4 viewMatrix;\n"
+    "    mat4 projMatrix;\n"
+    "    mat4 viewProjMatrix;\n"
+    "    vec4 time;\n"
+    "};\n"
+    "layout(std140) uniform ObjectBlock\n"
+    "{\n"
+    "    mat4 mvpMatrix;\n"
+    "    mat4 modelViewMatrix;\n"
+    "    vec4 textureRegion;\n"
+    "    vec4 textureLayer;\n"
+    "    mat4 modelMatrix;\n"
+    "};\n"
+    "#else\n"
+    "uniform mat4 mvpMatrix;\n"
+    "uniform mat4 modelViewMatrix;\n"
+    "uniform vec4 textureRegion;\n"
+    "#endif\n"
+    "#if defined(STEREO) || defined(MULTIVIEW)\n"
+    "layout(std140) uniform StereoBlock\n"
+    "{\n"
+    "    mat4 eyeViewProjMatrix[2];\n"
+    "    vec4 stereoParams;\n"
+    "};\n"
+    "#endif\n"
+    "#ifdef STEREO\n"
+    "flat out int eye;\n"
+    "#endif\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "#ifdef GEOMORPH\n"
+    "    vec4 position = vec4( mix( pos, morphPos, morphFactor ), 1.0 );\n"
+    "#else\n"
+    "    vec4 position = vec4( pos, 1.0 );\n"
+    "#endif\n"
+    "#ifdef INSTANCING\n"
+    "    position = instanceModelMatrix * position;\n"
+    "#endif\n"
+    "#if defined(MULTIVIEW)\n"
+    "    gl_Position = eyeViewProjMatrix[int( gl_ViewID_OVR )] * ( modelMatrix * position );\n"
+    "#elif defined(STEREO)\n"
+    "    eye = gl_InstanceID;\n"
+    "    gl_Position = eyeViewProjMatrix[eye] * ( modelMatrix * position );\n"
+    "    gl_Position.x = gl_Position.x * 0.5 + ( float( eye ) - 0.5 ) * gl_Position.w;\n"
+    "#else\n"
+    "    gl_Position = mvpMatrix * position;\n"
+    "#endif\n"
+    "#ifdef VERTEX_COLOR\n"
+    "    ocolor = color;\n"
+    "#endif\n"
+    "#ifdef TEXTURE\n"
+    "#if defined(PACKED_TEXTURE) && defined(TEXTURE_ARRAYS)\n"
+    "    ouv = vec3( uv, textureLayer.x );\n"
+    "#elif defined(PACKED_TEXTURE)\n"
+    "    ouv = uv * textureRegion.xy + textureRegion.zw;\n"
+    "#else\n"
+    "    ouv = uv;\n"
+    "#endif\n"
+    "#endif\n"
+    "#ifdef FOG\n"
+    "    vec4 viewPosition = modelViewMatrix * position;\n"
+    "    fogFactor = clamp( ( fogRange.y - length( viewPosition.xyz ) ) / ( fogRange.y - fogRange.x ), 0.0, 1.0 );\n"
+    "#endif\n"
+    "}\n";
+
+static const char fragmetShaderCode[] =
+    "#ifdef GL_ES\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "#if __VERSION__ >= 130\n"
+    "#define varying in\n"
+    "#define texture2D texture\n"
+    "out vec4 fragColor;\n"
+    "#define gl_FragColor fragColor\n"
+    "#endif\n"
+    "#ifdef VERTEX_COLOR\n"
+    "varying vec4 ocolor;\n"
+    "#endif\n"
+    "#ifdef TEXTURE\n"
+    "#if defined(PACKED_TEXTURE) && defined(TEXTURE_ARRAYS)\n"
+    "varying vec3 ouv;\n"
+    "uniform mediump sampler2DArray textureSampler;\n"
+    "#else\n"
+    "varying vec2 ouv;\n"
+    "uniform sampler2D textureSampler;\n"
+    "#endif\n"
+    "#endif\n"
+    "#ifdef FOG\n"
+    "uniform vec4 fogColor;\n"
+    "varying float fogFactor;\n"
+    "#endif\n"
+    "#ifdef STEREO\n"
+    "// Same precision as in the vertex shader, as the block is shared.\n"
+    "layout(std140) uniform StereoBlock\n"
+    "{\n"
+    "    highp mat4 eyeViewProjMatrix[2];\n"
+    "    highp vec4 stereoParams;\n"
+    "};\n"
+    "flat in int eye;\n"
+    "#endif\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "#ifdef STEREO\n"
+    "    // Clip each eye to its half of the viewport.\n"
+    "    if( ( gl_FragCoord.x < stereoParams.x ) != ( eye == 0 ) ){\n"
+    "        discard;\n"
+    "    }\n"
+    "#endif\n"
+    "    vec4 color = vec4( 1.0 );\n"
+    "#ifdef TEXTURE\n"
+    "    color = texture2D( textureSampler, ouv );\n"
+    "#endif\n"
+    "#ifdef VERTEX_COLOR\n"
+    "    color *= ocolor;\n"
+    "#endif\n"
+    "#ifdef FOG\n"
+    "    color.rgb = mix( fogColor.rgb, color.rgb, fogFactor );\n"
+    "#endif\n"
+    "#ifdef PREMULTIPLY\n"
+    "    color.rgb *= color.a;\n"
+    "#endif\n"
+    "    gl_FragColor = color;\n"
+    "}\n";
+
+
+// --------------------------------------------------------------------------
+// Matrices.
+// With uniform buffers, per-frame matrices go to a FrameBlock buffer and the
+// matrices of all the objects of a batch to a ring of ObjectBlock, each with
+// a single buffer write. Without them (GLES2), the full MVP matrix is
+// computed on the CPU and sent as a plain uniform per draw.
+
+static const GLsizeiptr OBJECT_UNIFORMS_RING_SIZE = 64 * 1024;
+
+static GLuint		g_FrameUniformsBuffer = 0;
+static GLuint		g_StereoUniformsBuffer = 0;
+static UniformRing	g_ObjectUniformsRing;
+static GLintptr		g_ObjectUniformsOffset = 0;
+static GLsizeiptr	g_ObjectUniformsStride = sizeof( ObjectUniforms );
+static std::vector< unsigned char >		g_ObjectUniformsStaging;
+static std::vector< ObjectUniforms >	g_CpuObjectUniforms;
+
+
+static void InitUniformBuffers()
+{
+    if( !glext.uniformBuffers ){
+        return;
+    }
+
+    glGenBuffers( 1, &g_FrameUniformsBuffer );
+    glBindBuffer( GL_UNIFORM_BUFFER, g_FrameUniformsBuffer );
+    glBufferData( GL_UNIFORM_BUFFER, sizeof( FrameUniforms ), nullptr, GL_STREAM_DRAW );
+    glGenBuffers( 1, &g_StereoUniformsBuffer );
+    glBindBuffer( GL_UNIFORM_BUFFER, g_StereoUniformsBuffer );
+    glBufferData( GL_UNIFORM_BUFFER, sizeof( StereoUniforms ), nullptr, GL_STREAM_DRAW );
+    glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+
+    // Each object block must start at a multiple of this.
+    GLint alignment = 0;
+    glGetIntegerv( GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment );
+    alignment = ( alignment > 0 ) ? alignment : 256;
+    g_ObjectUniformsStride = ( ( sizeof( ObjectUniforms ) + alignment - 1 ) / alignment ) * alignment;
+    g_ObjectUniformsRing.init( OBJECT_UNIFORMS_RING_SIZE, alignment );
+}
+
+
+static void ReleaseUniformBuffers()
+{
+    if( g_FrameUniformsBuffer != 0 ){
+        glDeleteBuffers( 1, &g_FrameUniformsBuffer );
+        g_FrameUniformsBuffer = 0;
+    }
+    if( g_StereoUniformsBuffer != 0 ){
+        glDeleteBuffers( 1, &g_StereoUniformsBuffer );
+        g_StereoUniformsBuffer = 0;
+    }
+    g_ObjectUniformsRing.release();
+}
 
-static GLuint	g_VProg;
-static GLuint	g_FShader;
-static GLuint	g_Program = 0;
-static int		g_WorldMatrixUniformIndex;
-static int		g_ProjMatrixUniformIndex;
 
 static GLuint CreateShader(GLenum type, const char* text )
 {
     checkOpenGLStatus( "CreateShader - 1" );
 
-    LOG(INFO) << "Shader: " << std::endl << std::endl << text << std::endl << std::endl;
     GLuint ret = glCreateShader(type);
 
     checkOpenGLStatus( "CreateShader - 2" );
@@ -18,108 +300,466 @@ static GLuint CreateShader(GLenum type, const char* text )
     glCompileShader(ret);
     checkOpenGLStatus( "CreateShader - 3" );
 
+    // The compile status is checked once the variant is linked, so drivers
+    // supporting parallel compilation don't block here.
+    return ret;
+}
+
+
+static bool CheckShaderStatus( GLuint shader, const std::string& source )
+{
     GLint result;
-    glGetShaderiv( ret, GL_COMPILE_STATUS, &result );
-    checkOpenGLStatus( "CreateShader - 4" );
+    glGetShaderiv( shader, GL_COMPILE_STATUS, &result );
 
-    LOG(INFO) << "Shader compiler status: " << result << std::endl;
+    // The source is only logged when it doesn't compile.
     if( !result ){
         GLchar errorLog[1024] = {0};
-        glGetShaderInfoLog(ret, 1024, NULL, errorLog);
-        LOG(INFO) << errorLog << std::endl;
+        glGetShaderInfoLog(shader, 1024, NULL, errorLog);
+        LOG(ERROR) << "Shader compilation failed: " << errorLog << std::endl
+                   << source << std::endl;
     }
-    checkOpenGLStatus( "CreateShader - 5" );
+    return result != 0;
+}
 
-    return ret;
+
+// GLSL version directive and #defines of a variant.
+static std::string VariantDefines( unsigned int features )
+{
+    std::string defines = glext.glslVersionDirective;
+    if( glext.uniformBuffers ){
+        defines += "#define UNIFORM_BUFFERS\n";
+    }
+    if( glext.textureArrays ){
+        defines += "#define TEXTURE_ARRAYS\n";
+    }
+    for( unsigned int i = 0; i < N_SHADER_FEATURES; i++ ){
+        if( features & ( 1 << i ) ){
+            defines += featureDefines[i];
+        }
+    }
+    return defines;
 }
 
 
-void InitShaders()
+// Gets uniform locations and sets the uniforms which never change.
+static void SetupVariantUniforms( ShaderVariant& variant )
 {
-    char vertexShaderCode[] =
-        "attribute vec3 pos;\
-        attribute vec4 color;\
-        attribute vec2 uv;\
-        \
-        varying vec4 ocolor;\
-        varying vec2 ouv;\
-        \
-        uniform mat4 worldMatrix;\
-        uniform mat4 projMatrix;\
-        \
-        void main()\
-        {\
-            gl_Position = (projMatrix * worldMatrix) * vec4(pos,1);\
-            ocolor = color;\
-            ouv = uv;\
-        }";
-
-    char fragmetShaderCode[] =
-        "precision mediump float;\
-        varying vec4 ocolor;\
-        varying vec2 ouv;\
-        \
-        uniform sampler2D textureSampler;\
-        \
-        void main()\
-        {\
-            gl_FragColor = texture2D( textureSampler, ouv );\
-            gl_FragColor.rgb *= gl_FragColor.a;\
-        }";
-
-    g_VProg		= CreateShader(GL_VERTEX_SHADER, vertexShaderCode);
-    g_FShader	= CreateShader(GL_FRAGMENT_SHADER, fragmetShaderCode);
-
-    checkOpenGLStatus( "UnitySetGraphicsDevice - 2" );
-
-    g_Program = glCreateProgram();
-    LOG(INFO) << "g_Program: " << g_Program << std::endl;
-
-    glBindAttribLocation(g_Program, 0, "pos");
-    glBindAttribLocation(g_Program, 1, "color");
-    glAttachShader(g_Program, g_VProg);
-    glAttachShader(g_Program, g_FShader);
-    glLinkProgram(g_Program);
-    int result;
-
-    glGetProgramiv( g_Program, GL_LINK_STATUS, &result );
-    LOG(INFO) << "Shader link status: " << result << std::endl;
-    if( !result ){
+    const GLuint program = variant.program;
+
+    variant.mvpMatrixLocation = glGetUniformLocation( program, "mvpMatrix" );
+    variant.modelViewMatrixLocation = glGetUniformLocation( program, "modelViewMatrix" );
+    variant.textureRegionLocation = glGetUniformLocation( program, "textureRegion" );
+    variant.samplerLocation = glGetUniformLocation( program, "textureSampler" );
+    variant.morphFactorLocation = glGetUniformLocation( program, "morphFactor" );
+    variant.fogColorLocation = glGetUniformLocation( program, "fogColor" );
+    variant.fogRangeLocation = glGetUniformLocation( program, "fogRange" );
+
+    // Uniform blocks are always connected to the same binding points. (This
+    // isn't guaranteed to be kept in program binaries, so always set it).
+    if( glext.uniformBuffers ){
+        const GLuint frameBlockIndex = glext.getUniformBlockIndex( program, "FrameBlock" );
+        if( frameBlockIndex != GL_INVALID_INDEX ){
+            glext.uniformBlockBinding( program, frameBlockIndex, FRAME_UNIFORMS_BINDING );
+        }
+        const GLuint objectBlockIndex = glext.getUniformBlockIndex( program, "ObjectBlock" );
+        if( objectBlockIndex != GL_INVALID_INDEX ){
+            glext.uniformBlockBinding( program, objectBlockIndex, OBJECT_UNIFORMS_BINDING );
+        }
+        const GLuint stereoBlockIndex = glext.getUniformBlockIndex( program, "StereoBlock" );
+        if( stereoBlockIndex != GL_INVALID_INDEX ){
+            glext.uniformBlockBinding( program, stereoBlockIndex, STEREO_UNIFORMS_BINDING );
+        }
+    }
+
+    // Sampler is always connected to texture unit 0.
+    if( variant.samplerLocation != -1 ){
+        glState.useProgram( program );
+        glUniform1i( variant.samplerLocation, 0 );
+    }
+}
+
+
+static void LogVariantBuilt( unsigned int features, const ShaderVariant& variant, const char* origin )
+{
+    const auto elapsedTime = std::chrono::duration_cast< std::chrono::microseconds >( std::chrono::steady_clock::now() - variant.buildStartTime );
+    LOG(INFO) << "Shader variant " << features << ": program " << variant.program
+              << " (" << origin << ", " << elapsedTime.count() / 1000.0f << " ms)" << std::endl;
+}
+
+
+// Waits for the variant compilation / linking (if it hasn't finished yet)
+// and makes it READY or FAILED.
+static void FinishVariantBuild( unsigned int features, ShaderVariant& variant )
+{
+    const std::string defines = VariantDefines( features );
+    bool ok = CheckShaderStatus( variant.vertexShader, defines + vertexShaderCode );
+    ok = CheckShaderStatus( variant.fragmentShader, defines + fragmetShaderCode ) && ok;
+
+    GLint result = GL_FALSE;
+    glGetProgramiv( variant.program, GL_LINK_STATUS, &result );
+    if( ok && !result ){
         GLchar errorLog[1024] = {0};
-        glGetProgramInfoLog(g_Program, 1024, NULL, errorLog);
-        LOG(INFO) << errorLog << std::endl;
+        glGetProgramInfoLog(variant.program, 1024, NULL, errorLog);
+        LOG(ERROR) << "Shader link failed: " << errorLog << std::endl;
+    }
+    ok = ok && result;
+
+    glDetachShader( variant.program, variant.vertexShader );
+    glDetachShader( variant.program, variant.fragmentShader );
+    glDeleteShader( variant.vertexShader );
+    glDeleteShader( variant.fragmentShader );
+    variant.vertexShader = 0;
+    variant.fragmentShader = 0;
+
+    if( !ok ){
+        glDeleteProgram( variant.program );
+        variant.program = 0;
+        variant.state = ShaderVariant::FAILED;
+        LOG(ERROR) << "Shader variant " << features << " failed" << std::endl;
+        return;
+    }
+
+    SetupVariantUniforms( variant );
+    g_ShaderCache.storeProgram( variant.cacheKey, variant.program );
+    variant.state = ShaderVariant::READY;
+    LogVariantBuilt( features, variant, "source" );
+
+    checkOpenGLStatus( "FinishVariantBuild" );
+}
+
+
+// Starts building a variant: from the program binary cache if possible,
+// from source otherwise. Without parallel compilation support, the build is
+// finished right away.
+static void StartVariantBuild( unsigned int features, ShaderVariant& variant )
+{
+    variant.buildStartTime = std::chrono::steady_clock::now();
+
+    const std::string defines = VariantDefines( features );
+    variant.cacheKey = g_ShaderCache.programKey( { defines.c_str(), vertexShaderCode, fragmetShaderCode } );
+
+    // Warm start: reuse the program linked in a previous run, if any.
+    variant.program = g_ShaderCache.loadProgram( variant.cacheKey );
+    if( variant.program != 0 ){
+        SetupVariantUniforms( variant );
+        variant.state = ShaderVariant::READY;
+        LogVariantBuilt( features, variant, "cache" );
+        return;
     }
 
-    glGetProgramiv( g_Program, GL_ATTACHED_SHADERS, &result );
-    LOG(INFO) << "Attached shaders status: " << result << std::endl;
+    // Cold start: build it from source (and cache it for the next run).
+    const std::string vertexSource = defines + vertexShaderCode;
+    const std::string fragmentSource = defines + fragmetShaderCode;
+    variant.vertexShader = CreateShader( GL_VERTEX_SHADER, vertexSource.c_str() );
+    variant.fragmentShader = CreateShader( GL_FRAGMENT_SHADER, fragmentSource.c_str() );
 
-    checkOpenGLStatus( "UnitySetGraphicsDevice - 3" );
+    variant.program = glCreateProgram();
+    glBindAttribLocation( variant.program, 0, "pos" );
+    glBindAttribLocation( variant.program, 1, "color" );
+    glBindAttribLocation( variant.program, 2, "uv" );
+    glBindAttribLocation( variant.program, 3, "morphPos" );
+    glBindAttribLocation( variant.program, 4, "instanceModelMatrix" ); // 4 to 7
+    glAttachShader( variant.program, variant.vertexShader );
+    glAttachShader( variant.program, variant.fragmentShader );
+    if( glext.programParameteri ){
+        glext.programParameteri( variant.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+    }
+    glLinkProgram( variant.program );
+    variant.state = ShaderVariant::BUILDING;
 
-    g_WorldMatrixUniformIndex	= glGetUniformLocation(g_Program, "worldMatrix");
-    g_ProjMatrixUniformIndex	= glGetUniformLocation(g_Program, "projMatrix");
-    checkOpenGLStatus( "UnitySetGraphicsDevice - 4" );
+    if( !glext.parallelShaderCompile ){
+        FinishVariantBuild( features, variant );
+    }
 }
 
 
-void SendMatricesToShader( const glm::mat4& modelMatrix,
-                           const glm::mat4& viewMatrix,
-                           const glm::mat4& projectionMatrix )
+// Advances the build of a variant without blocking. Returns true once the
+// variant is READY.
+static bool PollVariant( unsigned int features )
 {
-    const glm::mat4 modelViewMatrix = viewMatrix * modelMatrix;
-    glUniformMatrix4fv(g_WorldMatrixUniformIndex, 1, GL_FALSE, glm::value_ptr( modelViewMatrix ) );
+    ShaderVariant& variant = g_Variants[features];
 
-    // Send projection matrix to shader.
-    glUniformMatrix4fv(g_ProjMatrixUniformIndex, 1, GL_FALSE, glm::value_ptr( projectionMatrix ) );
+    if( variant.state == ShaderVariant::NOT_BUILT ){
+        StartVariantBuild( features, variant );
+    }
+
+    if( variant.state == ShaderVariant::BUILDING ){
+        GLint completed = GL_TRUE;
+        glGetProgramiv( variant.program, GL_COMPLETION_STATUS_KHR, &completed );
+        if( completed ){
+            FinishVariantBuild( features, variant );
+        }
+    }
+
+    return variant.state == ShaderVariant::READY;
 }
 
 
-bool UsePluginShader()
+// --------------------------------------------------------------------------
+// Public interface.
+
+void SetShaderCacheDirectory( const std::string& directory )
 {
-    if( g_Program != 0 ){
-        // Set shader program
-        glUseProgram(g_Program);
-        return true;
-    }else{
+    g_ShaderCache.setDirectory( directory );
+}
+
+
+void InitShaders()
+{
+    g_ShadersInitialized = true;
+
+    InitUniformBuffers();
+
+    // The default variant is needed right away, so wait for it.
+    ShaderVariant& defaultVariant = g_Variants[DEFAULT_SHADER_FEATURES];
+    if( !PollVariant( DEFAULT_SHADER_FEATURES ) && defaultVariant.state == ShaderVariant::BUILDING ){
+        FinishVariantBuild( DEFAULT_SHADER_FEATURES, defaultVariant );
+    }
+
+    // Planes without texture use this one.
+    PrecompileShaderVariants( { SHADER_FEATURE_VERTEX_COLOR } );
+
+    checkOpenGLStatus( "InitShaders" );
+}
+
+
+void ReleaseShaders()
+{
+    for( ShaderVariant& variant : g_Variants ){
+        if( variant.program != 0 ){
+            glDeleteProgram( variant.program );
+        }
+        if( variant.vertexShader != 0 ){
+            glDeleteShader( variant.vertexShader );
+            glDeleteShader( variant.fragmentShader );
+        }
+        variant = ShaderVariant();
+    }
+    g_CurrentVariant = nullptr;
+    g_ShadersInitialized = false;
+
+    ReleaseUniformBuffers();
+}
+
+
+void PrecompileShaderVariants( const std::vector< unsigned int >& variants )
+{
+    for( unsigned int features : variants ){
+        if( features >= N_SHADER_VARIANTS ){
+            LOG(ERROR) << "PrecompileShaderVariants - invalid shader features (0x" << std::hex << features << std::dec << ")" << std::endl;
+            continue;
+        }
+        PollVariant( features );
+    }
+}
+
+
+bool UseShaderVariant( unsigned int features )
+{
+    // Programs are built lazily, on the first render event, so scripts have
+    // the chance to set the shader cache directory before.
+    if( !g_ShadersInitialized ){
+        InitShaders();
+    }
+
+    if( features >= N_SHADER_VARIANTS ){
+        LOG(ERROR) << "UseShaderVariant - invalid shader features (0x" << std::hex << features << std::dec << ")" << std::endl;
         return false;
     }
+    if( !PollVariant( features ) ){
+        // Still building (or broken): draw with the default variant meanwhile.
+        features = DEFAULT_SHADER_FEATURES;
+        if( g_Variants[features].state != ShaderVariant::READY ){
+            return false;
+        }
+    }
+
+    // glState forgets the program at every event, as Unity may change it.
+    g_CurrentVariant = &g_Variants[features];
+    glState.useProgram( g_CurrentVariant->program );
+    return true;
+}
+
+
+void SendFrameUniforms( const glm::mat4& viewMatrix,
+                        const glm::mat4& projectionMatrix,
+                        float time )
+{
+    // May come before the first UseShaderVariant().
+    if( !g_ShadersInitialized ){
+        InitShaders();
+    }
+    if( !glext.uniformBuffers ){
+        return;
+    }
+
+    FrameUniforms frameUniforms;
+    frameUniforms.viewMatrix = viewMatrix;
+    frameUniforms.projMatrix = projectionMatrix;
+    frameUniforms.viewProjMatrix = projectionMatrix * viewMatrix;
+    frameUniforms.time = glm::vec4( time, 0.0f, 0.0f, 0.0f );
+
+    glBindBuffer( GL_UNIFORM_BUFFER, g_FrameUniformsBuffer );
+    glBufferData( GL_UNIFORM_BUFFER, sizeof( FrameUniforms ), &frameUniforms, GL_STREAM_DRAW );
+    glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+    glext.bindBufferBase( GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, g_FrameUniformsBuffer );
+}
+
+
+void UploadObjectUniforms( const std::vector< ObjectUniforms >& objects )
+{
+    if( !g_ShadersInitialized ){
+        InitShaders();
+    }
+    if( !glext.uniformBuffers ){
+        g_CpuObjectUniforms = objects;
+        return;
+    }
+    if( objects.empty() ){
+        return;
+    }
+
+    // Pack the blocks with the alignment required by glBindBufferRange and
+    // upload all of them at once.
+    g_ObjectUniformsStaging.resize( objects.size() * g_ObjectUniformsStride );
+    for( size_t i = 0; i < objects.size(); i++ ){
+        memcpy( &g_ObjectUniformsStaging[i * g_ObjectUniformsStride], &objects[i], sizeof( ObjectUniforms ) );
+    }
+    g_ObjectUniformsOffset = g_ObjectUniformsRing.upload( g_ObjectUniformsStaging.data(), g_ObjectUniformsStaging.size() );
+}
+
+
+void SendObjectUniforms( unsigned int objectIndex )
+{
+    if( glext.uniformBuffers ){
+        glext.bindBufferRange( GL_UNIFORM_BUFFER,
+                               OBJECT_UNIFORMS_BINDING,
+                               g_ObjectUniformsRing.buffer(),
+                               g_ObjectUniformsOffset + objectIndex * g_ObjectUniformsStride,
+                               sizeof( ObjectUniforms ) );
+        return;
+    }
+
+    if( objectIndex >= g_CpuObjectUniforms.size() ){
+        LOG(ERROR) << "SendObjectUniforms - invalid object index (" << objectIndex << ")" << std::endl;
+        return;
+    }
+    const ObjectUniforms& objectUniforms = g_CpuObjectUniforms[objectIndex];
+    glUniformMatrix4fv( g_CurrentVariant->mvpMatrixLocation, 1, GL_FALSE, glm::value_ptr( objectUniforms.mvpMatrix ) );
+
+    // Only variants with fog need it.
+    if( g_CurrentVariant->modelViewMatrixLocation != -1 ){
+        glUniformMatrix4fv( g_CurrentVariant->modelViewMatrixLocation, 1, GL_FALSE, glm::value_ptr( objectUniforms.modelViewMatrix ) );
+    }
+
+    // Only variants sampling a packed texture need it.
+    if( g_CurrentVariant->textureRegionLocation != -1 ){
+        glUniform4fv( g_CurrentVariant->textureRegionLocation, 1, glm::value_ptr( objectUniforms.textureRegion ) );
+    }
+}
+
+
+void SendStereoUniforms( const glm::mat4 eyeViewProjMatrices[2], float rightEyeX )
+{
+    if( !g_ShadersInitialized ){
+        InitShaders();
+    }
+    if( !glext.uniformBuffers ){
+        return;
+    }
+
+    StereoUniforms stereoUniforms;
+    stereoUniforms.eyeViewProjMatrix[0] = eyeViewProjMatrices[0];
+    stereoUniforms.eyeViewProjMatrix[1] = eyeViewProjMatrices[1];
+    stereoUniforms.stereoParams = glm::vec4( rightEyeX, 0.0f, 0.0f, 0.0f );
+
+    glBindBuffer( GL_UNIFORM_BUFFER, g_StereoUniformsBuffer );
+    glBufferData( GL_UNIFORM_BUFFER, sizeof( StereoUniforms ), &stereoUniforms, GL_STREAM_DRAW );
+    glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+    glext.bindBufferBase( GL_UNIFORM_BUFFER, STEREO_UNIFORMS_BINDING, g_StereoUniformsBuffer );
+}
+
+
+void SendFogToShader( const glm::vec4& fogColor, float fogStart, float fogEnd )
+{
+    if( g_CurrentVariant->fogColorLocation != -1 ){
+        glUniform4fv( g_CurrentVariant->fogColorLocation, 1, glm::value_ptr( fogColor ) );
+        glUniform2f( g_CurrentVariant->fogRangeLocation, fogStart, fogEnd );
+    }
+}
+
+
+void SendMorphFactorToShader( float morphFactor )
+{
+    if( g_CurrentVariant->morphFactorLocation != -1 ){
+        glUniform1f( g_CurrentVariant->morphFactorLocation, morphFactor );
+    }
+}
+
+
+bool UsePluginShader()
+{
+    return UseShaderVariant( DEFAULT_SHADER_FEATURES );
+}
+
+
+GLuint BuildUtilityProgram( const char* vertexCode, const char* fragmentCode )
+{
+    const std::string vertexSource = std::string( glext.glslVersionDirective ) + vertexCode;
+    const std::string fragmentSource = std::string( glext.glslVersionDirective ) + fragmentCode;
+
+    const GLuint vertexShader = CreateShader( GL_VERTEX_SHADER, vertexSource.c_str() );
+    const GLuint fragmentShader = CreateShader( GL_FRAGMENT_SHADER, fragmentSource.c_str() );
+    bool ok = CheckShaderStatus( vertexShader, vertexSource );
+    ok = CheckShaderStatus( fragmentShader, fragmentSource ) && ok;
+
+    GLuint program = glCreateProgram();
+    glAttachShader( program, vertexShader );
+    glAttachShader( program, fragmentShader );
+    glBindAttribLocation( program, 0, "pos" );
+    glLinkProgram( program );
+    glDetachShader( program, vertexShader );
+    glDetachShader( program, fragmentShader );
+    glDeleteShader( vertexShader );
+    glDeleteShader( fragmentShader );
+
+    GLint result = GL_FALSE;
+    glGetProgramiv( program, GL_LINK_STATUS, &result );
+    if( ok && !result ){
+        GLchar errorLog[1024] = {0};
+        glGetProgramInfoLog( program, 1024, NULL, errorLog );
+        LOG(ERROR) << "Shader link failed: " << errorLog << std::endl;
+    }
+    if( !ok || !result ){
+        glDeleteProgram( program );
+        return 0;
+    }
+    return program;
+}
+
+
+GLuint BuildComputeProgram( const char* computeCode )
+{
+    const std::string computeSource = std::string( glext.glslComputeVersionDirective ) + computeCode;
+    const GLuint computeShader = CreateShader( GL_COMPUTE_SHADER, computeSource.c_str() );
+    const bool ok = CheckShaderStatus( computeShader, computeSource );
+
+    GLuint program = glCreateProgram();
+    glAttachShader( program, computeShader );
+    glLinkProgram( program );
+    glDetachShader( program, computeShader );
+    glDeleteShader( computeShader );
+
+    GLint result = GL_FALSE;
+    glGetProgramiv( program, GL_LINK_STATUS, &result );
+    if( ok && !result ){
+        GLchar errorLog[1024] = {0};
+        glGetProgramInfoLog( program, 1024, NULL, errorLog );
+        LOG(ERROR) << "Shader link failed: " << errorLog << std::endl;
+    }
+    if( !ok || !result ){
+        glDeleteProgram( program );
+        return 0;
+    }
+    return program;
 }
@@ -0,0 +1,394 @@
+#include <software_occlusion.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// --------------------------------------------------------------------------
+// 4 wide float vectors: 4 consecutive pixels of a row.
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+
+typedef __m128 Float4;
+typedef __m128 Mask4;
+
+static inline Float4 Splat( float value ) { return _mm_set1_ps( value ); }
+static inline Float4 Ramp( float first ) { return _mm_setr_ps( first, first + 1.0f, first + 2.0f, first + 3.0f ); }
+static inline Float4 Load( const float* values ) { return _mm_loadu_ps( values ); }
+static inline void Store( float* values, Float4 v ) { _mm_storeu_ps( values, v ); }
+static inline Float4 MulAdd( Float4 a, Float4 b, Float4 c ) { return _mm_add_ps( _mm_mul_ps( a, b ), c ); }
+static inline Float4 Min( Float4 a, Float4 b ) { return _mm_min_ps( a, b ); }
+static inline Mask4 Inside( Float4 e0, Float4 e1, Float4 e2 )
+{
+    const __m128 zero = _mm_setzero_ps();
+    return _mm_and_ps( _mm_and_ps( _mm_cmpge_ps( e0, zero ), _mm_cmpge_ps( e1, zero ) ), _mm_cmpge_ps( e2, zero ) );
+}
+static inline Float4 Select( Mask4 mask, Float4 a, Float4 b ) { return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) ); }
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+
+typedef float32x4_t Float4;
+typedef uint32x4_t Mask4;
+
+static inline Float4 Splat( float value ) { return vdupq_n_f32( value ); }
+static inline Float4 Ramp( float first )
+{
+    const float values[4] = { first, first + 1.0f, first + 2.0f, first + 3.0f };
+    return vld1q_f32( values );
+}
+static inline Float4 Load( const float* values ) { return vld1q_f32( values ); }
+static inline void Store( float* values, Float4 v ) { vst1q_f32( values, v ); }
+static inline Float4 MulAdd( Float4 a, Float4 b, Float4 c ) { return vmlaq_f32( c, a, b ); }
+static inline Float4 Min( Float4 a, Float4 b ) { return vminq_f32( a, b ); }
+static inline Mask4 Inside( Float4 e0, Float4 e1, Float4 e2 )
+{
+    const float32x4_t zero = vdupq_n_f32( 0.0f );
+    return vandq_u32( vandq_u32( vcgeq_f32( e0, zero ), vcgeq_f32( e1, zero ) ), vcgeq_f32( e2, zero ) );
+}
+static inline Float4 Select( Mask4 mask, Float4 a, Float4 b ) { return vbslq_f32( mask, a, b ); }
+
+#else
+
+struct Float4 { float v[4]; };
+struct Mask4 { bool m[4]; };
+
+static inline Float4 Splat( float value ) { Float4 r = { { value, value, value, value } }; return r; }
+static inline Float4 Ramp( float first ) { Float4 r = { { first, first + 1.0f, first + 2.0f, first + 3.0f } }; return r; }
+static inline Float4 Load( const float* values ) { Float4 r = { { values[0], values[1], values[2], values[3] } }; return r; }
+static inline void Store( float* values, Float4 v ) { for( int i = 0; i < 4; i++ ) values[i] = v.v[i]; }
+static inline Float4 MulAdd( Float4 a, Float4 b, Float4 c ) { for( int i = 0; i < 4; i++ ) c.v[i] += a.v[i] * b.v[i]; return c; }
+static inline Float4 Min( Float4 a, Float4 b ) { for( int i = 0; i < 4; i++ ) a.v[i] = std::min( a.v[i], b.v[i] ); return a; }
+static inline Mask4 Inside( Float4 e0, Float4 e1, Float4 e2 )
+{
+    Mask4 r;
+    for( int i = 0; i < 4; i++ ) r.m[i] = e0.v[i] >= 0.0f && e1.v[i] >= 0.0f && e2.v[i] >= 0.0f;
+    return r;
+}
+static inline Float4 Select( Mask4 mask, Float4 a, Float4 b ) { for( int i = 0; i < 4; i++ ) if( !mask.m[i] ) a.v[i] = b.v[i]; return a; }
+
+#endif
+
+
+// --------------------------------------------------------------------------
+// SoftwareOcclusionCuller
+
+// Whether a clip space point is behind the near plane.
+static inline bool BehindNearPlane( const glm::vec4& clip )
+{
+    return clip.w <= 0.0f || clip.z < -clip.w;
+}
+
+
+// Window coordinates of a clip space point in front of the near plane.
+static inline glm::vec3 ToScreen( const glm::vec4& clip )
+{
+    const glm::vec3 ndc = glm::vec3( clip ) / clip.w;
+    return glm::vec3( ( ndc.x * 0.5f + 0.5f ) * SoftwareOcclusionCuller::WIDTH,
+                      ( ndc.y * 0.5f + 0.5f ) * SoftwareOcclusionCuller::HEIGHT,
+                      ndc.z * 0.5f + 0.5f );
+}
+
+
+SoftwareOcclusionCuller::SoftwareOcclusionCuller( int nWorkers ) :
+    viewProjectionMatrix_( 1.0f ),
+    depth_( WIDTH * HEIGHT, 1.0f ),
+    blockMaxDepth_( BLOCKS_X * BLOCKS_Y, 1.0f ),
+    nWorkers_( nWorkers ),
+    generation_( 0 ),
+    busyWorkers_( 0 ),
+    quit_( false ),
+    nextTile_( 0 )
+{
+    if( nWorkers_ < 0 ){
+        const int hardwareThreads = static_cast< int >( std::thread::hardware_concurrency() );
+        nWorkers_ = std::min( std::max( hardwareThreads - 1, 0 ), 3 );
+    }
+}
+
+
+SoftwareOcclusionCuller::~SoftwareOcclusionCuller()
+{
+    release();
+}
+
+
+void SoftwareOcclusionCuller::release()
+{
+    {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        quit_ = true;
+    }
+    startCondition_.notify_all();
+    for( std::thread& worker : workers_ ){
+        worker.join();
+    }
+    workers_.clear();
+    quit_ = false;
+}
+
+
+void SoftwareOcclusionCuller::beginFrame( const glm::mat4& viewProjectionMatrix )
+{
+    viewProjectionMatrix_ = viewProjectionMatrix;
+    triangles_.clear();
+    for( std::vector< uint32_t >& bin : bins_ ){
+        bin.clear();
+    }
+}
+
+
+void SoftwareOcclusionCuller::addOccluder( const glm::mat4& modelMatrix,
+                                           const glm::vec3* vertices,
+                                           const uint16_t* indices,
+                                           unsigned int triangleCount )
+{
+    const glm::mat4 mvp = viewProjectionMatrix_ * modelMatrix;
+    const glm::vec2 screenSize( static_cast< float >( WIDTH ), static_cast< float >( HEIGHT ) );
+
+    // Skip small occluders.
+    unsigned int maxIndex = 0;
+    for( unsigned int i = 0; i < 3 * triangleCount; i++ ){
+        maxIndex = std::max( maxIndex, static_cast< unsigned int >( indices[i] ) );
+    }
+    std::vector< glm::vec4 > clip( maxIndex + 1 );
+    glm::vec2 screenMin = screenSize;
+    glm::vec2 screenMax( 0.0f );
+    for( unsigned int i = 0; i <= maxIndex; i++ ){
+        clip[i] = mvp * glm::vec4( vertices[i], 1.0f );
+        if( !BehindNearPlane( clip[i] ) ){
+            const glm::vec3 screen = ToScreen( clip[i] );
+            screenMin = glm::min( screenMin, glm::vec2( screen.x, screen.y ) );
+            screenMax = glm::max( screenMax, glm::vec2( screen.x, screen.y ) );
+        }
+    }
+    screenMin = glm::max( screenMin, glm::vec2( 0.0f ) );
+    screenMax = glm::min( screenMax, screenSize );
+    if( screenMax.x <= screenMin.x || screenMax.y <= screenMin.y ||
+        ( screenMax.x - screenMin.x ) * ( screenMax.y - screenMin.y ) < MIN_OCCLUDER_AREA ){
+        return;
+    }
+
+    for( unsigned int t = 0; t < triangleCount; t++ ){
+        const glm::vec4& c0 = clip[indices[3 * t]];
+        const glm::vec4& c1 = clip[indices[3 * t + 1]];
+        const glm::vec4& c2 = clip[indices[3 * t + 2]];
+        if( BehindNearPlane( c0 ) || BehindNearPlane( c1 ) || BehindNearPlane( c2 ) ){
+            continue;
+        }
+        glm::vec3 v[3] = { ToScreen( c0 ), ToScreen( c1 ), ToScreen( c2 ) };
+
+        // Both faces occlude: make it counter clockwise.
+        float area = ( v[1].x - v[0].x ) * ( v[2].y - v[0].y ) - ( v[2].x - v[0].x ) * ( v[1].y - v[0].y );
+        if( std::fabs( area ) < 1.0e-6f ){
+            continue;
+        }
+        if( area < 0.0f ){
+            std::swap( v[1], v[2] );
+            area = -area;
+        }
+
+        ScreenTriangle triangle;
+        for( int i = 0; i < 3; i++ ){
+            const glm::vec3& a = v[i];
+            const glm::vec3& b = v[( i + 1 ) % 3];
+            triangle.edgeA[i] = a.y - b.y;
+            triangle.edgeB[i] = b.x - a.x;
+            triangle.edgeC[i] = a.x * b.y - b.x * a.y;
+        }
+        triangle.zA = ( ( v[1].z - v[0].z ) * ( v[2].y - v[0].y ) - ( v[2].z - v[0].z ) * ( v[1].y - v[0].y ) ) / area;
+        triangle.zB = ( ( v[2].z - v[0].z ) * ( v[1].x - v[0].x ) - ( v[1].z - v[0].z ) * ( v[2].x - v[0].x ) ) / area;
+        triangle.zC = v[0].z - triangle.zA * v[0].x - triangle.zB * v[0].y;
+
+        const float minX = std::min( std::min( v[0].x, v[1].x ), v[2].x );
+        const float minY = std::min( std::min( v[0].y, v[1].y ), v[2].y );
+        const float maxX = std::max( std::max( v[0].x, v[1].x ), v[2].x );
+        const float maxY = std::max( std::max( v[0].y, v[1].y ), v[2].y );
+        triangle.minX = std::max( static_cast< int >( std::floor( minX ) ), 0 );
+        triangle.minY = std::max( static_cast< int >( std::floor( minY ) ), 0 );
+        triangle.maxX = std::min( static_cast< int >( std::ceil( maxX ) ), WIDTH - 1 );
+        triangle.maxY = std::min( static_cast< int >( std::ceil( maxY ) ), HEIGHT - 1 );
+        if( triangle.maxX < triangle.minX || triangle.maxY < triangle.minY ){
+            continue;
+        }
+
+        // Bin it into every tile its bounds touch.
+        const uint32_t index = static_cast< uint32_t >( triangles_.size() );
+        triangles_.push_back( triangle );
+        for( int ty = triangle.minY / TILE_HEIGHT; ty <= triangle.maxY / TILE_HEIGHT; ty++ ){
+            for( int tx = triangle.minX / TILE_WIDTH; tx <= triangle.maxX / TILE_WIDTH; tx++ ){
+                bins_[ty * TILES_X + tx].push_back( index );
+            }
+        }
+    }
+}
+
+
+void SoftwareOcclusionCuller::rasterize()
+{
+    if( triangles_.empty() ){
+        std::fill( depth_.begin(), depth_.end(), 1.0f );
+        std::fill( blockMaxDepth_.begin(), blockMaxDepth_.end(), 1.0f );
+        return;
+    }
+
+    if( workers_.empty() && nWorkers_ > 0 ){
+        startWorkers();
+    }
+
+    nextTile_ = 0;
+    if( !workers_.empty() ){
+        {
+            std::lock_guard< std::mutex > lock( mutex_ );
+            generation_++;
+            busyWorkers_ = static_cast< unsigned int >( workers_.size() );
+        }
+        startCondition_.notify_all();
+    }
+
+    rasterizeTiles();
+
+    if( !workers_.empty() ){
+        std::unique_lock< std::mutex > lock( mutex_ );
+        doneCondition_.wait( lock, [this](){ return busyWorkers_ == 0; } );
+    }
+}
+
+
+bool SoftwareOcclusionCuller::visible( const glm::mat4& modelMatrix, const glm::vec3& boxMin, const glm::vec3& boxMax ) const
+{
+    const glm::mat4 mvp = viewProjectionMatrix_ * modelMatrix;
+
+    glm::vec3 screenMin( static_cast< float >( WIDTH ), static_cast< float >( HEIGHT ), 1.0f );
+    glm::vec3 screenMax( 0.0f, 0.0f, 0.0f );
+    for( unsigned int i = 0; i < 8; i++ ){
+        const glm::vec4 corner( ( i & 1 ) ? boxMax.x : boxMin.x,
+                                ( i & 2 ) ? boxMax.y : boxMin.y,
+                                ( i & 4 ) ? boxMax.z : boxMin.z,
+                                1.0f );
+        const glm::vec4 clip = mvp * corner;
+        if( BehindNearPlane( clip ) ){
+            return true;
+        }
+        const glm::vec3 screen = ToScreen( clip );
+        screenMin = glm::min( screenMin, screen );
+        screenMax = glm::max( screenMax, screen );
+    }
+
+    // Outside the view.
+    if( screenMax.x < 0.0f || screenMax.y < 0.0f || screenMin.x >= WIDTH || screenMin.y >= HEIGHT ||
+        screenMin.z > 1.0f ){
+        return false;
+    }
+
+    // Visible if its nearest point is in front of the farthest occluder of
+    // any block it covers.
+    const int minX = std::max( static_cast< int >( screenMin.x ), 0 ) / BLOCK_SIZE;
+    const int minY = std::max( static_cast< int >( screenMin.y ), 0 ) / BLOCK_SIZE;
+    const int maxX = std::min( static_cast< int >( screenMax.x ), WIDTH - 1 ) / BLOCK_SIZE;
+    const int maxY = std::min( static_cast< int >( screenMax.y ), HEIGHT - 1 ) / BLOCK_SIZE;
+    for( int by = minY; by <= maxY; by++ ){
+        for( int bx = minX; bx <= maxX; bx++ ){
+            if( screenMin.z <= blockMaxDepth_[by * BLOCKS_X + bx] ){
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+void SoftwareOcclusionCuller::startWorkers()
+{
+    for( int i = 0; i < nWorkers_; i++ ){
+        workers_.push_back( std::thread( &SoftwareOcclusionCuller::workerLoop, this, generation_ ) );
+    }
+}
+
+
+void SoftwareOcclusionCuller::workerLoop( unsigned int generation )
+{
+    for( ;; ){
+        {
+            std::unique_lock< std::mutex > lock( mutex_ );
+            startCondition_.wait( lock, [&](){ return quit_ || generation_ != generation; } );
+            if( quit_ ){
+                return;
+            }
+            generation = generation_;
+        }
+
+        rasterizeTiles();
+
+        {
+            std::lock_guard< std::mutex > lock( mutex_ );
+            busyWorkers_--;
+            if( busyWorkers_ == 0 ){
+                doneCondition_.notify_one();
+            }
+        }
+    }
+}
+
+
+void SoftwareOcclusionCuller::rasterizeTiles()
+{
+    for( int tile = nextTile_++; tile < N_TILES; tile = nextTile_++ ){
+        rasterizeTile( tile );
+    }
+}
+
+
+void SoftwareOcclusionCuller::rasterizeTile( int tile )
+{
+    const int tileX = ( tile % TILES_X ) * TILE_WIDTH;
+    const int tileY = ( tile / TILES_X ) * TILE_HEIGHT;
+
+    for( int y = tileY; y < tileY + TILE_HEIGHT; y++ ){
+        std::fill( &depth_[y * WIDTH + tileX], &depth_[y * WIDTH + tileX] + TILE_WIDTH, 1.0f );
+    }
+
+    for( uint32_t index : bins_[tile] ){
+        const ScreenTriangle& triangle = triangles_[index];
+
+        // Tile part of the triangle bounds, in groups of 4 pixels.
+        const int minX = std::max( triangle.minX, tileX ) & ~3;
+        const int maxX = std::min( triangle.maxX, tileX + TILE_WIDTH - 1 );
+        const int minY = std::max( triangle.minY, tileY );
+        const int maxY = std::min( triangle.maxY, tileY + TILE_HEIGHT - 1 );
+
+        const Float4 a0 = Splat( triangle.edgeA[0] );
+        const Float4 a1 = Splat( triangle.edgeA[1] );
+        const Float4 a2 = Splat( triangle.edgeA[2] );
+        const Float4 zA = Splat( triangle.zA );
+
+        for( int y = minY; y <= maxY; y++ ){
+            // Pixel centers.
+            const float cy = y + 0.5f;
+            const Float4 row0 = Splat( triangle.edgeB[0] * cy + triangle.edgeC[0] );
+            const Float4 row1 = Splat( triangle.edgeB[1] * cy + triangle.edgeC[1] );
+            const Float4 row2 = Splat( triangle.edgeB[2] * cy + triangle.edgeC[2] );
+            const Float4 rowZ = Splat( triangle.zB * cy + triangle.zC );
+
+            float* depth = &depth_[y * WIDTH];
+            for( int x = minX; x <= maxX; x += 4 ){
+                const Float4 cx = Ramp( x + 0.5f );
+                const Mask4 inside = Inside( MulAdd( a0, cx, row0 ), MulAdd( a1, cx, row1 ), MulAdd( a2, cx, row2 ) );
+                const Float4 current = Load( depth + x );
+                Store( depth + x, Select( inside, Min( current, MulAdd( zA, cx, rowZ ) ), current ) );
+            }
+        }
+    }
+
+    // Farthest depth of each block of the tile.
+    for( int by = tileY / BLOCK_SIZE; by < ( tileY + TILE_HEIGHT ) / BLOCK_SIZE; by++ ){
+        for( int bx = tileX / BLOCK_SIZE; bx < ( tileX + TILE_WIDTH ) / BLOCK_SIZE; bx++ ){
+            float maxDepth = 0.0f;
+            for( int y = by * BLOCK_SIZE; y < ( by + 1 ) * BLOCK_SIZE; y++ ){
+                const float* depth = &depth_[y * WIDTH + bx * BLOCK_SIZE];
+                maxDepth = std::max( maxDepth, *std::max_element( depth, depth + BLOCK_SIZE ) );
+            }
+            blockMaxDepth_[by * BLOCKS_X + bx] = maxDepth;
+        }
+    }
+}
@@ -0,0 +1,184 @@
+#include <stereo.hpp>
+#include <gl_extensions.hpp>
+#include <gl_state.hpp>
+#include <shaders.hpp>
+
+// Draws a layer of the multiview target over the whole viewport. Only used
+// with texture arrays, so GLSL 3 is always available.
+static const char compositeVertexShaderCode[] =
+    "in vec2 pos;\n"
+    "out vec2 uv;\n"
+    "void main()\n"
+    "{\n"
+    "    uv = pos;\n"
+    "    gl_Position = vec4( pos * 2.0 - 1.0, 0.0, 1.0 );\n"
+    "}\n";
+
+static const char compositeFragmentShaderCode[] =
+    "#ifdef GL_ES\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "in vec2 uv;\n"
+    "uniform mediump sampler2DArray layers;\n"
+    "uniform float layer;\n"
+    "out vec4 fragColor;\n"
+    "void main()\n"
+    "{\n"
+    "    fragColor = texture( layers, vec3( uv, layer ) );\n"
+    "}\n";
+
+
+StereoMode SupportedStereoMode()
+{
+    if( glext.multiview ){
+        return kStereoModeMultiview;
+    }
+    if( glext.instancedStereo ){
+        return kStereoModeInstanced;
+    }
+    return kStereoModeTwoPasses;
+}
+
+
+void StereoViewport( const GLint eyeViewport[4], int eye, GLint stereoViewport[4] )
+{
+    stereoViewport[0] = ( eye == 1 ) ? eyeViewport[0] - eyeViewport[2] : eyeViewport[0];
+    stereoViewport[1] = eyeViewport[1];
+    stereoViewport[2] = 2 * eyeViewport[2];
+    stereoViewport[3] = eyeViewport[3];
+}
+
+
+MultiviewTarget::MultiviewTarget() :
+    framebuffer_( 0 ),
+    colorTexture_( 0 ),
+    depthTexture_( 0 ),
+    compositeProgram_( 0 ),
+    layerLocation_( -1 ),
+    width_( 0 ),
+    height_( 0 ),
+    complete_( false )
+{}
+
+
+void MultiviewTarget::release()
+{
+    if( framebuffer_ != 0 ){
+        glDeleteFramebuffers( 1, &framebuffer_ );
+        framebuffer_ = 0;
+    }
+    if( colorTexture_ != 0 ){
+        glDeleteTextures( 1, &colorTexture_ );
+        colorTexture_ = 0;
+    }
+    if( depthTexture_ != 0 ){
+        glDeleteTextures( 1, &depthTexture_ );
+        depthTexture_ = 0;
+    }
+    if( compositeProgram_ != 0 ){
+        glDeleteProgram( compositeProgram_ );
+        compositeProgram_ = 0;
+    }
+    width_ = 0;
+    height_ = 0;
+    complete_ = false;
+}
+
+
+bool MultiviewTarget::resize( GLsizei width, GLsizei height )
+{
+    if( framebuffer_ == 0 ){
+        glGenFramebuffers( 1, &framebuffer_ );
+        glGenTextures( 1, &colorTexture_ );
+        glGenTextures( 1, &depthTexture_ );
+    }
+
+    glState.bindTexture( GL_TEXTURE_2D_ARRAY, colorTexture_ );
+    glext.texImage3D( GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, width, height, 2, 0,
+                      GL_RGBA, GL_UNSIGNED_BYTE, nullptr );
+    glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+    glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+
+    // Opaque planes are drawn front to back and rely on the depth test to
+    // reject the ones behind them.
+    glState.bindTexture( GL_TEXTURE_2D_ARRAY, depthTexture_ );
+    glext.texImage3D( GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, width, height, 2, 0,
+                      GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr );
+    glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+    glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+    glState.bindTexture( GL_TEXTURE_2D_ARRAY, 0 );
+
+    glBindFramebuffer( GL_FRAMEBUFFER, framebuffer_ );
+    glext.framebufferTextureMultiview( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorTexture_, 0, 0, 2 );
+    glext.framebufferTextureMultiview( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture_, 0, 0, 2 );
+    complete_ = ( glCheckFramebufferStatus( GL_FRAMEBUFFER ) == GL_FRAMEBUFFER_COMPLETE );
+    if( !complete_ ){
+        LOG(ERROR) << "MultiviewTarget - " << width << "x" << height << " framebuffer is incomplete" << std::endl;
+    }
+
+    width_ = width;
+    height_ = height;
+    return complete_;
+}
+
+
+bool MultiviewTarget::bind( GLsizei width, GLsizei height )
+{
+    if( !glext.multiview || width <= 0 || height <= 0 ){
+        return false;
+    }
+    if( width != width_ || height != height_ ){
+        resize( width, height );
+    }
+    if( !complete_ ){
+        return false;
+    }
+
+    glBindFramebuffer( GL_FRAMEBUFFER, framebuffer_ );
+    glViewport( 0, 0, width, height );
+
+    GLfloat clearColor[4];
+    glGetFloatv( GL_COLOR_CLEAR_VALUE, clearColor );
+    glClearColor( 0.0f, 0.0f, 0.0f, 0.0f );
+    glState.depthMask( GL_TRUE );
+    glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+    glClearColor( clearColor[0], clearColor[1], clearColor[2], clearColor[3] );
+    return true;
+}
+
+
+void MultiviewTarget::composite( const GLint stereoViewport[4] )
+{
+    if( compositeProgram_ == 0 ){
+        compositeProgram_ = BuildUtilityProgram( compositeVertexShaderCode, compositeFragmentShaderCode );
+        if( compositeProgram_ == 0 ){
+            return;
+        }
+        layerLocation_ = glGetUniformLocation( compositeProgram_, "layer" );
+    }
+
+    // Unity state we are going to change.
+    ScopedRenderTargetState savedState;
+
+    const GLfloat quad[] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+
+    glState.setEnabled( GL_BLEND, true );
+    glState.blendFunc( GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+    glState.useProgram( compositeProgram_ );
+    glUniform1i( glGetUniformLocation( compositeProgram_, "layers" ), 0 );
+    glState.activeTexture( GL_TEXTURE0 );
+    glState.bindTexture( GL_TEXTURE_2D_ARRAY, colorTexture_ );
+    glState.bindBuffer( GL_ARRAY_BUFFER, 0 );
+    glState.setVertexAttribArrayEnabled( 0, true );
+    glState.vertexAttribPointer( 0, 2, GL_FLOAT, GL_FALSE, 0, quad );
+
+    const GLint eyeWidth = stereoViewport[2] / 2;
+    for( int eye = 0; eye < 2; eye++ ){
+        glViewport( stereoViewport[0] + eye * eyeWidth, stereoViewport[1], eyeWidth, stereoViewport[3] );
+        glUniform1f( layerLocation_, static_cast< GLfloat >( eye ) );
+        glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+    }
+
+    // quad is gone once we return.
+    glState.setVertexAttribArrayEnabled( 0, false );
+}
@@ -0,0 +1,198 @@
+#include <terrain_mesh.hpp>
+#include <gl_state.hpp>
+#include <gpu_culler.hpp>
+
+#include <algorithm>
+#include <cstddef>
+
+TerrainMesh::TerrainMesh() :
+    indexBuffer_( 0 ),
+    drawnMeshlets_( 0 ),
+    culledMeshlets_( 0 )
+{}
+
+
+bool TerrainMesh::init( const TerrainPager& pager )
+{
+    release();
+
+    // Two triangles per quad of the tile grid.
+    const unsigned int N = pager.samplesPerSide();
+    std::vector< uint16_t > indices;
+    indices.reserve( ( N - 1 ) * ( N - 1 ) * 6 );
+    for( unsigned int z = 1; z < N; z++ ){
+        for( unsigned int x = 1; x < N; x++ ){
+            const uint16_t quad[4] = {
+                static_cast< uint16_t >( ( z - 1 ) * N + x - 1 ),
+                static_cast< uint16_t >( ( z - 1 ) * N + x ),
+                static_cast< uint16_t >( z * N + x - 1 ),
+                static_cast< uint16_t >( z * N + x )
+            };
+            const uint16_t triangles[6] = { quad[0], quad[2], quad[1], quad[1], quad[2], quad[3] };
+            indices.insert( indices.end(), triangles, triangles + 6 );
+        }
+    }
+
+    BuildMeshlets( indices.data(), static_cast< unsigned int >( indices.size() ), N * N, indices_, meshlets_ );
+
+    glGenBuffers( 1, &indexBuffer_ );
+    if( indexBuffer_ == 0 ){
+        return false;
+    }
+    glState.bindBuffer( GL_ELEMENT_ARRAY_BUFFER, indexBuffer_ );
+    glBufferData( GL_ELEMENT_ARRAY_BUFFER, indices_.size() * sizeof( uint16_t ), indices_.data(), GL_STATIC_DRAW );
+    glState.bindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+
+    vertices_.resize( N * N );
+    positions_.resize( N * N );
+    tiles_.resize( pager.slotCount() );
+    for( TileBuffer& tile : tiles_ ){
+        tile.meshletBounds.resize( meshlets_.size() );
+        glGenBuffers( 1, &tile.vertexBuffer );
+        glState.bindBuffer( GL_ARRAY_BUFFER, tile.vertexBuffer );
+        glBufferData( GL_ARRAY_BUFFER, vertices_.size() * sizeof( MyVertex ), nullptr, GL_DYNAMIC_DRAW );
+        tile.tile = -1;
+    }
+    glState.bindBuffer( GL_ARRAY_BUFFER, 0 );
+    return true;
+}
+
+
+void TerrainMesh::release()
+{
+    for( TileBuffer& tile : tiles_ ){
+        glDeleteBuffers( 1, &tile.vertexBuffer );
+    }
+    tiles_.clear();
+    if( indexBuffer_ != 0 ){
+        glDeleteBuffers( 1, &indexBuffer_ );
+        indexBuffer_ = 0;
+    }
+
+    // The deleted buffers may be the bound ones.
+    glState.invalidate();
+}
+
+
+void TerrainMesh::update( const TerrainPager& pager )
+{
+    unsigned int uploads = 0;
+    for( unsigned int slot = 0; slot < tiles_.size(); slot++ ){
+        const int tile = pager.slotTile( slot );
+        if( tile < 0 ){
+            tiles_[slot].tile = -1;
+        }else if( tile != tiles_[slot].tile && uploads < MAX_UPLOADS_PER_UPDATE ){
+            uploadTile( pager, slot );
+            uploads++;
+        }
+    }
+}
+
+
+void TerrainMesh::uploadTile( const TerrainPager& pager, unsigned int slot )
+{
+    const HeightmapHeader& header = pager.header();
+    const unsigned int N = pager.samplesPerSide();
+    const int tile = pager.slotTile( slot );
+    const float originX = ( tile % header.tilesX ) * pager.tileWorldSize();
+    const float originZ = ( tile / header.tilesX ) * pager.tileWorldSize();
+    const float* heights = pager.slotHeights( slot );
+
+    // Height shades from dark green (lowest) to light grey (heightScale).
+    const float scale = ( header.heightScale > 0.0f ) ? 1.0f / header.heightScale : 0.0f;
+    float minHeight = heights[0];
+    float maxHeight = heights[0];
+    for( unsigned int z = 0, i = 0; z < N; z++ ){
+        for( unsigned int x = 0; x < N; x++, i++ ){
+            const float height = heights[i];
+            const float t = std::min( std::max( height * scale, 0.0f ), 1.0f );
+            const unsigned int r = static_cast< unsigned int >( 40.0f + 170.0f * t );
+            const unsigned int g = static_cast< unsigned int >( 90.0f + 110.0f * t );
+            const unsigned int b = static_cast< unsigned int >( 40.0f + 150.0f * t );
+            vertices_[i] = MyVertex( originX + x * header.sampleSpacing,
+                                     height,
+                                     originZ + z * header.sampleSpacing,
+                                     0xFF000000 | ( b << 16 ) | ( g << 8 ) | r,
+                                     static_cast< float >( x ) / ( N - 1 ),
+                                     static_cast< float >( z ) / ( N - 1 ) );
+            positions_[i] = glm::vec3( vertices_[i].x, vertices_[i].y, vertices_[i].z );
+            minHeight = std::min( minHeight, height );
+            maxHeight = std::max( maxHeight, height );
+        }
+    }
+
+    TileBuffer& buffer = tiles_[slot];
+    glState.bindBuffer( GL_ARRAY_BUFFER, buffer.vertexBuffer );
+    glBufferSubData( GL_ARRAY_BUFFER, 0, vertices_.size() * sizeof( MyVertex ), vertices_.data() );
+    buffer.tile = tile;
+    buffer.boxMin = glm::vec3( originX, minHeight, originZ );
+    buffer.boxMax = glm::vec3( originX + pager.tileWorldSize(), maxHeight, originZ + pager.tileWorldSize() );
+    for( unsigned int i = 0; i < meshlets_.size(); i++ ){
+        const Meshlet& meshlet = meshlets_[i];
+        buffer.meshletBounds[i] = ComputeMeshletBounds( positions_.data(), &indices_[meshlet.firstTriangle * 3], meshlet.triangleCount );
+    }
+}
+
+
+void TerrainMesh::render( const glm::mat4& viewProjectionMatrix, const glm::vec3& cameraPos )
+{
+    drawnMeshlets_ = 0;
+    culledMeshlets_ = 0;
+    if( !initialized() ){
+        return;
+    }
+    glm::vec4 planes[6];
+    FrustumPlanes( viewProjectionMatrix, planes );
+
+    glState.bindBuffer( GL_ELEMENT_ARRAY_BUFFER, indexBuffer_ );
+    const GLsizei stride = sizeof( MyVertex );
+    for( const TileBuffer& buffer : tiles_ ){
+        if( buffer.tile < 0 ){
+            continue;
+        }
+
+        // Skip the tile when its box is behind any frustum plane: even its
+        // corner furthest along the plane normal is outside.
+        bool inside = true;
+        for( unsigned int i = 0; i < 6 && inside; i++ ){
+            const glm::vec3 corner( planes[i].x >= 0.0f ? buffer.boxMax.x : buffer.boxMin.x,
+                                    planes[i].y >= 0.0f ? buffer.boxMax.y : buffer.boxMin.y,
+                                    planes[i].z >= 0.0f ? buffer.boxMax.z : buffer.boxMin.z );
+            inside = glm::dot( glm::vec3( planes[i] ), corner ) + planes[i].w >= 0.0f;
+        }
+        if( !inside ){
+            continue;
+        }
+
+        glState.bindBuffer( GL_ARRAY_BUFFER, buffer.vertexBuffer );
+        glState.setVertexAttribArrayEnabled( 0, true );
+        glState.vertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast< const GLvoid* >( offsetof( MyVertex, x ) ) );
+        glState.setVertexAttribArrayEnabled( 1, true );
+        glState.vertexAttribPointer( 1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, reinterpret_cast< const GLvoid* >( offsetof( MyVertex, color ) ) );
+        glState.setVertexAttribArrayEnabled( 2, true );
+        glState.vertexAttribPointer( 2, 2, GL_FLOAT, GL_TRUE, stride, reinterpret_cast< const GLvoid* >( offsetof( MyVertex, uvX ) ) );
+
+        // Consecutive visible meshlets are drawn together.
+        unsigned int runStart = 0;
+        unsigned int runLength = 0;
+        for( unsigned int i = 0; i <= meshlets_.size(); i++ ){
+            const bool visible = ( i < meshlets_.size() ) && MeshletVisible( buffer.meshletBounds[i], planes, cameraPos );
+            if( visible ){
+                if( runLength == 0 ){
+                    runStart = meshlets_[i].firstTriangle;
+                }
+                runLength += meshlets_[i].triangleCount;
+                drawnMeshlets_++;
+                continue;
+            }
+            if( runLength > 0 ){
+                glDrawElements( GL_TRIANGLES, runLength * 3, GL_UNSIGNED_SHORT,
+                                reinterpret_cast< const GLvoid* >( runStart * 3 * sizeof( uint16_t ) ) );
+                runLength = 0;
+            }
+            culledMeshlets_ += ( i < meshlets_.size() );
+        }
+    }
+    glState.bindBuffer( GL_ARRAY_BUFFER, 0 );
+    glState.bindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+}
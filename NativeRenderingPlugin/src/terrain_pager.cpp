@@ -0,0 +1,459 @@
+#include <terrain_pager.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#if defined( _WIN32 )
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// --------------------------------------------------------------------------
+// MappedFile
+
+MappedFile::MappedFile() :
+    data_( nullptr ),
+    size_( 0 )
+#if defined( _WIN32 )
+    ,
+    file_( INVALID_HANDLE_VALUE ),
+    mapping_( nullptr )
+#endif
+{}
+
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+
+#if defined( _WIN32 )
+
+bool MappedFile::open( const char* path )
+{
+    close();
+
+    file_ = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                         FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr );
+    LARGE_INTEGER fileSize;
+    if( file_ == INVALID_HANDLE_VALUE || !GetFileSizeEx( file_, &fileSize ) || fileSize.QuadPart == 0 ||
+        static_cast< unsigned long long >( fileSize.QuadPart ) > static_cast< size_t >( -1 ) ){
+        close();
+        return false;
+    }
+    mapping_ = CreateFileMappingA( file_, nullptr, PAGE_READONLY, 0, 0, nullptr );
+    if( mapping_ != nullptr ){
+        data_ = static_cast< const unsigned char* >( MapViewOfFile( mapping_, FILE_MAP_READ, 0, 0, 0 ) );
+    }
+    if( data_ == nullptr ){
+        close();
+        return false;
+    }
+    size_ = static_cast< size_t >( fileSize.QuadPart );
+    return true;
+}
+
+
+void MappedFile::close()
+{
+    if( data_ != nullptr ){
+        UnmapViewOfFile( data_ );
+    }
+    if( mapping_ != nullptr ){
+        CloseHandle( mapping_ );
+    }
+    if( file_ != INVALID_HANDLE_VALUE ){
+        CloseHandle( file_ );
+    }
+    data_ = nullptr;
+    size_ = 0;
+    mapping_ = nullptr;
+    file_ = INVALID_HANDLE_VALUE;
+}
+
+
+// Windows reads ahead on its own, and drops the pages of the mapping which
+// aren't touched anymore first.
+void MappedFile::willNeed( size_t, size_t ) const {}
+void MappedFile::dontNeed( size_t, size_t ) const {}
+
+#else
+
+bool MappedFile::open( const char* path )
+{
+    close();
+
+    const int fd = ::open( path, O_RDONLY );
+    if( fd < 0 ){
+        return false;
+    }
+    struct stat status;
+    if( fstat( fd, &status ) == 0 && status.st_size > 0 &&
+        static_cast< unsigned long long >( status.st_size ) <= static_cast< size_t >( -1 ) ){
+        void* data = mmap( nullptr, static_cast< size_t >( status.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+        if( data != MAP_FAILED ){
+            data_ = static_cast< const unsigned char* >( data );
+            size_ = static_cast< size_t >( status.st_size );
+            // Tiles are read in camera order, not file order.
+            madvise( data, size_, MADV_RANDOM );
+        }
+    }
+    // The mapping keeps the file.
+    ::close( fd );
+    return data_ != nullptr;
+}
+
+
+void MappedFile::close()
+{
+    if( data_ != nullptr ){
+        munmap( const_cast< unsigned char* >( data_ ), size_ );
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+
+
+// madvise() wants page aligned ranges.
+static void AdviseRange( const unsigned char* data, size_t offset, size_t size, int advice )
+{
+    const size_t pageSize = static_cast< size_t >( sysconf( _SC_PAGESIZE ) );
+    const size_t first = offset - offset % pageSize;
+    madvise( const_cast< unsigned char* >( data ) + first, size + ( offset - first ), advice );
+}
+
+
+void MappedFile::willNeed( size_t offset, size_t size ) const
+{
+    if( data_ != nullptr ){
+        AdviseRange( data_, offset, size, MADV_WILLNEED );
+    }
+}
+
+
+void MappedFile::dontNeed( size_t offset, size_t size ) const
+{
+    // The mapping is read only: dropped pages are read from the file again
+    // if they are ever touched.
+    if( data_ != nullptr ){
+        AdviseRange( data_, offset, size, MADV_DONTNEED );
+    }
+}
+
+#endif
+
+
+// --------------------------------------------------------------------------
+// TerrainPager
+
+const float TerrainPager::PREFETCH_TIME = 1.0f;
+
+// Camera positions further apart in time than this aren't a movement (the
+// game was paused, or the camera teleported).
+static const float MAX_VELOCITY_INTERVAL = 0.5f;
+
+// Weight of the last camera movement in the velocity estimate.
+static const float VELOCITY_SMOOTHING = 0.5f;
+
+
+TerrainPager::TerrainPager( int nWorkers ) :
+    viewRadius_( 0 ),
+    updateCount_( 0 ),
+    cameraKnown_( false ),
+    lastCameraPos_( 0.0f ),
+    lastTime_( 0.0f ),
+    velocity_( 0.0f ),
+    decodingSlots_( 0 ),
+    nWorkers_( nWorkers ),
+    quit_( false )
+{
+    memset( &header_, 0, sizeof( header_ ) );
+    if( nWorkers_ < 0 ){
+        const int hardwareThreads = static_cast< int >( std::thread::hardware_concurrency() );
+        nWorkers_ = std::min( std::max( hardwareThreads - 1, 1 ), static_cast< int >( MAX_WORKERS ) );
+    }
+    nWorkers_ = std::max( nWorkers_, 1 );
+}
+
+
+TerrainPager::~TerrainPager()
+{
+    close();
+}
+
+
+bool TerrainPager::open( const char* path, unsigned int viewRadius )
+{
+    close();
+
+    if( !file_.open( path ) || file_.size() < sizeof( HeightmapHeader ) ){
+        file_.close();
+        return false;
+    }
+    HeightmapHeader header;
+    memcpy( &header, file_.data(), sizeof( header ) );
+    const unsigned long long tileSamples = ( header.tileSize + 1ULL ) * ( header.tileSize + 1ULL );
+    const unsigned long long tileCount = 1ULL * header.tilesX * header.tilesZ;
+    const unsigned long long dataSize = 2ULL * tileSamples * tileCount;
+    if( memcmp( header.magic, HEIGHTMAP_MAGIC, sizeof( header.magic ) ) != 0 ||
+        header.version != HEIGHTMAP_VERSION ||
+        header.tileSize == 0 || header.tileSize > MAX_TILE_SIZE ||
+        header.tilesX == 0 || header.tilesZ == 0 ||
+        header.tilesX > 0xFFFF || header.tilesZ > 0xFFFF ||
+        tileCount > static_cast< unsigned long long >( INT_MAX ) ||    // Tile indexes are ints.
+        !( header.sampleSpacing > 0.0f ) ||
+        dataSize > file_.size() - sizeof( HeightmapHeader ) ){
+        file_.close();
+        return false;
+    }
+    header_ = header;
+    viewRadius_ = std::min( viewRadius, static_cast< unsigned int >( MAX_VIEW_RADIUS ) );
+
+    // Room for the tiles around the camera and its predicted position.
+    const unsigned int side = 2 * viewRadius_ + 1;
+    slots_.resize( 2 * side * side );
+    for( Slot& slot : slots_ ){
+        slot.tile = -1;
+        slot.state = kSlotFree;
+        slot.lastWanted = 0;
+        slot.heights.resize( static_cast< size_t >( tileSamples ) );
+    }
+    residentTiles_.assign( slots_.size(), -1 );
+
+    startWorkers();
+    return true;
+}
+
+
+void TerrainPager::close()
+{
+    stopWorkers();
+    file_.close();
+    slots_.clear();
+    requests_.clear();
+    decodingSlots_ = 0;
+    residentTiles_.clear();
+    wantedTiles_.clear();
+    memset( &header_, 0, sizeof( header_ ) );
+    updateCount_ = 0;
+    cameraKnown_ = false;
+    velocity_ = glm::vec3( 0.0f );
+}
+
+
+int TerrainPager::tileIndex( int x, int z ) const
+{
+    if( x < 0 || z < 0 || x >= static_cast< int >( header_.tilesX ) || z >= static_cast< int >( header_.tilesZ ) ){
+        return -1;
+    }
+    return z * static_cast< int >( header_.tilesX ) + x;
+}
+
+
+void TerrainPager::update( const glm::vec3& cameraPos, float time )
+{
+    if( !isOpen() ){
+        return;
+    }
+    updateCount_++;
+
+    // Further views of the same frame see the camera at the same time.
+    if( !cameraKnown_ || time < lastTime_ || time - lastTime_ > MAX_VELOCITY_INTERVAL ){
+        velocity_ = glm::vec3( 0.0f );
+        lastCameraPos_ = cameraPos;
+        lastTime_ = time;
+        cameraKnown_ = true;
+    }else if( time > lastTime_ ){
+        const glm::vec3 movement = ( cameraPos - lastCameraPos_ ) / ( time - lastTime_ );
+        velocity_ += ( movement - velocity_ ) * VELOCITY_SMOOTHING;
+        lastCameraPos_ = cameraPos;
+        lastTime_ = time;
+    }
+
+    wantedTiles_.clear();
+    wantTilesAround( cameraPos, wantedTiles_ );
+    wantTilesAround( cameraPos + velocity_ * PREFETCH_TIME, wantedTiles_ );
+
+    {
+        std::lock_guard< std::mutex > lock( mutex_ );
+
+        // Requests no worker took yet are made again in the new order, or
+        // dropped if their tile isn't wanted anymore.
+        for( unsigned int slot : requests_ ){
+            slots_[slot].tile = -1;
+            slots_[slot].state = kSlotFree;
+        }
+        requests_.clear();
+
+        for( int tile : wantedTiles_ ){
+            bool paged = false;
+            for( Slot& slot : slots_ ){
+                if( slot.tile == tile ){
+                    slot.lastWanted = updateCount_;
+                    paged = true;
+                    break;
+                }
+            }
+            if( paged ){
+                continue;
+            }
+
+            // Farthest tiles are the last wanted: when no slot is left,
+            // they wait for a further update.
+            const int slot = takeSlot( updateCount_ );
+            if( slot < 0 ){
+                break;
+            }
+            if( slots_[slot].state == kSlotResident ){
+                file_.dontNeed( tileOffset( slots_[slot].tile ), tileBytes() );
+            }
+            slots_[slot].tile = tile;
+            slots_[slot].state = kSlotQueued;
+            slots_[slot].lastWanted = updateCount_;
+            requests_.push_back( slot );
+            file_.willNeed( tileOffset( tile ), tileBytes() );
+        }
+
+        for( unsigned int slot = 0; slot < slots_.size(); slot++ ){
+            residentTiles_[slot] = ( slots_[slot].state == kSlotResident ) ? slots_[slot].tile : -1;
+        }
+    }
+    requestCondition_.notify_all();
+}
+
+
+void TerrainPager::waitIdle()
+{
+    std::unique_lock< std::mutex > lock( mutex_ );
+    idleCondition_.wait( lock, [&](){ return requests_.empty() && decodingSlots_ == 0; } );
+}
+
+
+// Appends the tiles within viewRadius_ of position which aren't in tiles
+// yet, in rings of growing distance.
+void TerrainPager::wantTilesAround( const glm::vec3& position, std::vector< int >& tiles ) const
+{
+    const int radius = static_cast< int >( viewRadius_ );
+    const int centerX = static_cast< int >( std::floor( position.x / tileWorldSize() ) );
+    const int centerZ = static_cast< int >( std::floor( position.z / tileWorldSize() ) );
+    for( int ring = 0; ring <= radius; ring++ ){
+        for( int z = centerZ - ring; z <= centerZ + ring; z++ ){
+            for( int x = centerX - ring; x <= centerX + ring; x++ ){
+                if( std::max( std::abs( x - centerX ), std::abs( z - centerZ ) ) != ring ){
+                    continue;
+                }
+                const int tile = tileIndex( x, z );
+                if( tile >= 0 && std::find( tiles.begin(), tiles.end(), tile ) == tiles.end() ){
+                    tiles.push_back( tile );
+                }
+            }
+        }
+    }
+}
+
+
+// A free slot, or the resident one least recently wanted before the given
+// update (-1 if every slot is wanted by it or decoding). Under mutex_.
+int TerrainPager::takeSlot( unsigned int update )
+{
+    int lruSlot = -1;
+    for( unsigned int i = 0; i < slots_.size(); i++ ){
+        const Slot& slot = slots_[i];
+        if( slot.state == kSlotFree ){
+            return static_cast< int >( i );
+        }
+        if( slot.state == kSlotResident && slot.lastWanted != update &&
+            ( lruSlot < 0 || slot.lastWanted < slots_[lruSlot].lastWanted ) ){
+            lruSlot = static_cast< int >( i );
+        }
+    }
+    return lruSlot;
+}
+
+
+size_t TerrainPager::tileOffset( int tile ) const
+{
+    return sizeof( HeightmapHeader ) + static_cast< size_t >( tile ) * tileBytes();
+}
+
+
+size_t TerrainPager::tileBytes() const
+{
+    return 2 * static_cast< size_t >( samplesPerSide() ) * samplesPerSide();
+}
+
+
+// Reads the samples of a tile from the mapping, which is what makes the OS
+// read them from the file if they aren't in memory yet.
+void TerrainPager::decodeTile( int tile, std::vector< float >& heights ) const
+{
+    const unsigned char* samples = file_.data() + tileOffset( tile );
+    const float scale = header_.heightScale / 65535.0f;
+    for( size_t i = 0; i < heights.size(); i++ ){
+        const unsigned int sample = samples[2 * i] | ( samples[2 * i + 1] << 8 );
+        heights[i] = sample * scale;
+    }
+}
+
+
+void TerrainPager::startWorkers()
+{
+    for( int i = 0; i < nWorkers_; i++ ){
+        workers_.push_back( std::thread( &TerrainPager::workerLoop, this ) );
+    }
+}
+
+
+void TerrainPager::stopWorkers()
+{
+    {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        quit_ = true;
+    }
+    requestCondition_.notify_all();
+    for( std::thread& worker : workers_ ){
+        worker.join();
+    }
+    workers_.clear();
+    quit_ = false;
+}
+
+
+void TerrainPager::workerLoop()
+{
+    for( ;; ){
+        unsigned int slot = 0;
+        int tile = -1;
+        {
+            std::unique_lock< std::mutex > lock( mutex_ );
+            requestCondition_.wait( lock, [&](){ return quit_ || !requests_.empty(); } );
+            if( quit_ ){
+                return;
+            }
+            slot = requests_.front();
+            requests_.pop_front();
+            slots_[slot].state = kSlotDecoding;
+            tile = slots_[slot].tile;
+            decodingSlots_++;
+        }
+
+        // Nobody else touches a decoding slot.
+        decodeTile( tile, slots_[slot].heights );
+
+        {
+            std::lock_guard< std::mutex > lock( mutex_ );
+            slots_[slot].state = kSlotResident;
+            decodingSlots_--;
+            if( requests_.empty() && decodingSlots_ == 0 ){
+                idleCondition_.notify_all();
+            }
+        }
+    }
+}
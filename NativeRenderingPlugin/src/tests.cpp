@@ -2,12 +2,453 @@
 #include <SDL2/SDL.h>
 #include <stdexcept>
 #include <GLES2/gl2.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <gl_extensions.hpp>
+#include <gpu_culler.hpp>
+#include <meshlets.hpp>
+#include <procedural_texture.hpp>
+#include <render_queue.hpp>
+#include <software_occlusion.hpp>
+#include <terrain_pager.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <texture_scheduler.hpp>
 
 int RES_X = 400;
 int RES_Y = 300;
 
+// Plasma implementations may differ by one level where the sum of sines falls
+// right on an integer.
+const int PROCEDURAL_TEXTURE_TOLERANCE = 1;
+
+
+// Table-driven plasma against the reference one.
+bool TestPlasmaEvaluator()
+{
+    const int width = 256;
+    const int height = 128;
+    std::vector< unsigned char > reference( width * height * 4 );
+    std::vector< unsigned char > evaluated( width * height * 4 );
+    PlasmaEvaluator evaluator;
+
+    bool ok = true;
+    const float times[] = { 0.0f, 1.5f, 60.0f };
+    for( float time : times ){
+        FillTextureFromCode( width, height, width * 4, time, reference.data() );
+        evaluator.fill( width, height, width * 4, time, evaluated.data() );
+
+        int maxDifference = 0;
+        for( size_t i = 0; i < reference.size(); i++ ){
+            maxDifference = std::max( maxDifference, abs( reference[i] - evaluated[i] ) );
+        }
+        std::cout << "Plasma evaluator (t = " << time << "s): max difference " << maxDifference << std::endl;
+        ok = ok && ( maxDifference <= PROCEDURAL_TEXTURE_TOLERANCE );
+    }
+    return ok;
+}
+
+
+// An image generated in budgeted row slices over several frames must be the
+// same as one generated in a single call.
+bool TestTextureUpdateScheduler()
+{
+    const int width = 256;
+    const int height = 256;
+    std::vector< unsigned char > whole( width * height * 4 );
+    std::vector< unsigned char > sliced( width * height * 4 );
+    PlasmaEvaluator evaluator;
+    TextureUpdateScheduler scheduler;
+    scheduler.setFrameBudget( 0.0f );
+
+    int frames = 0;
+    int slices = 0;
+    bool completed = false;
+    while( !completed && frames < height ){
+        // Every frame rendered twice (stereo): the second one must be skipped.
+        for( int eye = 0; eye < 2; eye++ ){
+            completed = scheduler.update( 1.5f + frames * 0.01f, height,
+                [&]( int firstRow, int rowCount, float imageTime ){
+                    evaluator.fillSlice( width, height, firstRow, rowCount, width * 4, imageTime, sliced.data() );
+                    slices++;
+                } ) || completed;
+        }
+        frames++;
+    }
+    evaluator.fill( width, height, width * 4, 1.5f, whole.data() );
+
+    // A restart (ie. a new row layout) drops the image in progress, whatever
+    // the update rate.
+    scheduler.setTargetRate( 0.001f );
+    scheduler.update( 10.0f, height, []( int, int, float ){} );
+    scheduler.restart();
+    int restartRow = -1;
+    scheduler.update( 10.01f, height, [&]( int firstRow, int, float ){
+        restartRow = ( restartRow < 0 ) ? firstRow : restartRow;
+    } );
+
+    std::cout << "Texture update scheduler: " << frames << " frames, " << slices << " slices" << std::endl;
+    return completed && ( slices == frames ) && ( whole == sliced ) && ( restartRow == 0 );
+}
+
+
+// Pixel-diff of the GPU procedural texture backend against the CPU one.
+bool TestProceduralTextureBackends()
+{
+    GPUPlasmaGenerator generator;
+    generator.init();
+
+    bool ok = true;
+    const float times[] = { 0.0f, 1.5f, 60.0f };
+    for( float time : times ){
+        const int maxDifference = CompareProceduralTextureBackends( generator, 256, 256, time );
+        std::cout << "Procedural texture backends (t = " << time << "s): max difference " << maxDifference << std::endl;
+        ok = ok && ( maxDifference >= 0 ) && ( maxDifference <= PROCEDURAL_TEXTURE_TOLERANCE );
+    }
+
+    generator.release();
+    return ok;
+}
+
+
+// Radix sorted render queue against std::stable_sort, with 100k draws.
+bool BenchmarkRenderQueue()
+{
+    const unsigned int N_DRAWS = 100000;
+    RenderQueue queue;
+    srand( 1 );
+    for( unsigned int i = 0; i < N_DRAWS; i++ ){
+        const uint64_t key = MakeSortKey( rand() % 4,
+                                          ( rand() % 2 ) != 0,
+                                          static_cast< float >( rand() ) / RAND_MAX,
+                                          rand() % 8,
+                                          rand() % 64,
+                                          rand() % 3 );
+        queue.push( key, i );
+    }
+
+    std::vector< RenderQueueEntry > reference = queue.entries();
+    auto start = std::chrono::steady_clock::now();
+    std::stable_sort( reference.begin(), reference.end(),
+        []( const RenderQueueEntry& a, const RenderQueueEntry& b ){
+            return a.key < b.key;
+        } );
+    const double stableSortTime = std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - start ).count();
+
+    start = std::chrono::steady_clock::now();
+    queue.sort();
+    const double radixSortTime = std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - start ).count();
+
+    bool ok = true;
+    for( unsigned int i = 0; i < N_DRAWS; i++ ){
+        ok = ok && ( queue.entries()[i].key == reference[i].key ) && ( queue.entries()[i].index == reference[i].index );
+    }
+    std::cout << "Render queue (" << N_DRAWS << " draws): radix sort " << radixSortTime
+              << " ms, std::stable_sort " << stableSortTime << " ms" << std::endl;
+    return ok;
+}
+
+
+// Software occlusion culler: a wall hides what is behind it (and only that),
+// and the depth buffer is the same whatever the number of threads.
+bool TestSoftwareOcclusionCuller()
+{
+    const glm::mat4 viewProjectionMatrix =
+        glm::perspective( glm::radians( 60.0f ), 2.0f, 0.1f, 100.0f ) *
+        glm::lookAt( glm::vec3( 0.0f ), glm::vec3( 0.0f, 0.0f, -1.0f ), glm::vec3( 0.0f, 1.0f, 0.0f ) );
+    const glm::vec3 quad[] = {
+        glm::vec3( -1.0f, -1.0f, 0.0f ), glm::vec3( 1.0f, -1.0f, 0.0f ),
+        glm::vec3( 1.0f, 1.0f, 0.0f ), glm::vec3( -1.0f, 1.0f, 0.0f )
+    };
+    const uint16_t quadIndices[] = { 0, 1, 2, 0, 2, 3 };
+
+    // A 6x6 wall 5 units away, plus random occluders.
+    std::vector< glm::mat4 > occluders;
+    occluders.push_back( glm::scale( glm::translate( glm::mat4( 1.0f ), glm::vec3( 0.0f, 0.0f, -5.0f ) ), glm::vec3( 3.0f ) ) );
+    srand( 1 );
+    for( unsigned int i = 0; i < 1000; i++ ){
+        const glm::vec3 position( rand() % 40 - 20.0f, rand() % 20 - 10.0f, -20.0f - rand() % 40 );
+        const float angle = static_cast< float >( rand() ) / RAND_MAX * 3.0f;
+        occluders.push_back( glm::rotate( glm::translate( glm::mat4( 1.0f ), position ), angle, glm::vec3( 0.0f, 1.0f, 0.0f ) ) );
+    }
+
+    SoftwareOcclusionCuller singleThreaded( 0 );
+    SoftwareOcclusionCuller multithreaded( 3 );
+    double times[2] = { 0.0, 0.0 };
+    SoftwareOcclusionCuller* cullers[2] = { &singleThreaded, &multithreaded };
+    for( unsigned int i = 0; i < 2; i++ ){
+        cullers[i]->beginFrame( viewProjectionMatrix );
+        for( const glm::mat4& occluder : occluders ){
+            cullers[i]->addOccluder( occluder, quad, quadIndices, 2 );
+        }
+        cullers[i]->rasterize();     // Starts the workers.
+        const auto start = std::chrono::steady_clock::now();
+        cullers[i]->rasterize();
+        times[i] = std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - start ).count();
+    }
+    bool ok = ( singleThreaded.depthBuffer() == multithreaded.depthBuffer() );
+
+    const glm::vec3 boxMin( -0.5f );
+    const glm::vec3 boxMax( 0.5f );
+    const struct {
+        glm::vec3 position;
+        bool visible;
+    } boxes[] = {
+        { glm::vec3( 0.0f, 0.0f, -10.0f ), false },     // Behind the wall.
+        { glm::vec3( 0.0f, 0.0f, -3.0f ), true },       // In front of it.
+        { glm::vec3( 9.0f, 0.0f, -10.0f ), true },      // Beside it.
+        { glm::vec3( 0.0f, 0.0f, 0.0f ), true },        // Around the camera.
+        { glm::vec3( 80.0f, 0.0f, -10.0f ), false }     // Out of the view.
+    };
+    for( const auto& box : boxes ){
+        const glm::mat4 modelMatrix = glm::translate( glm::mat4( 1.0f ), box.position );
+        ok = ok && ( multithreaded.visible( modelMatrix, boxMin, boxMax ) == box.visible );
+    }
+
+    std::cout << "Software occlusion culler (" << occluders.size() << " occluders): " << times[0]
+              << " ms single threaded, " << times[1] << " ms with 3 workers" << std::endl;
+    return ok;
+}
+
+// GPU culling and LOD selection against the CPU: same number of instances
+// kept per level, for a grid of planes partly out of the view. Skipped
+// without compute shaders (llvmpipe has them).
+bool TestGPUCuller()
+{
+    if( !glext.computeShaders ){
+        std::cout << "GPU culler: no compute shaders, skipped" << std::endl;
+        return true;
+    }
+
+    LODPlane plane;
+    GPUCuller culler;
+    if( !culler.init( plane ) ){
+        return false;
+    }
+
+    const glm::mat4 viewProjectionMatrix =
+        glm::perspective( glm::radians( 60.0f ), 4.0f / 3.0f, 0.1f, 50.0f ) *
+        glm::lookAt( glm::vec3( 0.0f ), glm::vec3( 0.0f, 0.0f, -1.0f ), glm::vec3( 0.0f, 1.0f, 0.0f ) );
+    const glm::vec4 cameraPos( 0.0f, 0.0f, 0.0f, 1.0f );
+    std::vector< glm::mat4 > modelMatrices;
+    for( int z = 0; z < 100; z++ ){
+        for( int x = -50; x < 50; x++ ){
+            modelMatrices.push_back( glm::translate( glm::mat4( 1.0f ), glm::vec3( x * 1.3f, -1.0f, 0.7f - z * 0.6f ) ) );
+        }
+    }
+
+    // Expected: the same bounding sphere test and LODPlane::selectLOD().
+    glm::vec3 boxMin;
+    glm::vec3 boxMax;
+    plane.bounds( boxMin, boxMax );
+    const glm::vec3 center = 0.5f * ( boxMin + boxMax );
+    const float radius = 0.5f * glm::length( boxMax - boxMin );
+    glm::vec4 frustumPlanes[6];
+    FrustumPlanes( viewProjectionMatrix, frustumPlanes );
+    unsigned int expected[3] = { 0, 0, 0 };
+    for( const glm::mat4& modelMatrix : modelMatrices ){
+        const glm::vec3 worldCenter( modelMatrix * glm::vec4( center, 1.0f ) );
+        bool inside = true;
+        for( const glm::vec4& frustumPlane : frustumPlanes ){
+            inside = inside && ( glm::dot( glm::vec3( frustumPlane ), worldCenter ) + frustumPlane.w >= -radius );
+        }
+        if( inside ){
+            expected[plane.selectLOD( glm::distance( cameraPos, modelMatrix * plane.centroid() ) )]++;
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    culler.cull( modelMatrices.data(), modelMatrices.size(), viewProjectionMatrix, cameraPos );
+    const double cullTime = std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - start ).count();
+    unsigned int counts[3];
+    culler.readInstanceCounts( counts );
+    culler.release();
+
+    std::cout << "GPU culler (" << modelMatrices.size() << " instances, " << cullTime << " ms): "
+              << counts[0] << "/" << counts[1] << "/" << counts[2] << " per level, expected "
+              << expected[0] << "/" << expected[1] << "/" << expected[2] << std::endl;
+    return counts[0] == expected[0] && counts[1] == expected[1] && counts[2] == expected[2];
+}
+
+// Terrain pager: a camera flying over a heightmap written for the test has
+// the tiles around it and ahead of it resident (and decoded right), with
+// the slots allocated when the file was opened.
+bool TestTerrainPager()
+{
+    const char* path = "tests_terrain.hmap";
+    HeightmapHeader header;
+    memcpy( header.magic, HEIGHTMAP_MAGIC, sizeof( header.magic ) );
+    header.version = HEIGHTMAP_VERSION;
+    header.tileSize = 16;
+    header.tilesX = 40;
+    header.tilesZ = 40;
+    header.sampleSpacing = 1.0f;
+    header.heightScale = 10.0f;
+    header.reserved = 0;
+
+    // Samples depend on their terrain coordinates, so shared tile edges match.
+    const unsigned int N = header.tileSize + 1;
+    auto sample = [&]( unsigned int tile, unsigned int i ){
+        const unsigned int x = ( tile % header.tilesX ) * header.tileSize + i % N;
+        const unsigned int z = ( tile / header.tilesX ) * header.tileSize + i / N;
+        return static_cast< uint16_t >( x * 7 + z * 13 );
+    };
+    FILE* file = fopen( path, "wb" );
+    if( !file ){
+        return false;
+    }
+    fwrite( &header, sizeof( header ), 1, file );
+    for( unsigned int tile = 0; tile < header.tilesX * header.tilesZ; tile++ ){
+        for( unsigned int i = 0; i < N * N; i++ ){
+            const uint16_t value = sample( tile, i );
+            const unsigned char bytes[2] = { static_cast< unsigned char >( value & 0xFF ), static_cast< unsigned char >( value >> 8 ) };
+            fwrite( bytes, 1, 2, file );
+        }
+    }
+    fclose( file );
+
+    // 2 tiles per second along x, 30 frames per second.
+    TerrainPager pager( 2 );
+    bool ok = pager.open( path, 1 );
+    const unsigned int slotCount = pager.slotCount();
+    const float speed = 2.0f * pager.tileWorldSize();
+    glm::vec3 cameraPos( 0.5f * pager.tileWorldSize(), 20.0f, 20.5f * pager.tileWorldSize() );
+    for( unsigned int frame = 0; ok && frame < 300; frame++ ){
+        const float time = frame / 30.0f;
+        cameraPos.x = 0.5f * pager.tileWorldSize() + speed * time;
+        pager.update( cameraPos, time );
+        pager.waitIdle();
+    }
+    pager.update( cameraPos, 299 / 30.0f );
+
+    const float scale = header.heightScale / 65535.0f;
+    std::vector< int > resident;
+    for( unsigned int slot = 0; ok && slot < pager.slotCount(); slot++ ){
+        const int tile = pager.slotTile( slot );
+        if( tile < 0 ){
+            continue;
+        }
+        resident.push_back( tile );
+        for( unsigned int i = 0; i < N * N; i++ ){
+            ok = ok && ( pager.slotHeights( slot )[i] == sample( tile, i ) * scale );
+        }
+    }
+    const int cameraX = static_cast< int >( cameraPos.x / pager.tileWorldSize() );
+    const int cameraZ = static_cast< int >( cameraPos.z / pager.tileWorldSize() );
+    for( int z = cameraZ - 1; z <= cameraZ + 1; z++ ){
+        for( int x = cameraX - 1; x <= cameraX + 3; x++ ){
+            ok = ok && std::find( resident.begin(), resident.end(), pager.tileIndex( x, z ) ) != resident.end();
+        }
+    }
+    ok = ok && pager.slotCount() == slotCount && std::abs( pager.velocity().x - speed ) < 0.01f * speed;
+
+    std::cout << "Terrain pager: " << resident.size() << " of " << pager.slotCount() << " slots resident, velocity "
+              << pager.velocity().x << " (expected " << speed << ")" << std::endl;
+    pager.close();
+    remove( path );
+    return ok;
+}
+
+// Meshlets of a 64x64 quad grid: within the limits, every triangle in
+// exactly one of them, and culled when out of the view or facing away.
+bool TestMeshlets()
+{
+    const unsigned int N = 65;
+    std::vector< glm::vec3 > positions;
+    std::vector< uint16_t > indices;
+    for( unsigned int z = 0; z < N; z++ ){
+        for( unsigned int x = 0; x < N; x++ ){
+            positions.push_back( glm::vec3( static_cast< float >( x ), 0.0f, static_cast< float >( z ) ) );
+            if( x > 0 && z > 0 ){
+                const uint16_t quad[4] = {
+                    static_cast< uint16_t >( ( z - 1 ) * N + x - 1 ), static_cast< uint16_t >( ( z - 1 ) * N + x ),
+                    static_cast< uint16_t >( z * N + x - 1 ), static_cast< uint16_t >( z * N + x )
+                };
+                const uint16_t triangles[6] = { quad[0], quad[2], quad[1], quad[1], quad[2], quad[3] };
+                indices.insert( indices.end(), triangles, triangles + 6 );
+            }
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector< uint16_t > meshletIndices;
+    std::vector< Meshlet > meshlets;
+    BuildMeshlets( indices.data(), indices.size(), positions.size(), meshletIndices, meshlets );
+    const double buildTime = std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - start ).count();
+
+    // Same triangles, whatever their order.
+    auto sortedTriangles = []( const std::vector< uint16_t >& triangleIndices ){
+        std::vector< std::vector< uint16_t > > triangles;
+        for( size_t i = 0; i < triangleIndices.size(); i += 3 ){
+            triangles.push_back( std::vector< uint16_t >( triangleIndices.begin() + i, triangleIndices.begin() + i + 3 ) );
+        }
+        std::sort( triangles.begin(), triangles.end() );
+        return triangles;
+    };
+    bool ok = sortedTriangles( indices ) == sortedTriangles( meshletIndices );
+
+    unsigned int nextTriangle = 0;
+    for( const Meshlet& meshlet : meshlets ){
+        std::vector< uint16_t > vertices( meshletIndices.begin() + meshlet.firstTriangle * 3,
+                                          meshletIndices.begin() + ( meshlet.firstTriangle + meshlet.triangleCount ) * 3 );
+        std::sort( vertices.begin(), vertices.end() );
+        const size_t vertexCount = std::unique( vertices.begin(), vertices.end() ) - vertices.begin();
+        ok = ok && meshlet.firstTriangle == nextTriangle && meshlet.vertexCount == vertexCount &&
+             vertexCount <= MAX_MESHLET_VERTICES && meshlet.triangleCount <= MAX_MESHLET_TRIANGLES;
+        nextTriangle += meshlet.triangleCount;
+    }
+
+    // Looking down the grid from above, from below, and away from it.
+    const glm::mat4 projectionMatrix = glm::perspective( glm::radians( 60.0f ), 4.0f / 3.0f, 0.1f, 200.0f );
+    const glm::vec3 up( 0.0f, 1.0f, 0.0f );
+    const struct {
+        glm::vec3 eye;
+        glm::vec3 target;
+        bool allCulled;
+        bool noneCulled;
+    } views[] = {
+        { glm::vec3( 32.0f, 200.0f, 32.0f ), glm::vec3( 32.0f, 0.0f, 32.1f ), false, true },
+        { glm::vec3( 32.0f, -20.0f, -20.0f ), glm::vec3( 32.0f, 0.0f, 32.0f ), true, false },
+        { glm::vec3( 32.0f, 5.0f, -5.0f ), glm::vec3( 32.0f, 5.0f, -50.0f ), true, false },
+        { glm::vec3( 32.0f, 1.0f, -5.0f ), glm::vec3( 32.0f, 0.0f, 32.0f ), false, false }
+    };
+    unsigned int visibleCounts[4];
+    for( unsigned int v = 0; v < 4; v++ ){
+        glm::vec4 frustumPlanes[6];
+        FrustumPlanes( projectionMatrix * glm::lookAt( views[v].eye, views[v].target, up ), frustumPlanes );
+        visibleCounts[v] = 0;
+        for( const Meshlet& meshlet : meshlets ){
+            const MeshletBounds bounds = ComputeMeshletBounds( positions.data(), &meshletIndices[meshlet.firstTriangle * 3], meshlet.triangleCount );
+            visibleCounts[v] += MeshletVisible( bounds, frustumPlanes, views[v].eye );
+        }
+        ok = ok && ( !views[v].allCulled || visibleCounts[v] == 0 ) &&
+             ( !views[v].noneCulled || visibleCounts[v] == meshlets.size() );
+    }
+
+    std::cout << "Meshlets (" << indices.size() / 3 << " triangles, " << buildTime << " ms): " << meshlets.size()
+              << " meshlets, visible from above / below / away / grazing: " << visibleCounts[0] << " / "
+              << visibleCounts[1] << " / " << visibleCounts[2] << " / " << visibleCounts[3] << std::endl;
+    return ok;
+}
+
+
 int main( int argc, char* argv[] )
 {
+    // "tests --check-cpu": run the checks which need no GL context (no GPU
+    // or display needed) and exit with their result.
+    if( argc > 1 && !strcmp( argv[1], "--check-cpu" ) ){
+        bool ok = TestPlasmaEvaluator();
+        ok = TestTextureUpdateScheduler() && ok;
+        ok = BenchmarkRenderQueue() && ok;
+        ok = TestSoftwareOcclusionCuller() && ok;
+        ok = TestTerrainPager() && ok;
+        ok = TestMeshlets() && ok;
+        return ok ? 0 : 1;
+    }
+
     // Initialize the SDL library
     if( SDL_Init( SDL_INIT_VIDEO ) ){
         throw std::runtime_error( SDL_GetError() );
@@ -30,6 +471,21 @@ int main( int argc, char* argv[] )
     }
 
     SDL_GLContext glcontext = SDL_GL_CreateContext( window_ );
+    InitGLExtensions();
+
+    // "tests --check": run the checks and exit with their result.
+    if( argc > 1 && !strcmp( argv[1], "--check" ) ){
+        bool ok = TestPlasmaEvaluator();
+        ok = TestTextureUpdateScheduler() && ok;
+        ok = TestProceduralTextureBackends() && ok;
+        ok = BenchmarkRenderQueue() && ok;
+        ok = TestSoftwareOcclusionCuller() && ok;
+        ok = TestGPUCuller() && ok;
+        ok = TestTerrainPager() && ok;
+        ok = TestMeshlets() && ok;
+        SDL_GL_DeleteContext( glcontext );
+        return ok ? 0 : 1;
+    }
 
     //SDL_Renderer* renderer = SDL_CreateRenderer( window_, -1, 0);
     //if( !renderer ){
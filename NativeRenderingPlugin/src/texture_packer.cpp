@@ -0,0 +1,230 @@
+#include <texture_packer.hpp>
+#include <gl_state.hpp>
+#include <shaders.hpp>
+
+// Draws a source texture over the whole viewport. Texture coordinates are
+// clamped so the area outside [0, 1] (atlas borders) replicates the edges.
+static const char copyVertexShaderCode[] =
+    "#if __VERSION__ >= 130\n"
+    "#define attribute in\n"
+    "#define varying out\n"
+    "#endif\n"
+    "attribute vec2 pos;\n"
+    "uniform vec4 uvTransform;\n"
+    "varying vec2 uv;\n"
+    "void main()\n"
+    "{\n"
+    "    uv = pos * uvTransform.xy + uvTransform.zw;\n"
+    "    gl_Position = vec4( pos * 2.0 - 1.0, 0.0, 1.0 );\n"
+    "}\n";
+
+static const char copyFragmentShaderCode[] =
+    "#ifdef GL_ES\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "#if __VERSION__ >= 130\n"
+    "#define varying in\n"
+    "#define texture2D texture\n"
+    "out vec4 fragColor;\n"
+    "#define gl_FragColor fragColor\n"
+    "#endif\n"
+    "varying vec2 uv;\n"
+    "uniform sampler2D sourceTexture;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = texture2D( sourceTexture, clamp( uv, 0.0, 1.0 ) );\n"
+    "}\n";
+
+
+TexturePacker::TexturePacker() :
+    target_( GL_TEXTURE_2D ),
+    texture_( 0 ),
+    framebuffer_( 0 ),
+    copyProgram_( 0 ),
+    cellSize_( 0 ),
+    atlasSize_( 0 ),
+    cellsPerRow_( 0 ),
+    maxTextures_( 0 )
+{}
+
+
+void TexturePacker::init( unsigned int maxTextures, GLsizei cellSize )
+{
+    release();
+
+    maxTextures_ = maxTextures;
+    cellSize_ = cellSize;
+    target_ = glext.textureArrays ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+
+    glGenTextures( 1, &texture_ );
+    glState.bindTexture( target_, texture_ );
+    if( usesTextureArray() ){
+        glext.texImage3D( GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, cellSize_, cellSize_, maxTextures_, 0,
+                          GL_RGBA, GL_UNSIGNED_BYTE, nullptr );
+    }else{
+        // Square, power of two grid of cells, so the atlas can be mipmapped
+        // on GLES2.
+        cellsPerRow_ = 1;
+        while( cellsPerRow_ * cellsPerRow_ < maxTextures_ ){
+            cellsPerRow_ *= 2;
+        }
+        atlasSize_ = cellsPerRow_ * cellSize_;
+        glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, atlasSize_, atlasSize_, 0,
+                      GL_RGBA, GL_UNSIGNED_BYTE, nullptr );
+    }
+    glTexParameteri( target_, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+    glTexParameteri( target_, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    glTexParameteri( target_, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+    glTexParameteri( target_, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+    glState.bindTexture( target_, 0 );
+
+    glGenFramebuffers( 1, &framebuffer_ );
+    initCopyProgram();
+
+    LOG(INFO) << "TexturePacker - " << maxTextures_ << " textures of "
+              << cellSize_ << "x" << cellSize_ << " in a "
+              << ( usesTextureArray() ? "texture array" : "texture atlas" ) << std::endl;
+}
+
+
+void TexturePacker::release()
+{
+    if( texture_ != 0 ){
+        glDeleteTextures( 1, &texture_ );
+        texture_ = 0;
+    }
+    if( framebuffer_ != 0 ){
+        glDeleteFramebuffers( 1, &framebuffer_ );
+        framebuffer_ = 0;
+    }
+    if( copyProgram_ != 0 ){
+        glDeleteProgram( copyProgram_ );
+        copyProgram_ = 0;
+    }
+    packedTextures_.clear();
+    freeSlots_.clear();
+}
+
+
+int TexturePacker::add( GLuint sourceTexture )
+{
+    if( !freeSlots_.empty() ){
+        const int slot = freeSlots_.back();
+        freeSlots_.pop_back();
+        packedTextures_[slot].opaque = false;
+        copy( sourceTexture, slot );
+        return slot;
+    }
+    if( packedTextures_.size() >= maxTextures_ ){
+        return -1;
+    }
+
+    const int slot = static_cast< int >( packedTextures_.size() );
+    PackedTexture packedTexture;
+    if( usesTextureArray() ){
+        packedTexture.region = glm::vec4( 1.0f, 1.0f, 0.0f, 0.0f );
+        packedTexture.layer = static_cast< float >( slot );
+    }else{
+        // Cell interior, without its border.
+        const GLsizei border = cellSize_ / 32;
+        const float atlasSize = static_cast< float >( atlasSize_ );
+        const float x = static_cast< float >( ( slot % cellsPerRow_ ) * cellSize_ + border );
+        const float y = static_cast< float >( ( slot / cellsPerRow_ ) * cellSize_ + border );
+        const float size = static_cast< float >( cellSize_ - 2 * border );
+        packedTexture.region = glm::vec4( size / atlasSize, size / atlasSize, x / atlasSize, y / atlasSize );
+        packedTexture.layer = 0.0f;
+    }
+    packedTexture.opaque = false;
+    packedTextures_.push_back( packedTexture );
+
+    copy( sourceTexture, slot );
+    return slot;
+}
+
+
+void TexturePacker::replace( int slot, GLuint sourceTexture )
+{
+    copy( sourceTexture, slot );
+}
+
+
+void TexturePacker::remove( int slot )
+{
+    if( slot >= 0 && static_cast< size_t >( slot ) < packedTextures_.size() ){
+        freeSlots_.push_back( slot );
+    }
+}
+
+
+const PackedTexture& TexturePacker::packedTexture( int slot ) const
+{
+    return packedTextures_.at( slot );
+}
+
+
+void TexturePacker::bind() const
+{
+    glState.activeTexture( GL_TEXTURE0 );
+    glState.bindTexture( target_, texture_ );
+}
+
+
+void TexturePacker::initCopyProgram()
+{
+    copyProgram_ = BuildUtilityProgram( copyVertexShaderCode, copyFragmentShaderCode );
+}
+
+
+void TexturePacker::copy( GLuint sourceTexture, int slot )
+{
+    // Unity state we are going to change.
+    ScopedRenderTargetState savedState;
+
+    // Target: the layer or the whole cell (border included).
+    glBindFramebuffer( GL_FRAMEBUFFER, framebuffer_ );
+    glm::vec4 uvTransform( 1.0f, 1.0f, 0.0f, 0.0f );
+    GLint cellX = 0;
+    GLint cellY = 0;
+    if( usesTextureArray() ){
+        glext.framebufferTextureLayer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture_, 0, slot );
+    }else{
+        glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_, 0 );
+        cellX = ( slot % cellsPerRow_ ) * cellSize_;
+        cellY = ( slot / cellsPerRow_ ) * cellSize_;
+
+        // Map the cell interior to [0, 1].
+        const float border = static_cast< float >( cellSize_ / 32 );
+        const float scale = cellSize_ / ( cellSize_ - 2.0f * border );
+        uvTransform = glm::vec4( scale, scale, -border / ( cellSize_ - 2.0f * border ), -border / ( cellSize_ - 2.0f * border ) );
+    }
+    glViewport( cellX, cellY, cellSize_, cellSize_ );
+
+    if( copyProgram_ != 0 && glCheckFramebufferStatus( GL_FRAMEBUFFER ) == GL_FRAMEBUFFER_COMPLETE ){
+        const GLfloat quad[] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+
+        glUseProgram( copyProgram_ );
+        glUniform4f( glGetUniformLocation( copyProgram_, "uvTransform" ), uvTransform.x, uvTransform.y, uvTransform.z, uvTransform.w );
+        glUniform1i( glGetUniformLocation( copyProgram_, "sourceTexture" ), 0 );
+        glBindTexture( GL_TEXTURE_2D, sourceTexture );
+        glBindBuffer( GL_ARRAY_BUFFER, 0 );
+        glEnableVertexAttribArray( 0 );
+        glVertexAttribPointer( 0, 2, GL_FLOAT, GL_FALSE, 0, quad );
+        glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+
+        // Blending is disabled, so the cell holds the source alpha as is.
+        // GLES2 can't query the source format, so look at the texels.
+        std::vector< GLubyte > texels( cellSize_ * cellSize_ * 4 );
+        glReadPixels( cellX, cellY, cellSize_, cellSize_, GL_RGBA, GL_UNSIGNED_BYTE, texels.data() );
+        bool opaque = true;
+        for( size_t i = 3; i < texels.size() && opaque; i += 4 ){
+            opaque = ( texels[i] == 255 );
+        }
+        packedTextures_.at( slot ).opaque = opaque;
+    }else{
+        LOG(ERROR) << "TexturePacker - texture " << sourceTexture << " not packed (no copy program or incomplete framebuffer)" << std::endl;
+    }
+
+    // savedState restores Unity's binding.
+    glBindTexture( target_, texture_ );
+    glGenerateMipmap( target_ );
+}
@@ -0,0 +1,58 @@
+#include <uniform_buffers.hpp>
+#include <gl_extensions.hpp>
+
+UniformRing::UniformRing() :
+    buffer_( 0 ),
+    capacity_( 0 ),
+    cursor_( 0 ),
+    alignment_( 1 )
+{}
+
+
+void UniformRing::init( GLsizeiptr capacity, GLint alignment )
+{
+    release();
+
+    capacity_ = capacity;
+    alignment_ = ( alignment > 0 ) ? alignment : 1;
+    cursor_ = 0;
+    glGenBuffers( 1, &buffer_ );
+    glBindBuffer( GL_UNIFORM_BUFFER, buffer_ );
+    glBufferData( GL_UNIFORM_BUFFER, capacity_, nullptr, GL_STREAM_DRAW );
+    glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+}
+
+
+void UniformRing::release()
+{
+    if( buffer_ != 0 ){
+        glDeleteBuffers( 1, &buffer_ );
+        buffer_ = 0;
+    }
+    capacity_ = 0;
+    cursor_ = 0;
+}
+
+
+GLintptr UniformRing::upload( const void* data, GLsizeiptr size )
+{
+    glBindBuffer( GL_UNIFORM_BUFFER, buffer_ );
+
+    if( size > capacity_ ){
+        // Too big for the ring: grow it (this only happens the first frames).
+        capacity_ = 2 * size;
+        glBufferData( GL_UNIFORM_BUFFER, capacity_, nullptr, GL_STREAM_DRAW );
+        cursor_ = 0;
+    }else if( cursor_ + size > capacity_ ){
+        // Orphan the storage the GPU may be reading and start over.
+        glBufferData( GL_UNIFORM_BUFFER, capacity_, nullptr, GL_STREAM_DRAW );
+        cursor_ = 0;
+    }
+
+    const GLintptr offset = cursor_;
+    glBufferSubData( GL_UNIFORM_BUFFER, offset, size, data );
+    cursor_ = ( ( offset + size + alignment_ - 1 ) / alignment_ ) * alignment_;
+
+    glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+    return offset;
+}
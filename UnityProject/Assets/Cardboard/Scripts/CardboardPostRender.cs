@@ -32,6 +32,10 @@ public class CardboardPostRender : MonoBehaviour {
   private Mesh distortionMesh;
   private Material meshMaterial;
 
+  /// When set, called instead of drawing the distortion mesh (ie. to let a native plugin
+  /// undistort StereoScreen).  Returns false to draw the mesh anyway.
+  public static System.Func<RenderTexture, bool> ExternalDistortionCorrection;
+
   // UI Layer parameters.
   private Material uiMaterial;
   private float centerWidthPx;
@@ -87,7 +91,8 @@ public class CardboardPostRender : MonoBehaviour {
     if (correction == Cardboard.DistortionCorrectionMethod.Native
         && Cardboard.SDK.NativeDistortionCorrectionSupported) {
       Cardboard.SDK.PostRender();
-    } else {
+    } else if (ExternalDistortionCorrection == null
+               || !ExternalDistortionCorrection(stereoScreen)) {
       if (distortionMesh == null || Cardboard.SDK.ProfileChanged) {
         RebuildDistortionMesh();
       }
@@ -0,0 +1,39 @@
+// Unlit shader for the plugin's procedural texture when it's uploaded as a
+// single channel (Alpha8) texture: the plasma is in the alpha channel, so
+// it's swizzled back to grey.
+Shader "Plugin/AlphaAsGrey" {
+	Properties {
+		_MainTex ("Texture", 2D) = "white" {}
+	}
+	SubShader {
+		Tags { "RenderType" = "Opaque" }
+		Pass {
+			CGPROGRAM
+			#pragma vertex vert
+			#pragma fragment frag
+			#include "UnityCG.cginc"
+
+			sampler2D _MainTex;
+			float4 _MainTex_ST;
+
+			struct v2f {
+				float4 pos : SV_POSITION;
+				float2 uv : TEXCOORD0;
+			};
+
+			v2f vert (appdata_base v)
+			{
+				v2f o;
+				o.pos = mul (UNITY_MATRIX_MVP, v.vertex);
+				o.uv = TRANSFORM_TEX (v.texcoord, _MainTex);
+				return o;
+			}
+
+			fixed4 frag (v2f i) : SV_Target
+			{
+				return tex2D (_MainTex, i.uv).aaaa;
+			}
+			ENDCG
+		}
+	}
+}
@@ -25,6 +25,23 @@ public class UseRenderingPlugin : MonoBehaviour
 	private static extern void SetTimeFromUnity(float t);
 
 
+#if UNITY_IPHONE && !UNITY_EDITOR
+	[DllImport ("__Internal")]
+#else
+	[DllImport ("NativeRenderingPlugin")]
+#endif
+	private static extern void SetFrameIdFromUnity(uint frameId);
+
+	#if UNITY_IPHONE && !UNITY_EDITOR
+	[DllImport ("__Internal")]
+	#else
+	[DllImport ("NativeRenderingPlugin")]
+	#endif
+	private static extern void SetStereoMatricesFromUnity(float[] leftViewMatrix, float[] leftProjectionMatrix,
+	                                                      float[] rightViewMatrix, float[] rightProjectionMatrix,
+	                                                      int currentEye);
+
+
 	// We'll also pass native pointer to a texture in Unity.
 	// The plugin will fill texture data from native code.
 #if UNITY_IPHONE && !UNITY_EDITOR
@@ -35,6 +52,20 @@ public class UseRenderingPlugin : MonoBehaviour
 	private static extern void SetTextureFromUnity(System.IntPtr texture, int w, int h);
 
 
+	#if UNITY_IPHONE && !UNITY_EDITOR
+	[DllImport ("__Internal")]
+	#else
+	[DllImport ("NativeRenderingPlugin")]
+	#endif
+	private static extern void SetTextureWithFormatFromUnity(System.IntPtr texture, int w, int h, int format);
+
+	// Procedural texture formats (see ProceduralTextureFormat in
+	// procedural_texture.hpp).
+	private const int PROCEDURAL_TEXTURE_RGBA32 = 0;
+	private const int PROCEDURAL_TEXTURE_ALPHA8 = 1;
+	private const int PROCEDURAL_TEXTURE_RGB565 = 2;
+
+
 	#if UNITY_IPHONE && !UNITY_EDITOR
 	[DllImport ("__Internal")]
 	#else
@@ -51,6 +82,46 @@ public class UseRenderingPlugin : MonoBehaviour
 	private static extern void SetMatricesFromUnity( float[] modelMatrix, float[] viewMatrix, float[] projectionMatrix );
 
 
+	#if UNITY_IPHONE && !UNITY_EDITOR
+	[DllImport ("__Internal")]
+	#else
+	[DllImport ("NativeRenderingPlugin")]
+	#endif
+	private static extern void PublishFrameStateFromUnity ();
+
+
+	#if UNITY_IPHONE && !UNITY_EDITOR
+	[DllImport ("__Internal")]
+	#else
+	[DllImport ("NativeRenderingPlugin")]
+	#endif
+	private static extern System.IntPtr GetFrameDataFromUnity ();
+
+
+	#if UNITY_IPHONE && !UNITY_EDITOR
+	[DllImport ("__Internal")]
+	#else
+	[DllImport ("NativeRenderingPlugin")]
+	#endif
+	private static extern void CommitFrameDataFromUnity ();
+
+
+	// Render thread callback (see IUnityGraphics). Used with
+	// GL.IssuePluginEvent so the plugin works with multithreaded rendering.
+	#if UNITY_IPHONE && !UNITY_EDITOR
+	[DllImport ("__Internal")]
+	#else
+	[DllImport ("NativeRenderingPlugin")]
+	#endif
+	private static extern System.IntPtr GetRenderEventFunc ();
+
+
+	// Plugin event IDs (see PluginEventID in RenderingPlugin.h).
+	private const int PLUGIN_EVENT_RENDER_FRAME = 1;
+	private const int PLUGIN_EVENT_RENDER_STEREO_FRAME = 5;
+	private const int PLUGIN_EVENT_RENDER_DISTORTION = 6;
+
+
 	#if UNITY_IPHONE && !UNITY_EDITOR
 	[DllImport ("__Internal")]
 	#else
@@ -59,6 +130,103 @@ public class UseRenderingPlugin : MonoBehaviour
 	private static extern void InitPlugin ();
 
 
+	#if UNITY_IPHONE && !UNITY_EDITOR
+	[DllImport ("__Internal")]
+	#else
+	[DllImport ("NativeRenderingPlugin")]
+	#endif
+	private static extern void SetShaderCacheDirectoryFromUnity (string directory);
+
+
+	#if UNITY_IPHONE && !UNITY_EDITOR
+	[DllImport ("__Internal")]
+	#else
+	[DllImport ("NativeRenderingPlugin")]
+	#endif
+	private static extern void LoadPlaneTextureFromUnity (string basePath, uint lodLevel);
+
+
+	#if UNITY_IPHONE && !UNITY_EDITOR
+	[DllImport ("__Internal")]
+	#else
+	[DllImport ("NativeRenderingPlugin")]
+	#endif
+	private static extern void SetProceduralTextureCompressionFromUnity (int enabled, float updateInterval);
+
+
+	#if UNITY_IPHONE && !UNITY_EDITOR
+	[DllImport ("__Internal")]
+	#else
+	[DllImport ("NativeRenderingPlugin")]
+	#endif
+	private static extern uint GetCompressedProceduralTextureFromUnity ();
+
+
+	#if UNITY_IPHONE && !UNITY_EDITOR
+	[DllImport ("__Internal")]
+	#else
+	[DllImport ("NativeRenderingPlugin")]
+	#endif
+	private static extern void SetProceduralTextureBackendFromUnity (int backend);
+
+
+	#if UNITY_IPHONE && !UNITY_EDITOR
+	[DllImport ("__Internal")]
+	#else
+	[DllImport ("NativeRenderingPlugin")]
+	#endif
+	private static extern void SetProceduralTextureScheduleFromUnity (float updateRate, float frameBudget);
+
+
+	#if UNITY_IPHONE && !UNITY_EDITOR
+	[DllImport ("__Internal")]
+	#else
+	[DllImport ("NativeRenderingPlugin")]
+	#endif
+	private static extern void SetDistortionFromUnity (float k1, float k2, float[] lensFrustum, float[] noLensFrustum,
+	                                                   float[] viewport, System.IntPtr sourceTexture);
+
+
+	#if UNITY_IPHONE && !UNITY_EDITOR
+	[DllImport ("__Internal")]
+	#else
+	[DllImport ("NativeRenderingPlugin")]
+	#endif
+	private static extern void SubmitCommandsFromUnity ();
+
+
+	#if UNITY_IPHONE && !UNITY_EDITOR
+	[DllImport ("__Internal")]
+	#else
+	[DllImport ("NativeRenderingPlugin")]
+	#endif
+	private static extern void GetGLStateCountersFromUnity (out uint issuedCalls, out uint avoidedCalls);
+
+
+	#if UNITY_IPHONE && !UNITY_EDITOR
+	[DllImport ("__Internal")]
+	#else
+	[DllImport ("NativeRenderingPlugin")]
+	#endif
+	private static extern void SetOcclusionCullingFromUnity (int mode);
+
+
+	#if UNITY_IPHONE && !UNITY_EDITOR
+	[DllImport ("__Internal")]
+	#else
+	[DllImport ("NativeRenderingPlugin")]
+	#endif
+	private static extern void SetGPUDrivenRenderingFromUnity (int enabled);
+
+
+	#if UNITY_IPHONE && !UNITY_EDITOR
+	[DllImport ("__Internal")]
+	#else
+	[DllImport ("NativeRenderingPlugin")]
+	#endif
+	private static extern void LoadTerrainFromUnity (string path, uint viewRadius);
+
+
 	#if UNITY_IPHONE && !UNITY_EDITOR
 	[DllImport ("__Internal")]
 	#else
@@ -67,8 +235,114 @@ public class UseRenderingPlugin : MonoBehaviour
 	private static extern char[] getOpenGLErrorsLog ();
 
 
+	// Layout of the plugin's FrameData struct (see frame_data.hpp). Offsets
+	// are in floats (4 bytes) from the start of the struct.
+	private const int FRAME_DATA_VERSION = 2;
+	private const int MAX_FRAME_OBJECTS = 64;
+	private const int FRAME_DATA_OBJECT_COUNT_OFFSET = 1;
+	private const int FRAME_DATA_TIME_OFFSET = 2;
+	private const int FRAME_DATA_FRAME_ID_OFFSET = 3;
+	private const int FRAME_DATA_VIEW_MATRIX_OFFSET = 4;
+	private const int FRAME_DATA_PROJECTION_MATRIX_OFFSET = 20;
+	private const int FRAME_DATA_OBJECTS_OFFSET = 36;
+	private const int OBJECT_DATA_SIZE = 16;
+
+	// Models rendered by the plugin (one plane each). When empty, a single
+	// plane is rendered at the origin.
+	public Transform[] planeTransforms = new Transform[0];
+
+	// Compressed plane textures, per LOD level. Each one is a path (relative
+	// to Application.persistentDataPath) without the ".astc.ktx" /
+	// ".etc2.ktx" / ".dxt.ktx" / ".etc1.ktx" suffix; the plugin picks the
+	// best format the GPU supports. Levels without one use the downloaded
+	// textures.
+	public string[] compressedPlaneTextures = new string[0];
+
+	// Let the plugin ETC1 compress the procedural texture, re-encoding it at
+	// most every proceduralTextureUpdateInterval seconds.
+	public bool compressProceduralTexture = false;
+	public float proceduralTextureUpdateInterval = 0.5f;
+
+	// Render the procedural texture with a fragment shader instead of filling
+	// it on the CPU and uploading it (see ProceduralTextureBackend).
+	public bool generateProceduralTextureOnGPU = true;
+
+	// Create the procedural texture with the smallest format supported
+	// (Alpha8, then RGB565) instead of ARGB32. The plasma is grey, so it
+	// looks the same with 2 to 4 times less upload and memory bandwidth.
+	public bool reducedBandwidthProceduralTexture = true;
+
+	// CPU generated procedural texture: images per second (0: every frame)
+	// and the most CPU time (in milliseconds) spent on it per frame. Images
+	// taking longer are generated over several frames.
+	public float proceduralTextureUpdateRate = 30.0f;
+	public float proceduralTextureFrameBudget = 2.0f;
+	private Texture2D compressedProceduralTexture = null;
+
+	// With Cardboard, draw the planes of both eyes from the camera of the
+	// last eye rendered, with a single submission per plane when the GPU
+	// supports it, instead of once per eye camera.
+	public bool singlePassStereo = true;
+	private int stereoFrame = -1;
+
+	// Undistort Cardboard's stereo image with the plugin's distortion mesh
+	// (distorted once per viewer profile) instead of Cardboard's own pass.
+	public bool nativeDistortionMesh = true;
+	private RenderTexture distortionSource = null;
+
+	// Skip the planes hidden behind the scene geometry, with GPU occlusion
+	// queries whose results arrive a frame or two later (mono cameras only).
+	public bool occlusionCulling = true;
+
+	// Cull instead on the CPU, against the opaque planes only (no results
+	// to wait for, nor scene geometry to hide the planes).
+	public bool softwareOcclusionCulling = false;
+
+	// Cull the planes and select their LOD levels in a compute shader, with an
+	// indirect draw per level (GLES 3.1 / GL 4.3, mono cameras only). Planes
+	// are then neither occlusion culled nor sorted.
+	public bool gpuDrivenRendering = false;
+
+	// Terrain paged in around the camera from a tiled heightmap file (see
+	// terrain_pager.hpp), relative to Application.persistentDataPath, with
+	// the tiles within terrainViewRadius tiles (up to 8) of the camera
+	// resident (mono cameras only). None when empty.
+	public string terrainHeightmap = "";
+	public uint terrainViewRadius = 2;
+
+	// Log every second how many GL state calls the plugin made and how many
+	// redundant ones it skipped.
+	public bool logGLStateCounters = false;
+	private float glStateCountersTime = 0.0f;
+	private uint glStateIssuedCalls = 0;
+	private uint glStateAvoidedCalls = 0;
+
+	// Pointer to the plugin's persistent frame data and a managed mirror of it
+	// which is filled every frame and copied with a single Marshal.Copy.
+	private System.IntPtr frameDataPtr = System.IntPtr.Zero;
+	private float[] frameData = new float[FRAME_DATA_OBJECTS_OFFSET + MAX_FRAME_OBJECTS * OBJECT_DATA_SIZE];
+
+
 	IEnumerator Start () {
+		// Let the plugin reuse the shader programs linked in previous runs.
+		SetShaderCacheDirectoryFromUnity (Application.persistentDataPath);
 		InitPlugin ();
+		// 0: off, 1: GPU queries, 2: software (see OcclusionCullingMode).
+		SetOcclusionCullingFromUnity (occlusionCulling ? (softwareOcclusionCulling ? 2 : 1) : 0);
+		SetGPUDrivenRenderingFromUnity (gpuDrivenRendering ? 1 : 0);
+		if (!string.IsNullOrEmpty (terrainHeightmap)) {
+			LoadTerrainFromUnity (System.IO.Path.Combine (Application.persistentDataPath, terrainHeightmap), terrainViewRadius);
+		}
+		if (nativeDistortionMesh) {
+			CardboardPostRender.ExternalDistortionCorrection = RenderDistortion;
+		}
+
+		// Use the packed frame data only if its layout is the one we know.
+		frameDataPtr = GetFrameDataFromUnity ();
+		if (Marshal.ReadInt32 (frameDataPtr) != FRAME_DATA_VERSION) {
+			Debug.LogWarning ("Unknown plugin frame data version, falling back to per-call API");
+			frameDataPtr = System.IntPtr.Zero;
+		}
 		
 		WWW www0 = new WWW( "http://pixelkin.org/wp-content/uploads/2014/03/Metal-Gear-Solid-Color-Logo.jpg" );
 		WWW www1 = new WWW( "https://upload.wikimedia.org/wikipedia/commons/7/7e/Metal_Gear_Solid_2_logo.png" );
@@ -82,6 +356,12 @@ public class UseRenderingPlugin : MonoBehaviour
 		SetPlaneTextureFromUnity ( (uint)( www0.texture.GetNativeTexturePtr() ), 0 );
 		SetPlaneTextureFromUnity ( (uint)( www1.texture.GetNativeTexturePtr() ), 1 );
 		SetPlaneTextureFromUnity ( (uint)( www2.texture.GetNativeTexturePtr() ), 2 );
+
+		for (uint lodLevel = 0; lodLevel < compressedPlaneTextures.Length; lodLevel++) {
+			if (!string.IsNullOrEmpty (compressedPlaneTextures[lodLevel])) {
+				LoadPlaneTextureFromUnity (System.IO.Path.Combine (Application.persistentDataPath, compressedPlaneTextures[lodLevel]), lodLevel);
+			}
+		}
 		
 		CreateTextureAndPassToPlugin();
 	}
@@ -89,24 +369,100 @@ public class UseRenderingPlugin : MonoBehaviour
 
 	private void CreateTextureAndPassToPlugin()
 	{
-		// Create a texture
-		Texture2D tex = new Texture2D(256,256,TextureFormat.ARGB32,false);
+		// Create a texture, with the cheapest format the plugin can fill.
+		TextureFormat format = TextureFormat.ARGB32;
+		int pluginFormat = PROCEDURAL_TEXTURE_RGBA32;
+		if (reducedBandwidthProceduralTexture) {
+			if (SystemInfo.SupportsTextureFormat (TextureFormat.Alpha8)) {
+				format = TextureFormat.Alpha8;
+				pluginFormat = PROCEDURAL_TEXTURE_ALPHA8;
+			} else if (SystemInfo.SupportsTextureFormat (TextureFormat.RGB565)) {
+				format = TextureFormat.RGB565;
+				pluginFormat = PROCEDURAL_TEXTURE_RGB565;
+			}
+		}
+		Texture2D tex = new Texture2D(256,256,format,false);
 		// Set point filtering just so we can see the pixels clearly
 		tex.filterMode = FilterMode.Point;
 		// Call Apply() so it's actually uploaded to the GPU
 		tex.Apply();
 
-		// Set texture onto our matrial
+		// Set texture onto our matrial. Alpha8 textures need their alpha
+		// swizzled to grey.
 		GetComponent<Renderer>().material.mainTexture = tex;
+		Shader alphaAsGrey = Shader.Find ("Plugin/AlphaAsGrey");
+		if (pluginFormat == PROCEDURAL_TEXTURE_ALPHA8 && alphaAsGrey != null) {
+			GetComponent<Renderer>().material.shader = alphaAsGrey;
+		}
 
 		// Pass texture pointer to the plugin
 	//#if UNITY_GLES_RENDERER
-		SetTextureFromUnity (tex.GetNativeTexturePtr(), tex.width, tex.height);
+		SetTextureWithFormatFromUnity (tex.GetNativeTexturePtr(), tex.width, tex.height, pluginFormat);
+		SetProceduralTextureCompressionFromUnity (compressProceduralTexture ? 1 : 0, proceduralTextureUpdateInterval);
+		SetProceduralTextureBackendFromUnity (generateProceduralTextureOnGPU ? 1 : 0);
+		SetProceduralTextureScheduleFromUnity (proceduralTextureUpdateRate, proceduralTextureFrameBudget);
 	/*#else
 		SetTextureFromUnity (tex.GetNativeTexturePtr());
 	#endif*/
 	}
 
+	void Update()
+	{
+		if (logGLStateCounters && Time.realtimeSinceStartup - glStateCountersTime >= 1.0f) {
+			uint issuedCalls, avoidedCalls;
+			GetGLStateCountersFromUnity (out issuedCalls, out avoidedCalls);
+			Debug.Log ("Plugin GL state calls: " + (issuedCalls - glStateIssuedCalls) + " made, "
+			           + (avoidedCalls - glStateAvoidedCalls) + " avoided");
+			glStateCountersTime = Time.realtimeSinceStartup;
+			glStateIssuedCalls = issuedCalls;
+			glStateAvoidedCalls = avoidedCalls;
+		}
+
+		// The compressed procedural texture is created by the render thread, so
+		// it's wrapped into a Unity texture once it exists.
+		if (compressProceduralTexture && compressedProceduralTexture == null) {
+			uint textureName = GetCompressedProceduralTextureFromUnity ();
+			if (textureName != 0) {
+				Texture unityTexture = GetComponent<Renderer>().material.mainTexture;
+				compressedProceduralTexture = Texture2D.CreateExternalTexture (unityTexture.width, unityTexture.height, TextureFormat.ETC_RGB4, false, false, new System.IntPtr (textureName));
+				GetComponent<Renderer>().material.mainTexture = compressedProceduralTexture;
+			}
+		}
+	}
+
+
+	void OnDestroy()
+	{
+		if (CardboardPostRender.ExternalDistortionCorrection == RenderDistortion) {
+			CardboardPostRender.ExternalDistortionCorrection = null;
+		}
+	}
+
+
+	// Called by CardboardPostRender instead of drawing its distortion mesh.
+	// The mesh is only rebuilt when the viewer profile or the stereo image
+	// change.
+	private bool RenderDistortion(RenderTexture stereoScreen)
+	{
+		if (stereoScreen != distortionSource || Cardboard.SDK.ProfileChanged) {
+			CardboardProfile profile = Cardboard.SDK.Profile;
+			float[] lensFrustum = new float[4];
+			float[] noLensFrustum = new float[4];
+			profile.GetLeftEyeVisibleTanAngles (lensFrustum);
+			profile.GetLeftEyeNoLensTanAngles (noLensFrustum);
+			Rect rect = profile.GetLeftEyeVisibleScreenRect (noLensFrustum);
+			float[] viewport = { rect.x, rect.y, rect.width, rect.height };
+			SetDistortionFromUnity (profile.device.distortion.k1, profile.device.distortion.k2,
+			                        lensFrustum, noLensFrustum, viewport, stereoScreen.GetNativeTexturePtr ());
+			// Needed by the event below, whatever the scripts order.
+			SubmitCommandsFromUnity ();
+			distortionSource = stereoScreen;
+		}
+		GL.IssuePluginEvent (GetRenderEventFunc (), PLUGIN_EVENT_RENDER_DISTORTION);
+		return true;
+	}
+
+
 	private float[] GetRawArrayFromMatrix( Matrix4x4 matrix )
 	{
 		float[] rawArray = new float[16];
@@ -117,19 +473,106 @@ public class UseRenderingPlugin : MonoBehaviour
 	}
 
 
+	private void WriteMatrix( Matrix4x4 matrix, int offset )
+	{
+		for (int i = 0; i < 16; i++) {
+			frameData[offset + i] = matrix[i];
+		}
+	}
+
+
+	private void CommitFrameData()
+	{
+		int objectCount = Mathf.Min (Mathf.Max (planeTransforms.Length, 1), MAX_FRAME_OBJECTS);
+
+		// Header (version is owned by the plugin, so it's never overwritten).
+		Marshal.WriteInt32 (frameDataPtr, FRAME_DATA_OBJECT_COUNT_OFFSET * 4, objectCount);
+		frameData[FRAME_DATA_TIME_OFFSET] = Time.timeSinceLevelLoad;
+
+		WriteMatrix (Camera.current.worldToCameraMatrix, FRAME_DATA_VIEW_MATRIX_OFFSET);
+		WriteMatrix (Camera.current.projectionMatrix, FRAME_DATA_PROJECTION_MATRIX_OFFSET);
+
+		for (int i = 0; i < objectCount; i++) {
+			Matrix4x4 modelMatrix = (i < planeTransforms.Length) ? planeTransforms[i].localToWorldMatrix : Matrix4x4.identity;
+			WriteMatrix (modelMatrix, FRAME_DATA_OBJECTS_OFFSET + i * OBJECT_DATA_SIZE);
+		}
+
+		// Copy everything after the header in one go and hand it to the render
+		// thread.
+		int floatCount = FRAME_DATA_OBJECTS_OFFSET + objectCount * OBJECT_DATA_SIZE - FRAME_DATA_TIME_OFFSET;
+		Marshal.Copy (frameData, FRAME_DATA_TIME_OFFSET, new System.IntPtr (frameDataPtr.ToInt64 () + FRAME_DATA_TIME_OFFSET * 4), floatCount);
+
+		// Same for every eye / camera, so the plugin does the per-frame work
+		// only once.
+		Marshal.WriteInt32 (frameDataPtr, FRAME_DATA_FRAME_ID_OFFSET * 4, Time.frameCount);
+		CommitFrameDataFromUnity ();
+	}
+
+
+	// Gives the plugin the matrices of both eyes if the current camera is a
+	// Cardboard eye. Returns false if it isn't.
+	private bool SetStereoMatrices()
+	{
+		CardboardEye currentEye = Camera.current.GetComponent<CardboardEye> ();
+		if (currentEye == null || currentEye.eye == Cardboard.Eye.Center) {
+			return false;
+		}
+
+		Camera left = null;
+		Camera right = null;
+		foreach (CardboardEye eye in currentEye.Controller.Eyes) {
+			if (eye.eye == Cardboard.Eye.Left) {
+				left = eye.camera;
+			} else if (eye.eye == Cardboard.Eye.Right) {
+				right = eye.camera;
+			}
+		}
+		if (left == null || right == null) {
+			return false;
+		}
+
+		SetStereoMatricesFromUnity (GetRawArrayFromMatrix (left.worldToCameraMatrix),
+		                            GetRawArrayFromMatrix (left.projectionMatrix),
+		                            GetRawArrayFromMatrix (right.worldToCameraMatrix),
+		                            GetRawArrayFromMatrix (right.projectionMatrix),
+		                            (int)currentEye.eye);
+		return true;
+	}
+
+
 	void OnRenderObject() {
+		int eventID = PLUGIN_EVENT_RENDER_FRAME;
+		if (singlePassStereo && SetStereoMatrices ()) {
+			// Nothing to do for the first eye of the frame: both are drawn
+			// with the second one.
+			if (stereoFrame != Time.frameCount) {
+				stereoFrame = Time.frameCount;
+				return;
+			}
+			eventID = PLUGIN_EVENT_RENDER_STEREO_FRAME;
+		}
+
+		if (frameDataPtr != System.IntPtr.Zero) {
+			CommitFrameData ();
+			GL.IssuePluginEvent (GetRenderEventFunc (), eventID);
+			return;
+		}
+
 		// Set time for the plugin
 		SetTimeFromUnity (Time.timeSinceLevelLoad);
+		SetFrameIdFromUnity ((uint)Time.frameCount);
 		
 		// Set matrices for the plugin
 		SetMatricesFromUnity( GetRawArrayFromMatrix( Matrix4x4.identity ), 
 		                     GetRawArrayFromMatrix( Camera.current.worldToCameraMatrix ),
 		                     GetRawArrayFromMatrix( Camera.current.projectionMatrix ) );
+
+		// Make this frame's time, matrices and texture visible to the render
+		// thread all at once.
+		PublishFrameStateFromUnity ();
 		
-		// Issue a plugin event with arbitrary integer identifier.
-		// The plugin can distinguish between different
+		// Issue a plugin event. The plugin distinguishes between the different
 		// things it needs to do based on this ID.
-		// For our simple plugin, it does not matter which ID we pass here.
-		GL.IssuePluginEvent (1);
+		GL.IssuePluginEvent (GetRenderEventFunc (), eventID);
 	}
 }